@@ -0,0 +1,155 @@
+#ifndef EPOSX_HARDWARE_CANOPEN_H
+#define EPOSX_HARDWARE_CANOPEN_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <linux/can.h>
+#include <ros/time.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace eposx_hardware {
+
+//
+// CiA-301 definitions
+//
+
+// function codes of COB-IDs (COB-ID = function code + node id)
+#define CANOPEN_NMT 0x000
+#define CANOPEN_SYNC 0x080
+#define CANOPEN_EMCY 0x080
+#define CANOPEN_TPDO1 0x180
+#define CANOPEN_RPDO1 0x200
+#define CANOPEN_SDO_TX 0x580 // server (node) -> client (host)
+#define CANOPEN_SDO_RX 0x600 // client (host) -> server (node)
+#define CANOPEN_HEARTBEAT 0x700
+
+// NMT states reported by boot-up & heartbeat frames
+#define CANOPEN_NMT_BOOT_UP 0x00
+#define CANOPEN_NMT_STOPPED 0x04
+#define CANOPEN_NMT_OPERATIONAL 0x05
+#define CANOPEN_NMT_PRE_OPERATIONAL 0x7F
+
+//
+// emergency message
+//
+
+struct CanopenEmcy {
+  boost::uint16_t error_code;
+  boost::uint8_t error_register;
+  boost::uint8_t manufacturer_error[5];
+};
+
+// decode an emergency frame. return false if the frame is not an emergency.
+bool decodeEmcy(const can_frame &frame, unsigned short &node_id, CanopenEmcy &emcy);
+
+//
+// heartbeat
+//
+
+// decode a boot-up or heartbeat frame. return false if the frame is not a heartbeat.
+bool decodeHeartbeat(const can_frame &frame, unsigned short &node_id, unsigned char &nmt_state);
+
+//
+// raw CAN socket on a Linux SocketCAN network interface (e.g. can0 or vcan0)
+//
+
+// interface name of DeviceInfo to select SocketCAN instead of the EPOS Command Library
+#define SOCKETCAN_INTERFACE_NAME "SocketCAN"
+
+// list names of CAN network interfaces
+std::vector< std::string > getSocketCanInterfaceNames();
+
+class SocketCan : boost::noncopyable {
+public:
+  explicit SocketCan(const std::string &interface_name);
+  virtual ~SocketCan();
+
+  const std::string &getInterfaceName() const;
+  // for polling together with other file descriptors
+  int getFileDescriptor() const;
+
+  void send(const can_frame &frame);
+  // send a frame without blocking. return false if the transmit queue is full.
+  bool trySend(const can_frame &frame);
+
+  // receive only frames which match any of the filters
+  // (COB-ID & can_mask == can_id & can_mask)
+  void setFilters(const std::vector< can_filter > &filters);
+
+  // receive a frame. return false if no frame is received within timeout in ms.
+  bool receive(can_frame &frame, const unsigned int timeout);
+
+private:
+  const std::string interface_name_;
+  int fd_;
+};
+
+//
+// background monitor of emergency and heartbeat messages on a CAN interface.
+// it has its own socket so that it takes no frames from transports on the same interface.
+//
+
+class CanopenMonitor : boost::noncopyable {
+public:
+  typedef boost::function< void(const CanopenEmcy &) > EmcyCallback;
+
+  explicit CanopenMonitor(const std::string &interface_name);
+  virtual ~CanopenMonitor();
+
+  // call the callback on the monitor thread on every emergency from the node,
+  // so that faults are handled without waiting for the next poll.
+  // an empty callback unregisters, which waits for the callback running.
+  void setEmcyCallback(const unsigned short node_id, const EmcyCallback &callback);
+
+  // return the number of emergencies received from the node so far,
+  // and the latest one if the number is not 0
+  unsigned int getLatestEmcy(const unsigned short node_id, CanopenEmcy &emcy) const;
+  // return false if no boot-up or heartbeat has been received from the node,
+  // or the NMT state and the receive time of the latest one
+  bool getLatestHeartbeat(const unsigned short node_id, unsigned char &nmt_state,
+                          ros::WallTime &stamp) const;
+
+private:
+  struct NodeStatus {
+    NodeStatus();
+
+    unsigned int num_emcys;
+    CanopenEmcy emcy;
+    bool has_heartbeat;
+    unsigned char nmt_state;
+    ros::WallTime heartbeat_stamp;
+  };
+
+  void openSocket();
+  void run();
+  void handleEmcy(const unsigned short node_id, const CanopenEmcy &emcy);
+  void handleHeartbeat(const unsigned short node_id, const unsigned char nmt_state);
+
+private:
+  const std::string interface_name_;
+  // replaced only by the monitor thread
+  boost::scoped_ptr< SocketCan > socket_;
+  mutable boost::mutex mutex_;
+  std::map< unsigned short, NodeStatus > node_statuses_;
+  // callbacks run under this mutex instead of the one above
+  boost::mutex callback_mutex_;
+  std::map< unsigned short, EmcyCallback > emcy_callbacks_;
+  bool stopping_;
+  boost::thread thread_;
+};
+
+// monitor shared by nodes on the same CAN interface
+boost::shared_ptr< CanopenMonitor > getCanopenMonitor(const std::string &interface_name);
+
+} // namespace eposx_hardware
+
+#endif
@@ -6,16 +6,26 @@
 #include <string>
 #include <vector>
 
+#include <eposx_hardware/canopen.h>
 #include <eposx_hardware/epos_diagnostic_updater.h>
+#include <eposx_hardware/epos_fault_recovery.h>
 #include <eposx_hardware/epos_operation_mode.h>
+#include <eposx_hardware/epos_pdo.h>
+#include <eposx_hardware/position_compare_interface.h>
+#include <eposx_hardware/position_marker_interface.h>
 #include <eposx_hardware/utils.h>
 #include <hardware_interface/controller_info.h>
 #include <hardware_interface/robot_hw.h>
 #include <ros/node_handle.h>
+#include <ros/service_server.h>
+#include <ros/time.h>
 #include <sensor_msgs/BatteryState.h>
+#include <std_srvs/Trigger.h>
 
 #include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace eposx_hardware {
 
@@ -31,11 +41,44 @@ public:
   void read();
   void write();
 
+  // true if the node exchanges PDOs which require SYNC every cycle
+  bool isSynchronous() const;
+  const eposx_hardware::NodeHandle &getNodeHandle() const;
+  const std::string &getMotorName() const;
+
+  // never recover the node from faults again (e.g. after an emergency stop)
+  void disableFaultRecovery();
+  // read and write objects by SDOs instead of PDOs (after the node is set pre-operational)
+  void stopPdo();
+
+  // reconnection (see EposReconnector).
+  // true if reads have failed in a row up to the limit
+  bool isLost() const;
+  // read() and write() do nothing during reconnection
+  bool isReconnecting() const;
+  void setReconnecting(const bool is_reconnecting);
+  // configure the node again after its device is reopened
+  void reconnect();
+
+  // deadline watchdog, which is called by another thread than read() and write().
+  // time of the last write() which has succeeded or been skipped during fault recovery
+  // (zero if never)
+  ros::WallTime getLastWriteStamp() const;
+  // hold the motor keeping the node enabled, by the halt bit in profile modes
+  // or by a zero target in current & torque modes
+  void halt();
+  // return false if the node does not consume heartbeats of the host
+  bool getHostHeartbeat(unsigned short &host_node_id, ros::WallDuration &consumer_time) const;
+
 private:
   // subfunctions for init()
   void initHardwareInterface(hardware_interface::RobotHW &hw, ros::NodeHandle &motor_nh);
   void initEposNodeHandle(ros::NodeHandle &motor_nh);
+  void initCanopenMonitor(ros::NodeHandle &motor_nh);
+  void initEmcyCallback();
+  void initHeartbeat(ros::NodeHandle &motor_nh);
   void initProtocolStackSettings(ros::NodeHandle &motor_nh);
+  void initPdo(ros::NodeHandle &motor_nh);
   void initOperationMode(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                          ros::NodeHandle &motor_nh);
   void initFaultReaction(ros::NodeHandle &motor_nh);
@@ -48,33 +91,126 @@ private:
   void initPositionProfile(ros::NodeHandle &motor_nh);
   void initVelocityProfile(ros::NodeHandle &motor_nh);
   void initDeviceError(ros::NodeHandle &motor_nh);
+  void initCommunicationTimeout(ros::NodeHandle &motor_nh);
+  void initPositionMarker(ros::NodeHandle &motor_nh);
+  void initPositionCompare(ros::NodeHandle &motor_nh);
+  void initFaultRecovery(ros::NodeHandle &motor_nh);
+  void initReconnection(ros::NodeHandle &motor_nh);
+  void initCircuitBreaker(ros::NodeHandle &motor_nh);
   void initMiscParameters(ros::NodeHandle &motor_nh);
+  void initPositionCompareServer(ros::NodeHandle &motor_nh);
+  // write parameters to the node (subfunction for init() and reconnect())
+  void configure();
 
   // subfunctions for read()
   void readJointState();
   void readPowerSupply();
+  void readPositionMarker();
   void readDiagnostic();
+  void readDeviceErrors();
+  void readEmcy();
+  // called by the CANopen monitor thread on every emergency from the node
+  void handleEmcy(const CanopenEmcy &emcy);
+  void markDeviceErrorsStale();
+  bool takeDeviceErrorsStale();
+  void readHeartbeat();
+  void readFaultRecovery();
+  // probe a quarantined node in background instead of reading it
+  void readQuarantine();
+  void countTimeout(const EposException &error);
+  // quarantine state, which is also accessed by the service thread
+  bool isQuarantined() const;
+  void setQuarantined(const bool is_quarantined);
+
+  // subfunctions for write()
+  void writePositionCompare();
+  void updateWriteStamp();
+
+  // configure position compare again from the params (called by the service thread)
+  bool reloadPositionCompareCallback(std_srvs::Trigger::Request &request,
+                                     std_srvs::Trigger::Response &response);
+
+  // state machine by the direct or high-level way
+  void setEnableState();
+  void setDisableState();
+  void switchOperationMode();
 
 private:
   typedef boost::shared_ptr< EposOperationMode > OperationModePtr;
   typedef std::map< std::string, OperationModePtr > OperationModeMap;
   typedef boost::shared_ptr< EposDiagnosticData > DiagnosticDataPtr;
+  typedef boost::shared_ptr< EposPositionMarkerData > PositionMarkerDataPtr;
+  typedef boost::shared_ptr< EposPositionCompareCommand > PositionCompareCommandPtr;
 
   std::string motor_name_;
+  ros::NodeHandle motor_nh_;
 
   eposx_hardware::NodeHandle epos_handle_;
+  boost::shared_ptr< EposPdo > pdo_;
+  boost::shared_ptr< CanopenMonitor > canopen_monitor_;
+  unsigned int num_emcys_;
+  // heartbeat consumer (disabled if the timeout is 0)
+  ros::WallDuration heartbeat_timeout_;
+  ros::WallTime heartbeat_stamp_;
+  unsigned char nmt_state_;
+  bool is_alive_;
   OperationModeMap operation_mode_map_;
   OperationModePtr operation_mode_;
+  // operation mode to be activated in the next write()
+  OperationModePtr pending_operation_mode_;
+  std::string pending_controller_name_;
+  ros::WallTime switch_request_stamp_;
+  boost::shared_ptr< EposFaultRecovery > fault_recovery_;
+  int max_read_failures_;
+  int num_read_failures_;
+  mutable boost::mutex reconnection_mutex_;
+  bool is_reconnecting_;
+  // circuit breaker, which removes an unresponsive node from the cycle (disabled if max is 0)
+  int max_timeouts_;
+  int num_timeouts_;
+  mutable boost::mutex quarantine_mutex_;
+  bool is_quarantined_;
+  ros::WallDuration probe_interval_;
+  ros::WallTime probe_stamp_;
+  // statusword read on the executor of the port. the task shares the result buffer
+  // so that the probe can be forgotten while in flight.
+  boost::shared_future< void > probe_;
+  // communication timeout on the node (disabled if the consumer time is 0)
+  unsigned short host_node_id_;
+  ros::WallDuration host_heartbeat_consumer_time_;
+  mutable boost::mutex write_stamp_mutex_;
+  ros::WallTime write_stamp_;
 
   // state: epos -> ros
   double position_;
   double velocity_;
   double effort_;
   double current_;
+  // read with the joint state if fault recovery or diagnostic needs it
+  boost::uint16_t statusword_;
   sensor_msgs::BatteryStatePtr power_supply_state_;
   DiagnosticDataPtr diagnostic_data_;
+  // positions captured by the node (only if position_marker is given)
+  PositionMarkerDataPtr position_marker_data_;
+  // raw capture counter of the node, which is compared every read() to detect new captures
+  boost::uint16_t position_marker_counter_;
+  // fault & warning bits in the statusword when device errors were read last.
+  // device errors are read again only if the bits change or the errors are marked stale
+  // (also by the monitor thread).
+  boost::uint16_t device_error_bits_;
+  mutable boost::mutex device_errors_mutex_;
+  bool are_device_errors_stale_;
+
+  // command: ros -> epos
+  // position compare (only if position_compare is given), which is accessed under the device lock
+  PositionCompareCommandPtr position_compare_command_;
+  // command written to the node last, which is stale after the node is configured
+  EposPositionCompareCommand written_position_compare_;
+  bool is_position_compare_stale_;
+  ros::ServiceServer position_compare_server_;
 
   bool rw_ros_units_;
+  bool fast_state_machine_;
   double torque_constant_;
   int encoder_resolution_;
 };
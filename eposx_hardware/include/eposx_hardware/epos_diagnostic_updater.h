@@ -20,6 +20,40 @@ struct EposDiagnosticData {
   boost::int8_t operation_mode_display;
   boost::uint16_t statusword;
   std::vector< unsigned int > device_errors;
+  // emergency messages (only on SocketCAN)
+  unsigned int num_emcys;
+  boost::uint16_t emcy_error_code;
+  boost::uint8_t emcy_error_register;
+  // heartbeats (only on SocketCAN)
+  bool is_heartbeat_monitored;
+  bool is_alive;
+  boost::uint8_t nmt_state;
+  // fault recovery (empty state if disabled)
+  std::string fault_recovery_state;
+  unsigned int num_fault_recoveries;
+  bool is_reconnecting;
+  bool is_quarantined;
+  // switches of operation mode, which are executed in write()
+  unsigned int num_mode_switches;
+  double last_mode_switch_latency;
+  double max_mode_switch_latency;
+  // position marker (only if armed)
+  bool has_position_marker;
+  unsigned int position_marker_count;
+  double position_marker_position;
+  // position compare (only if configured)
+  bool has_position_compare;
+  bool position_compare_enabled;
+  double position_compare_reference_position;
+
+  EposDiagnosticData()
+      : operation_mode_display(0), statusword(0), num_emcys(0), emcy_error_code(0),
+        emcy_error_register(0), is_heartbeat_monitored(false), is_alive(false), nmt_state(0),
+        num_fault_recoveries(0), is_reconnecting(false), is_quarantined(false),
+        num_mode_switches(0), last_mode_switch_latency(0.), max_mode_switch_latency(0.),
+        has_position_marker(false), position_marker_count(0), position_marker_position(0.),
+        has_position_compare(false), position_compare_enabled(false),
+        position_compare_reference_position(0.) {}
 };
 
 class EposDiagnosticHandle {
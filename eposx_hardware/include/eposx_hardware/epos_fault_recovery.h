@@ -0,0 +1,81 @@
+#ifndef EPOSX_HARDWARE_EPOS_FAULT_RECOVERY_H
+#define EPOSX_HARDWARE_EPOS_FAULT_RECOVERY_H
+
+#include <string>
+
+#include <eposx_hardware/utils.h>
+#include <ros/node_handle.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace eposx_hardware {
+
+enum FaultRecoveryState {
+  FAULT_RECOVERY_IDLE,       // no fault
+  FAULT_RECOVERY_WAITING,    // waiting before the next attempt
+  FAULT_RECOVERY_RECOVERING, // clearing the fault and enabling the node
+  FAULT_RECOVERY_RECOVERED,  // enabled. the operation mode has to be restored.
+  FAULT_RECOVERY_GAVE_UP,    // all attempts failed
+  FAULT_RECOVERY_DISABLED    // never recover again (e.g. after the motors are stopped)
+};
+
+std::string toString(const FaultRecoveryState state);
+
+//
+// recovery of a faulted node on a background thread so that the control thread of all motors
+// is never blocked. the control thread only notifies faults, and restores the operation mode
+// after the node is enabled again because the mode is shared with controllers.
+//
+
+class EposFaultRecovery : boost::noncopyable {
+public:
+  EposFaultRecovery(ros::NodeHandle &motor_nh, const std::string &motor_name,
+                    const eposx_hardware::NodeHandle &epos_handle);
+  virtual ~EposFaultRecovery();
+
+  // start recovery unless it is in progress. never blocks.
+  void notifyFault();
+  // return true only once after the node is enabled again
+  bool takeRecovered();
+  // stop recovery permanently
+  void disable();
+  // allow recovery again if it has given up (e.g. after the node is reconnected)
+  void reset();
+
+  FaultRecoveryState getState() const;
+  // true while commands must not be written
+  bool isRecovering() const;
+  unsigned int getNumRecoveries() const;
+
+private:
+  void run();
+  // return false if stopped during waiting
+  bool wait(boost::unique_lock< boost::mutex > &lock, const double duration);
+  void recover();
+
+private:
+  const std::string motor_name_;
+  const eposx_hardware::NodeHandle epos_handle_;
+
+  // delay before each attempt, which doubles after every failure up to the max
+  double delay_, max_delay_;
+  // 0 means no limit
+  int max_attempts_;
+  // enable the node by controlword instead of the high-level function
+  bool fast_state_machine_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+  FaultRecoveryState state_;
+  bool has_fault_;
+  unsigned int num_recoveries_;
+  bool stopping_;
+  boost::thread thread_;
+};
+
+} // namespace eposx_hardware
+
+#endif
@@ -9,6 +9,8 @@
 #include <dynamic_joint_limits_interface/joint_limits_interface.h>
 #include <eposx_hardware/epos_diagnostic_updater.h>
 #include <eposx_hardware/epos_manager.h>
+#include <eposx_hardware/position_compare_interface.h>
+#include <eposx_hardware/position_marker_interface.h>
 #include <hardware_interface/actuator_command_interface.h>
 #include <hardware_interface/actuator_state_interface.h>
 #include <hardware_interface/controller_info.h>
@@ -20,6 +22,7 @@
 #include <transmission_interface/transmission_interface_loader.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 namespace eposx_hardware {
 
@@ -42,6 +45,10 @@ private:
   void initMotors(ros::NodeHandle &hw_nh, const std::vector< std::string > &motor_names);
   void initTransmissions(const std::string &urdf_str);
   void initJointLimits(const std::string &urdf_str);
+  void initWatchdog(ros::NodeHandle &hw_nh);
+
+  // deadline watchdog, which runs on its own thread to detect a stalled control thread
+  void runWatchdog();
 
 private:
   ros::NodeHandle root_nh_;
@@ -53,6 +60,8 @@ private:
   hardware_interface::EffortActuatorInterface eff_ator_iface_;
   battery_state_interface::BatteryStateInterface bat_state_iface_;
   EposDiagnosticInterface epos_diag_iface_;
+  EposPositionMarkerInterface epos_marker_iface_;
+  EposPositionCompareInterface epos_compare_iface_;
 
   // bridge between actuator and joint interfaces
   transmission_interface::RobotTransmissions robot_trans_;
@@ -65,6 +74,11 @@ private:
 
   // motor hardware
   EposManager epos_manager_;
+
+  // deadline watchdog (disabled if the deadline is 0)
+  ros::WallDuration watchdog_deadline_;
+  bool watchdog_quick_stop_;
+  boost::thread watchdog_thread_;
 };
 
 } // namespace eposx_hardware
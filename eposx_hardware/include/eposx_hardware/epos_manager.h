@@ -5,13 +5,23 @@
 #include <string>
 #include <vector>
 
+#include <diagnostic_updater/DiagnosticStatusWrapper.h>
+#include <diagnostic_updater/diagnostic_updater.h>
 #include <eposx_hardware/epos.h>
 #include <eposx_hardware/epos_diagnostic_updater.h>
+#include <eposx_hardware/epos_reconnector.h>
+#include <eposx_hardware/executor.h>
+#include <eposx_hardware/utils.h>
 #include <hardware_interface/controller_info.h>
 #include <hardware_interface/robot_hw.h>
 #include <ros/node_handle.h>
+#include <ros/service_server.h>
+#include <ros/time.h>
+#include <std_srvs/Trigger.h>
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace eposx_hardware {
 
@@ -28,9 +38,67 @@ public:
                 const std::list< hardware_interface::ControllerInfo > &stop_list);
   void updateDiagnostics();
 
+  // stop all nodes at once by quick stop (halt on the quick stop ramp) or disable,
+  // on all ports in parallel. commands are not written any more after this.
+  // return the time taken to stop all nodes in seconds.
+  double stop(const bool quick_stop);
+  bool isStopped() const;
+
+  // quick stop all motors, or halt each motor, if the last write to a motor is older than the
+  // deadline. this is called by a watchdog thread while the control thread may be stalled.
+  void checkDeadline(const ros::WallDuration &deadline, const bool quick_stop);
+
+private:
+  // motors on the same physical port, which are accessed by the executor of the port
+  struct MotorGroup {
+    boost::shared_ptr< DeviceExecutor > executor;
+    std::vector< boost::shared_ptr< Epos > > motors;
+  };
+
+  // heartbeats of the host consumed by nodes on a CANopen device
+  struct HostHeartbeat {
+    DeviceHandle device;
+    unsigned short node_id;
+    ros::WallDuration period;
+    ros::WallTime stamp;
+  };
+
+  void addHostHeartbeat(const boost::shared_ptr< Epos > &motor);
+  void sendHostHeartbeats();
+
+  static void readMotors(const std::vector< boost::shared_ptr< Epos > > &motors);
+  static void writeMotors(const std::vector< boost::shared_ptr< Epos > > &motors);
+  // run the function for each group in parallel if there are multiple ports
+  void runOnGroups(void (*function)(const std::vector< boost::shared_ptr< Epos > > &));
+
+  static void stopMotors(const std::vector< boost::shared_ptr< Epos > > &motors,
+                         const bool quick_stop);
+  bool quickStopCallback(std_srvs::Trigger::Request &request,
+                         std_srvs::Trigger::Response &response);
+  void updateStopDiagnostic(diagnostic_updater::DiagnosticStatusWrapper &stat);
+
 private:
   std::vector< boost::shared_ptr< Epos > > motors_;
+  std::vector< MotorGroup > motor_groups_;
+  // devices to which SYNC is sent at the beginning of every cycle
+  std::vector< eposx_hardware::DeviceHandle > sync_devices_;
   std::vector< boost::shared_ptr< EposDiagnosticUpdater > > diagnostic_updaters_;
+  // one for each device, which is destructed before the motors
+  std::vector< boost::shared_ptr< EposReconnector > > reconnectors_;
+  std::vector< HostHeartbeat > host_heartbeats_;
+  // last write stamp of each motor when halted by the watchdog (accessed by the watchdog only)
+  std::vector< ros::WallTime > halted_write_stamps_;
+
+  ros::ServiceServer quick_stop_server_;
+  boost::scoped_ptr< diagnostic_updater::Updater > diagnostic_updater_;
+
+  // stop state & latency, which are accessed by the service thread
+  mutable boost::mutex stop_mutex_;
+  bool is_stopped_;
+  unsigned int num_stops_;
+  unsigned int num_deadline_misses_;
+  double last_stop_latency_;
+  double max_stop_latency_;
 };
 
 } // namespace eposx_hardware
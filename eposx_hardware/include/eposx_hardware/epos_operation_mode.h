@@ -5,20 +5,29 @@
 #include <vector>
 
 #include <dynamic_joint_limits_interface/joint_limits_interface.h>
+#include <eposx_hardware/epos_pdo.h>
 #include <eposx_hardware/utils.h>
 #include <hardware_interface/robot_hw.h>
 #include <ros/node_handle.h>
 
+#include <boost/shared_ptr.hpp>
+
 namespace eposx_hardware {
 
 class EposOperationMode {
 public:
   virtual ~EposOperationMode();
 
-  // configure operation mode (e.g. register command handle or load parameters)
+  // configure operation mode (e.g. register command handle or load parameters).
+  // pdo may be null if the node does not exchange PDOs.
   virtual void init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                     ros::NodeHandle &motor_nh, const std::string &motor_name,
-                    eposx_hardware::NodeHandle &epos_handle) = 0;
+                    eposx_hardware::NodeHandle &epos_handle,
+                    const boost::shared_ptr< EposPdo > &pdo) = 0;
+
+  // reset states of operation mode (e.g. command saturation) before activation.
+  // this never accesses the device.
+  virtual void prepare();
 
   // activate operation mode
   virtual void activate() = 0;
@@ -28,6 +37,10 @@ public:
 
   // write commands of operation mode
   virtual void write() = 0;
+
+  // hold the motor keeping the node enabled (called instead of write() by the deadline watchdog).
+  // the motor resumes on the next write().
+  virtual void halt() = 0;
 };
 
 class EposProfilePositionMode : public EposOperationMode {
@@ -36,17 +49,26 @@ public:
 
   virtual void init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                     ros::NodeHandle &motor_nh, const std::string &motor_name,
-                    eposx_hardware::NodeHandle &epos_handle);
+                    eposx_hardware::NodeHandle &epos_handle,
+                    const boost::shared_ptr< EposPdo > &pdo);
+  virtual void prepare();
   virtual void activate();
   virtual void read();
   virtual void write();
+  virtual void halt();
 
 private:
   std::vector< std::string > joint_names_;
   dynamic_joint_limits_interface::PositionJointSaturationInterface *pos_sat_iface_;
   eposx_hardware::NodeHandle epos_handle_;
+  boost::shared_ptr< EposPdo > pdo_;
   bool rw_ros_units_;
+  bool fast_state_machine_;
   int encoder_resolution_;
+  // setpoint handshake on PDOs (the new-setpoint bit is raised until acknowledged)
+  bool new_setpoint_;
+  bool has_setpoint_;
+  boost::int32_t setpoint_;
   double position_cmd_;
 };
 
@@ -56,14 +78,18 @@ public:
 
   virtual void init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                     ros::NodeHandle &motor_nh, const std::string &motor_name,
-                    eposx_hardware::NodeHandle &epos_handle);
+                    eposx_hardware::NodeHandle &epos_handle,
+                    const boost::shared_ptr< EposPdo > &pdo);
   virtual void activate();
   virtual void read();
   virtual void write();
+  virtual void halt();
 
 private:
   eposx_hardware::NodeHandle epos_handle_;
+  boost::shared_ptr< EposPdo > pdo_;
   bool rw_ros_units_;
+  bool fast_state_machine_;
   bool halt_velocity_;
   double velocity_cmd_;
 };
@@ -74,14 +100,18 @@ public:
 
   virtual void init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                     ros::NodeHandle &motor_nh, const std::string &motor_name,
-                    eposx_hardware::NodeHandle &epos_handle);
+                    eposx_hardware::NodeHandle &epos_handle,
+                    const boost::shared_ptr< EposPdo > &pdo);
   virtual void activate();
   virtual void read();
   virtual void write();
+  virtual void halt();
 
 private:
   eposx_hardware::NodeHandle epos_handle_;
+  boost::shared_ptr< EposPdo > pdo_;
   bool rw_ros_units_;
+  bool fast_state_machine_;
   double torque_constant_;
   double effort_cmd_;
 };
@@ -92,14 +122,18 @@ public:
 
   virtual void init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                     ros::NodeHandle &motor_nh, const std::string &motor_name,
-                    eposx_hardware::NodeHandle &epos_handle);
+                    eposx_hardware::NodeHandle &epos_handle,
+                    const boost::shared_ptr< EposPdo > &pdo);
   virtual void activate();
   virtual void read();
   virtual void write();
+  virtual void halt();
 
 private:
   eposx_hardware::NodeHandle epos_handle_;
+  boost::shared_ptr< EposPdo > pdo_;
   bool rw_ros_units_;
+  bool fast_state_machine_;
   double motor_rated_torque_;
   double effort_cmd_;
 };
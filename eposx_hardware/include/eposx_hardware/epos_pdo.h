@@ -0,0 +1,119 @@
+#ifndef EPOSX_HARDWARE_EPOS_PDO_H
+#define EPOSX_HARDWARE_EPOS_PDO_H
+
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/utils.h>
+#include <ros/node_handle.h>
+
+#include <boost/cstdint.hpp>
+
+namespace eposx_hardware {
+
+//
+// cyclic exchange of process data objects (PDOs) with a node on CANopen.
+// objects in transmit PDOs (node -> host) and receive PDOs (host -> node) are mapped on startup
+// according to params, and are exchanged by single CAN frames instead of confirmed SDO transfers.
+//
+
+class EposPdo {
+public:
+  EposPdo();
+  virtual ~EposPdo();
+
+  // load PDO mapping from params (no bus access)
+  void init(ros::NodeHandle &motor_nh, const eposx_hardware::NodeHandle &epos_handle);
+
+  // write PDO mapping to the node, initialize the process image, and start the node
+  void start();
+
+  // stop exchanging PDOs after the node left the operational state (e.g. by a quick stop).
+  // objects are not found in PDOs afterwards, so that they are accessed by SDOs, until start().
+  void stop();
+
+  // receive all transmit PDOs from the node
+  void receive();
+
+  // send all receive PDOs to the node
+  void transmit();
+
+  // true if PDOs are exchanged on SYNC.
+  // transmit PDOs are sampled and receive PDOs are applied by the node on every SYNC.
+  bool isSynchronous() const;
+
+  // send a SYNC frame to all nodes in the device
+  static void sendSync(const eposx_hardware::DeviceHandle &device_handle);
+
+  // get an object in the transmit PDOs. return false if the object is not mapped.
+  template < typename T >
+  bool getTxObject(const unsigned short index, const unsigned char subindex, T &value) const {
+    return getTxData(index, subindex, &value, sizeof(T));
+  }
+
+  // set an object in the receive PDOs. return false if the object is not mapped.
+  template < typename T >
+  bool setRxObject(const unsigned short index, const unsigned char subindex, const T &value) {
+    return setRxData(index, subindex, &value, sizeof(T));
+  }
+
+  // same as above for a described object (see object_dictionary.h)
+  template < typename Object > bool getTxObject(typename Object::Type &value) const {
+    return getTxObject(Object::index, Object::subindex, value);
+  }
+  template < typename Object > bool setRxObject(const typename Object::Type &value) {
+    return setRxObject(Object::index, Object::subindex, value);
+  }
+
+  // check if an object is mapped in the receive PDOs
+  bool hasRxObject(const unsigned short index, const unsigned char subindex) const;
+
+private:
+  struct Entry {
+    unsigned short index;
+    unsigned char subindex;
+    unsigned char offset; // in bytes
+    unsigned char length; // in bytes
+  };
+
+  struct Pdo {
+    unsigned char number; // 0-based
+    unsigned short cob_id;
+    unsigned char length; // in bytes
+    std::vector< Entry > entries;
+    unsigned char data[8];
+  };
+
+  // subfunctions for init()
+  static std::vector< Pdo > loadPdos(ros::NodeHandle &pdo_nh, const std::string &prefix,
+                                     const unsigned short base_cob_id,
+                                     const std::string &device_name,
+                                     const unsigned short node_id);
+
+  // subfunctions for start()
+  void writeMapping(const unsigned short comm_index, const unsigned short mapping_index,
+                    const Pdo *pdo, const bool is_tpdo);
+  void readImage(Pdo &pdo);
+
+  bool getTxData(const unsigned short index, const unsigned char subindex, void *data,
+                 const unsigned char length) const;
+  bool setRxData(const unsigned short index, const unsigned char subindex, const void *data,
+                 const unsigned char length);
+
+private:
+  eposx_hardware::NodeHandle epos_handle_;
+
+  std::vector< Pdo > tpdos_;
+  std::vector< Pdo > rpdos_;
+
+  bool is_stopped_;
+  bool synchronous_;
+  unsigned char transmission_type_;
+  unsigned short inhibit_time_; // in 100us
+  unsigned short event_timer_;  // in ms
+  unsigned int read_timeout_;   // in ms
+};
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef EPOSX_HARDWARE_EPOS_RECONNECTOR_H
+#define EPOSX_HARDWARE_EPOS_RECONNECTOR_H
+
+#include <vector>
+
+#include <eposx_hardware/epos.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace eposx_hardware {
+
+//
+// reconnection of a lost device (e.g. an unplugged USB adapter) on a background thread.
+// the device is reopened in place and its motors are configured again,
+// while motors on other devices keep running.
+//
+
+class EposReconnector : boost::noncopyable {
+public:
+  EposReconnector(const eposx_hardware::DeviceHandle &device_handle,
+                  const std::vector< boost::shared_ptr< Epos > > &motors);
+  virtual ~EposReconnector();
+
+  // start reconnection if all the motors on the device are lost. never blocks.
+  void update();
+  // never reconnect again (e.g. after the motors are stopped)
+  void disable();
+  bool isReconnecting() const;
+
+private:
+  void run();
+  // return false if stopped or disabled during waiting
+  bool wait(boost::unique_lock< boost::mutex > &lock, const double duration);
+  // return false if disabled
+  bool reconnect();
+
+private:
+  const eposx_hardware::DeviceHandle device_handle_;
+  const std::vector< boost::shared_ptr< Epos > > motors_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+  bool is_reconnecting_;
+  bool is_disabled_;
+  bool stopping_;
+  boost::thread thread_;
+};
+
+} // namespace eposx_hardware
+
+#endif
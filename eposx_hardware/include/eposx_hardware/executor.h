@@ -0,0 +1,114 @@
+#ifndef EPOSX_HARDWARE_EXECUTOR_H
+#define EPOSX_HARDWARE_EXECUTOR_H
+
+#include <deque>
+#include <vector>
+
+#include <eposx_hardware/transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace eposx_hardware {
+
+//
+// worker thread which runs tasks on a device one by one in the posted order.
+// the executor does not own the device. transports are not thread-safe, so every access
+// (tasks of the executor as well as direct calls from other threads) holds a DeviceLock
+// on the per-port mutex. tasks must take the lock themselves.
+//
+
+class DeviceExecutor : boost::noncopyable {
+public:
+  DeviceExecutor();
+  // run the pending tasks and then stop the worker thread
+  virtual ~DeviceExecutor();
+
+  // run the task on the worker thread. the future has the result or the thrown exception.
+  template < typename Result >
+  boost::shared_future< Result > post(const boost::function< Result() > &task);
+
+private:
+  template < typename Result > struct Task;
+
+  void enqueue(const boost::function< void() > &task);
+  void run();
+
+private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque< boost::function< void() > > tasks_;
+  bool stopping_;
+  boost::thread thread_;
+};
+
+// executor shared by handles of the same physical port (sub devices share one of the gateway)
+boost::shared_ptr< DeviceExecutor > getDeviceExecutor(const DeviceHandle &device_handle);
+
+// submit the requests to the executor of the device and return a completion per request.
+// buffers of the requests must be valid until the completions are ready.
+std::vector< boost::shared_future< void > >
+submitObjectsAsync(const DeviceHandle &device_handle, const std::vector< ObjectRequest > &requests);
+
+// wait for all the completions and throw the first error
+void waitAll(const std::vector< boost::shared_future< void > > &futures);
+
+//
+// template implementation
+//
+
+template < typename Result > struct DeviceExecutor::Task {
+  Task(const boost::function< Result() > &function)
+      : function(function), promise(boost::make_shared< boost::promise< Result > >()) {}
+
+  void operator()() const {
+    try {
+      promise->set_value(function());
+    } catch (const EposException &error) {
+      promise->set_exception(boost::copy_exception(error));
+    } catch (...) {
+      promise->set_exception(boost::current_exception());
+    }
+  }
+
+  boost::function< Result() > function;
+  boost::shared_ptr< boost::promise< Result > > promise;
+};
+
+template <> struct DeviceExecutor::Task< void > {
+  Task(const boost::function< void() > &function)
+      : function(function), promise(boost::make_shared< boost::promise< void > >()) {}
+
+  void operator()() const {
+    try {
+      function();
+      promise->set_value();
+    } catch (const EposException &error) {
+      promise->set_exception(boost::copy_exception(error));
+    } catch (...) {
+      promise->set_exception(boost::current_exception());
+    }
+  }
+
+  boost::function< void() > function;
+  boost::shared_ptr< boost::promise< void > > promise;
+};
+
+template < typename Result >
+boost::shared_future< Result > DeviceExecutor::post(const boost::function< Result() > &task) {
+  const Task< Result > wrapped_task(task);
+  boost::shared_future< Result > future(wrapped_task.promise->get_future());
+  enqueue(wrapped_task);
+  return future;
+}
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef EPOSX_HARDWARE_MAXON_SERIAL_H
+#define EPOSX_HARDWARE_MAXON_SERIAL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace eposx_hardware {
+
+//
+// MAXON SERIAL V2 protocol (USB & RS232).
+// a frame is DLE, STX, op code, length in words, data words and CRC (all little endian).
+// DLE in the bytes after STX is doubled (byte stuffing).
+//
+
+#define MAXON_SERIAL_DLE 0x90
+#define MAXON_SERIAL_STX 0x02
+
+// op codes of requests. responses have op code 0x00 and start with a 4-byte error code.
+#define MAXON_SERIAL_RESPONSE 0x00
+#define MAXON_SERIAL_READ_OBJECT 0x60        // node id, index, subindex
+#define MAXON_SERIAL_WRITE_OBJECT 0x68       // node id, index, subindex, 4-byte data
+#define MAXON_SERIAL_INIT_SEGMENT_READ 0x81  // node id, index, subindex
+#define MAXON_SERIAL_INIT_SEGMENT_WRITE 0x82 // node id, index, subindex, 4-byte object length
+#define MAXON_SERIAL_SEGMENT_READ 0x62       // node id, control byte
+#define MAXON_SERIAL_SEGMENT_WRITE 0x6A      // node id, control byte, data
+
+// control byte of segments (data length in bits 0-5)
+#define MAXON_SERIAL_SEGMENT_LENGTH_MASK 0x3F
+#define MAXON_SERIAL_SEGMENT_LAST 0x40
+#define MAXON_SERIAL_SEGMENT_TOGGLE 0x80
+
+// interface name of DeviceInfo to select the native implementation
+// instead of the EPOS Command Library. the port name is a tty device (e.g. /dev/ttyUSB0).
+#define MAXON_SERIAL_INTERFACE_NAME "NativeSerial"
+
+struct MaxonSerialFrame {
+  MaxonSerialFrame();
+  explicit MaxonSerialFrame(const unsigned char op_code);
+
+  // append values in little endian
+  void addUint8(const boost::uint8_t value);
+  void addUint16(const boost::uint16_t value);
+  void addUint32(const boost::uint32_t value);
+  void addBytes(const void *data, const std::size_t length);
+
+  // read a value in little endian at the offset (0 if out of the data)
+  boost::uint32_t getUint32(const std::size_t offset) const;
+
+  unsigned char op_code;
+  // padded to a word boundary on encoding
+  std::vector< unsigned char > data;
+};
+
+// CRC-CCITT over the header word, the data words and a zero word
+boost::uint16_t calcMaxonSerialCrc(const MaxonSerialFrame &frame);
+
+// append an encoded (stuffed) frame to the bytes
+void encodeMaxonSerialFrame(const MaxonSerialFrame &frame, std::vector< unsigned char > &bytes);
+
+// incremental decoder of received bytes
+class MaxonSerialDecoder {
+public:
+  MaxonSerialDecoder();
+
+  // feed a received byte. return true if a frame with valid CRC is completed.
+  bool feed(const unsigned char byte, MaxonSerialFrame &frame);
+  void reset();
+
+  // number of frames dropped due to invalid CRC
+  unsigned int getNbOfCrcErrors() const;
+
+private:
+  enum State { WAIT_DLE, WAIT_STX, RECEIVE };
+
+  State state_;
+  bool escaped_;
+  std::vector< unsigned char > buffer_;
+  unsigned int crc_errors_;
+};
+
+//
+// raw tty device (8N1, no flow control)
+//
+
+// list candidate tty devices of USB & USB-RS232 adapters
+std::vector< std::string > getSerialPortNames();
+
+class SerialPort : boost::noncopyable {
+public:
+  explicit SerialPort(const std::string &port_name);
+  virtual ~SerialPort();
+
+  const std::string &getPortName() const;
+
+  // baudrate is ignored by pseudo terminals and USB devices
+  void setBaudrate(const unsigned int baudrate);
+  // drop unread bytes
+  void flush();
+
+  void write(const std::vector< unsigned char > &bytes);
+  // read available bytes. return 0 if no bytes are received within timeout in ms.
+  std::size_t read(unsigned char *bytes, const std::size_t length, const unsigned int timeout);
+
+private:
+  const std::string port_name_;
+  int fd_;
+};
+
+} // namespace eposx_hardware
+
+#endif
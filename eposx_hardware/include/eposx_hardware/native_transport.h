@@ -0,0 +1,166 @@
+#ifndef EPOSX_HARDWARE_NATIVE_TRANSPORT_H
+#define EPOSX_HARDWARE_NATIVE_TRANSPORT_H
+
+#include <string>
+
+#include <eposx_hardware/transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/cstdint.hpp>
+
+namespace eposx_hardware {
+
+//
+// base of transports which do not depend on the EPOS Command Library.
+// high-level operations are implemented by accessing the object dictionary
+// (CiA-402 objects & EPOS4-specific objects for configuration).
+//
+
+class NativeTransport : public Transport {
+public:
+  NativeTransport(const DeviceInfo &device_info);
+  virtual ~NativeTransport();
+
+  virtual std::string getDeviceName();
+  virtual std::string getProtocolStackName();
+  virtual std::string getInterfaceName();
+  virtual std::string getPortName();
+
+  // the bitrate is a property of the bus and only recorded here.
+  // the timeout is used for every request to nodes.
+  virtual void getProtocolStackSettings(unsigned int &baudrate, unsigned int &timeout);
+  virtual void setProtocolStackSettings(const unsigned int baudrate, const unsigned int timeout);
+  virtual void setGatewaySettings(const unsigned int baudrate);
+
+  virtual void getVersion(const unsigned short node_id, unsigned short &hardware_version,
+                          unsigned short &software_version, unsigned short &application_number,
+                          unsigned short &application_version);
+
+  virtual void setEnableState(const unsigned short node_id);
+  virtual void setDisableState(const unsigned short node_id);
+  virtual void setQuickStopState(const unsigned short node_id);
+  virtual void clearFault(const unsigned short node_id);
+
+  virtual unsigned char getNbOfDeviceError(const unsigned short node_id);
+  virtual unsigned int getDeviceErrorCode(const unsigned short node_id,
+                                          const unsigned char error_number);
+
+  virtual void setMotorType(const unsigned short node_id, const unsigned short type);
+  virtual void setDcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant);
+  virtual void setEcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant,
+                                   const unsigned char number_of_pole_pairs);
+  virtual void setSensorType(const unsigned short node_id, const unsigned short type);
+  virtual void setIncEncoderParameter(const unsigned short node_id, const unsigned int resolution,
+                                      const bool inverted_polarity);
+  virtual void setSsiAbsEncoderParameter(const unsigned short node_id,
+                                         const unsigned short data_rate,
+                                         const unsigned short number_of_multiturn_bits,
+                                         const unsigned short number_of_singleturn_bits,
+                                         const bool inverted_polarity);
+
+  virtual void setMaxFollowingError(const unsigned short node_id, const unsigned int error);
+  virtual void setMaxProfileVelocity(const unsigned short node_id, const unsigned int velocity);
+  virtual void setMaxAcceleration(const unsigned short node_id, const unsigned int acceleration);
+
+  virtual void setPositionRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i, const unsigned short d);
+  virtual void setPositionRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration);
+  virtual void setVelocityRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i);
+  virtual void setVelocityRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration);
+  virtual void setCurrentRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                       const unsigned short i);
+
+  virtual void setPositionProfile(const unsigned short node_id, const unsigned int velocity,
+                                  const unsigned int acceleration,
+                                  const unsigned int deceleration);
+  virtual void enablePositionWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time);
+  virtual void setVelocityProfile(const unsigned short node_id, const unsigned int acceleration,
+                                  const unsigned int deceleration);
+  virtual void enableVelocityWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time);
+
+  virtual void setOperationMode(const unsigned short node_id, const char mode);
+  virtual void activateProfilePositionMode(const unsigned short node_id);
+  virtual void moveToPosition(const unsigned short node_id, const long position,
+                              const bool absolute, const bool immediately);
+  virtual void activateProfileVelocityMode(const unsigned short node_id);
+  virtual void moveWithVelocity(const unsigned short node_id, const long velocity);
+  virtual void haltVelocityMovement(const unsigned short node_id);
+  virtual void activateCurrentMode(const unsigned short node_id);
+  virtual void setCurrentMust(const unsigned short node_id, const short current);
+
+  virtual void setPositionMarkerParameter(const unsigned short node_id,
+                                          const unsigned char edge_type, const unsigned char mode);
+  virtual void activatePositionMarker(const unsigned short node_id,
+                                      const unsigned short digital_input_number,
+                                      const int polarity);
+  virtual unsigned short readPositionMarkerCounter(const unsigned short node_id);
+  virtual int readPositionMarkerCapturedPosition(const unsigned short node_id,
+                                                 const unsigned short counter_index);
+
+  virtual void setPositionCompareParameter(const unsigned short node_id,
+                                          const unsigned char operational_mode,
+                                          const unsigned char interval_mode,
+                                          const unsigned char direction_dependency,
+                                          const unsigned short interval_width,
+                                          const unsigned short interval_repetitions,
+                                          const unsigned short pulse_width);
+  virtual void activatePositionCompare(const unsigned short node_id,
+                                       const unsigned short digital_output_number,
+                                       const int polarity);
+  virtual void enablePositionCompare(const unsigned short node_id);
+  virtual void disablePositionCompare(const unsigned short node_id);
+  virtual void setPositionCompareReferencePosition(const unsigned short node_id,
+                                                   const int reference_position);
+
+  virtual int getPositionIs(const unsigned short node_id);
+  virtual int getVelocityIs(const unsigned short node_id);
+  virtual short getCurrentIs(const unsigned short node_id);
+
+protected:
+  // typed object access
+  template < typename T >
+  T getObjectAs(const unsigned short node_id, const unsigned short index,
+                const unsigned char subindex) {
+    T data;
+    getObject(node_id, index, subindex, &data, sizeof(T));
+    return data;
+  }
+
+  template < typename T >
+  void setObjectAs(const unsigned short node_id, const unsigned short index,
+                   const unsigned char subindex, const T data) {
+    setObject(node_id, index, subindex, &data, sizeof(T));
+  }
+
+  unsigned int getTimeout() const;
+
+private:
+  // write controlword and wait until the statusword shows the expected state
+  void changeState(const unsigned short node_id, const boost::uint16_t controlword,
+                   const boost::uint16_t state_mask, const boost::uint16_t state,
+                   const std::string &func_name);
+  // throw if the device does not have the object used in the function
+  void requireEpos4(const std::string &func_name) const;
+
+private:
+  const DeviceInfo device_info_;
+  unsigned int baudrate_;
+  unsigned int timeout_;
+};
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef EPOSX_HARDWARE_OBJECT_DICTIONARY_H
+#define EPOSX_HARDWARE_OBJECT_DICTIONARY_H
+
+#include <string>
+
+#include <eposx_hardware/transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+
+namespace eposx_hardware {
+
+//
+// objects described at compile time so that their type, length and access are checked by the
+// compiler instead of every call site.
+//
+
+enum ObjectAccess {
+  OBJECT_CONST, // read only, and never changes while the node is powered (cacheable)
+  OBJECT_RO,
+  OBJECT_WO,
+  OBJECT_RW
+};
+
+// families of devices as bit flags
+enum DeviceFamily {
+  DEVICE_EPOS = 0x1,
+  DEVICE_EPOS2 = 0x2,
+  DEVICE_EPOS4 = 0x4,
+  DEVICE_ALL = DEVICE_EPOS | DEVICE_EPOS2 | DEVICE_EPOS4
+};
+
+// family of the device name (0 if unknown)
+unsigned int toDeviceFamily(const std::string &device_name);
+
+template < typename T, unsigned short Index, unsigned char Subindex, ObjectAccess Access,
+           unsigned int Families = DEVICE_ALL >
+struct ObjectDescriptor {
+  BOOST_STATIC_ASSERT_MSG(boost::is_arithmetic< T >::value, "Object type must be a number");
+  BOOST_STATIC_ASSERT_MSG(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Object type must be 1, 2, 4 or 8 bytes");
+
+  typedef T Type;
+  static const unsigned short index = Index;
+  static const unsigned char subindex = Subindex;
+  static const unsigned int length = sizeof(T);
+  static const ObjectAccess access = Access;
+  static const unsigned int families = Families;
+
+  static const bool is_readable = (Access != OBJECT_WO);
+  static const bool is_writable = (Access == OBJECT_WO || Access == OBJECT_RW);
+  static const bool is_cacheable = (Access == OBJECT_CONST);
+
+  static bool isAvailableOn(const std::string &device_name) {
+    return (toDeviceFamily(device_name) & Families) != 0;
+  }
+};
+
+//
+// objects used in this package
+//
+
+namespace objects {
+// communication
+typedef ObjectDescriptor< boost::uint32_t, 0x1016, 0x01, OBJECT_RW > ConsumerHeartbeatTime;
+typedef ObjectDescriptor< boost::uint16_t, 0x1017, 0x00, OBJECT_RW > ProducerHeartbeatTime;
+
+// identity
+typedef ObjectDescriptor< boost::uint64_t, 0x2004, 0x00, OBJECT_CONST, DEVICE_EPOS | DEVICE_EPOS2 >
+    SerialNumber;
+typedef ObjectDescriptor< boost::uint64_t, 0x2100, 0x01, OBJECT_CONST, DEVICE_EPOS4 >
+    SerialNumberEpos4;
+
+// device control
+typedef ObjectDescriptor< boost::uint16_t, 0x6040, 0x00, OBJECT_RW > Controlword;
+typedef ObjectDescriptor< boost::uint16_t, 0x6041, 0x00, OBJECT_RO > Statusword;
+typedef ObjectDescriptor< boost::int8_t, 0x6060, 0x00, OBJECT_RW > ModesOfOperation;
+typedef ObjectDescriptor< boost::int8_t, 0x6061, 0x00, OBJECT_RO > ModesOfOperationDisplay;
+typedef ObjectDescriptor< boost::int16_t, 0x605E, 0x00, OBJECT_RW, DEVICE_EPOS2 | DEVICE_EPOS4 >
+    FaultReactionOption;
+typedef ObjectDescriptor< boost::int16_t, 0x6007, 0x00, OBJECT_RW, DEVICE_EPOS4 >
+    AbortConnectionOptionCode;
+
+// actual values
+typedef ObjectDescriptor< boost::int32_t, 0x6064, 0x00, OBJECT_RO > PositionActualValue;
+typedef ObjectDescriptor< boost::int32_t, 0x606C, 0x00, OBJECT_RO > VelocityActualValue;
+typedef ObjectDescriptor< boost::int16_t, 0x6078, 0x00, OBJECT_RO > CurrentActualValue;
+typedef ObjectDescriptor< boost::int32_t, 0x30D1, 0x02, OBJECT_RO, DEVICE_EPOS4 >
+    CurrentActualValueEpos4;
+typedef ObjectDescriptor< boost::uint16_t, 0x2200, 0x01, OBJECT_RO, DEVICE_EPOS4 >
+    PowerSupplyVoltage;
+
+// motor & motion
+typedef ObjectDescriptor< boost::uint32_t, 0x6410, 0x04, OBJECT_RW, DEVICE_EPOS2 >
+    MaxMotorSpeedEpos2;
+typedef ObjectDescriptor< boost::uint32_t, 0x6080, 0x00, OBJECT_RW, DEVICE_EPOS4 > MaxMotorSpeed;
+typedef ObjectDescriptor< boost::uint32_t, 0x3001, 0x05, OBJECT_RW, DEVICE_EPOS4 > TorqueConstant;
+typedef ObjectDescriptor< boost::int16_t, 0x6071, 0x00, OBJECT_RW, DEVICE_EPOS4 > TargetTorque;
+typedef ObjectDescriptor< boost::int32_t, 0x607A, 0x00, OBJECT_RW > TargetPosition;
+typedef ObjectDescriptor< boost::int32_t, 0x60FF, 0x00, OBJECT_RW > TargetVelocity;
+typedef ObjectDescriptor< boost::int16_t, 0x2030, 0x00, OBJECT_RW, DEVICE_EPOS | DEVICE_EPOS2 >
+    CurrentModeSettingValue;
+
+// position marker (the counter is looked up in the transmit PDOs)
+typedef ObjectDescriptor< boost::uint16_t, 0x2074, 0x04, OBJECT_RO, DEVICE_EPOS2 >
+    PositionMarkerCounter;
+} // namespace objects
+
+//
+// CiA-402 definitions
+//
+
+// controlword commands
+#define CW_SHUTDOWN 0x0006
+#define CW_SWITCH_ON 0x0007
+#define CW_DISABLE_VOLTAGE 0x0000
+#define CW_QUICK_STOP 0x0002
+#define CW_ENABLE_OPERATION 0x000F
+#define CW_FAULT_RESET 0x0080
+// controlword bits for profile modes
+#define CW_NEW_SETPOINT 0x0010
+#define CW_CHANGE_SET_IMMEDIATELY 0x0020
+#define CW_RELATIVE 0x0040
+#define CW_HALT 0x0100
+
+// states in statusword (statusword & mask == state)
+#define SW_MASK 0x006F
+#define SW_MASK_DISABLED 0x004F
+#define SW_SWITCH_ON_DISABLED 0x0040
+#define SW_READY_TO_SWITCH_ON 0x0021
+#define SW_SWITCHED_ON 0x0023
+#define SW_OPERATION_ENABLED 0x0027
+#define SW_QUICK_STOP_ACTIVE 0x0007
+#define SW_FAULT_BIT 0x0008
+#define SW_WARNING_BIT 0x0080
+
+// statusword bits for profile modes
+#define SW_SETPOINT_ACKNOWLEDGE 0x1000
+
+// values of modes of operation
+#define MODE_PROFILE_POSITION 1
+#define MODE_PROFILE_VELOCITY 3
+#define MODE_CURRENT -3
+#define MODE_CYCLIC_SYNCHRONOUS_TORQUE 10
+
+//
+// requests of described objects, which can be batched (Transport::submitObjects)
+// or scheduled (submitObjectsAsync)
+//
+
+template < typename Object >
+ObjectRequest makeReadRequest(const unsigned short node_id, typename Object::Type &value) {
+  BOOST_STATIC_ASSERT_MSG(Object::is_readable, "Object is not readable");
+  return ObjectRequest::read(node_id, Object::index, Object::subindex, &value, Object::length);
+}
+
+template < typename Object >
+ObjectRequest makeWriteRequest(const unsigned short node_id, const typename Object::Type &value) {
+  BOOST_STATIC_ASSERT_MSG(Object::is_writable, "Object is not writable");
+  return ObjectRequest::write(node_id, Object::index, Object::subindex, &value, Object::length);
+}
+
+// throw if the object is not available on the device of the node
+void checkObjectAvailable(const NodeHandle &node_handle, const unsigned short index,
+                          const unsigned char subindex, const unsigned int families);
+
+//
+// single access of described objects
+//
+
+// cacheable objects are read from the node only once (see NodeCache)
+template < typename Object > typename Object::Type readObject(const NodeHandle &node_handle) {
+  BOOST_STATIC_ASSERT_MSG(Object::is_readable, "Object is not readable");
+  typename Object::Type value;
+  if (Object::is_cacheable &&
+      node_handle.cache->getObject(Object::index, Object::subindex, &value, Object::length)) {
+    return value;
+  }
+  checkObjectAvailable(node_handle, Object::index, Object::subindex, Object::families);
+  node_handle.transport->getObject(node_handle.node_id, Object::index, Object::subindex, &value,
+                                   Object::length);
+  if (Object::is_cacheable) {
+    node_handle.cache->setObject(Object::index, Object::subindex, &value, Object::length);
+  }
+  return value;
+}
+
+template < typename Object >
+void writeObject(const NodeHandle &node_handle, const typename Object::Type &value) {
+  BOOST_STATIC_ASSERT_MSG(Object::is_writable, "Object is not writable");
+  checkObjectAvailable(node_handle, Object::index, Object::subindex, Object::families);
+  node_handle.transport->setObject(node_handle.node_id, Object::index, Object::subindex, &value,
+                                   Object::length);
+}
+
+//
+// CiA-402 state machine & modes by direct access to controlword, statusword and modes of
+// operation, which take fewer transactions than the high-level functions of transports.
+// they fall back to the high-level functions if the node is in an unusual state.
+//
+
+// reach operation enabled by up to two controlwords, reading the statusword before and after
+void setEnableStateDirectly(const NodeHandle &node_handle);
+// a single controlword which disables the node in any state
+void setDisableStateDirectly(const NodeHandle &node_handle);
+// write modes of operation, and read the display in the same batch to verify
+void setOperationModeDirectly(const NodeHandle &node_handle, const boost::int8_t mode);
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef EPOSX_HARDWARE_POSITION_COMPARE_INTERFACE_H
+#define EPOSX_HARDWARE_POSITION_COMPARE_INTERFACE_H
+
+#include <string>
+
+#include <hardware_interface/internal/hardware_resource_manager.h>
+
+namespace eposx_hardware {
+
+//
+// command of position compare, which pulses a digital output of the node
+// when the actual position passes the reference position (and following intervals).
+// the node fires pulses by itself, and the host writes changes of the command only.
+//
+
+struct EposPositionCompareCommand {
+  // reference position in the same unit as the actuator position
+  double reference_position;
+  bool enabled;
+
+  EposPositionCompareCommand() : reference_position(0.), enabled(false) {}
+};
+
+class EposPositionCompareHandle {
+public:
+  EposPositionCompareHandle() : name_(), command_(NULL) {}
+  EposPositionCompareHandle(const std::string &name, EposPositionCompareCommand *command)
+      : name_(name), command_(command) {}
+  virtual ~EposPositionCompareHandle() {}
+
+  std::string getName() const { return name_; }
+  EposPositionCompareCommand getCommand() const { return *command_; }
+  void setCommand(const EposPositionCompareCommand &command) { *command_ = command; }
+  void setReferencePosition(const double reference_position) {
+    command_->reference_position = reference_position;
+  }
+  void setEnabled(const bool enabled) { command_->enabled = enabled; }
+
+private:
+  std::string name_;
+  EposPositionCompareCommand *command_;
+};
+
+// a controller which claims the handle owns the command
+class EposPositionCompareInterface
+    : public hardware_interface::HardwareResourceManager< EposPositionCompareHandle,
+                                                          hardware_interface::ClaimResources > {};
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef EPOSX_HARDWARE_POSITION_MARKER_INTERFACE_H
+#define EPOSX_HARDWARE_POSITION_MARKER_INTERFACE_H
+
+#include <string>
+
+#include <hardware_interface/internal/hardware_resource_manager.h>
+#include <ros/time.h>
+
+namespace eposx_hardware {
+
+//
+// position latched by the node on an edge of a digital input (position marker).
+// the count increases on every capture so that consumers can detect new positions.
+//
+
+struct EposPositionMarkerData {
+  unsigned int count;
+  // captured position in the same unit as the actuator position
+  double position;
+  // time when the new count was read (not when the edge occurred)
+  ros::Time stamp;
+
+  EposPositionMarkerData() : count(0), position(0.) {}
+};
+
+class EposPositionMarkerHandle {
+public:
+  EposPositionMarkerHandle() : name_(), data_(NULL) {}
+  EposPositionMarkerHandle(const std::string &name, const EposPositionMarkerData *data)
+      : name_(name), data_(data) {}
+  virtual ~EposPositionMarkerHandle() {}
+
+  std::string getName() const { return name_; }
+  EposPositionMarkerData getData() const { return *data_; }
+  const EposPositionMarkerData *getDataPtr() { return data_; }
+
+private:
+  std::string name_;
+  const EposPositionMarkerData *data_;
+};
+
+class EposPositionMarkerInterface
+    : public hardware_interface::HardwareResourceManager< EposPositionMarkerHandle > {};
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef EPOSX_HARDWARE_SERIAL_TRANSPORT_H
+#define EPOSX_HARDWARE_SERIAL_TRANSPORT_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/native_transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace eposx_hardware {
+
+//
+// MAXON SERIAL V2 transport on a tty device without the EPOS Command Library.
+// the port name of the device info is the tty device (e.g. /dev/ttyUSB0).
+//
+
+class SerialTransport : public NativeTransport {
+public:
+  SerialTransport(const DeviceInfo &device_info);
+  virtual ~SerialTransport();
+
+  // open the tty device again (e.g. after the USB adapter is replugged)
+  virtual void reopen();
+
+  // the baudrate is also applied to the tty device
+  virtual void setProtocolStackSettings(const unsigned int baudrate, const unsigned int timeout);
+
+  // expedited (ReadObject & WriteObject) or segmented transfer according to the length
+  virtual void getObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, void *data, const unsigned int length);
+  virtual void setObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, const void *data,
+                         const unsigned int length);
+
+  // requests up to 4 bytes are pipelined sending up to the pipeline depth of requests
+  // before receiving responses
+  virtual void submitObjects(std::vector< ObjectRequest > &requests);
+
+  // number of requests sent ahead of responses (1: wait each response before the next request)
+  unsigned int getPipelineDepth() const;
+  void setPipelineDepth(const unsigned int depth);
+
+  // the CAN layer is not accessible over the serial protocol
+  virtual void sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                            const void *data);
+  virtual void readCanFrame(const unsigned short cob_id, const unsigned short length, void *data,
+                            const unsigned int timeout);
+  virtual void sendNmtService(const unsigned short node_id,
+                              const unsigned short command_specifier);
+
+private:
+  // send requests and receive responses in the same order
+  void transact(const std::vector< MaxonSerialFrame > &requests,
+                std::vector< MaxonSerialFrame > &responses, const std::string &func_name);
+  // send a request and return the response. throw if the response has an error.
+  MaxonSerialFrame request(const unsigned short node_id, const MaxonSerialFrame &request,
+                           const std::string &func_name);
+  MaxonSerialFrame receive(const std::string &func_name);
+
+private:
+  boost::scoped_ptr< SerialPort > port_;
+  MaxonSerialDecoder decoder_;
+  // bytes received but not decoded yet
+  std::deque< unsigned char > unread_bytes_;
+  unsigned int pipeline_depth_;
+};
+
+} // namespace eposx_hardware
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef EPOSX_HARDWARE_SOCKETCAN_TRANSPORT_H
+#define EPOSX_HARDWARE_SOCKETCAN_TRANSPORT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/canopen.h>
+#include <eposx_hardware/native_transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace eposx_hardware {
+
+//
+// CANopen transport on a Linux SocketCAN interface without the EPOS Command Library.
+// the port name of the device info is the network interface (e.g. can0 or vcan0).
+//
+
+class SocketCanTransport : public NativeTransport {
+public:
+  SocketCanTransport(const DeviceInfo &device_info);
+  virtual ~SocketCanTransport();
+
+  // open the socket again (e.g. after the USB-CAN adapter is replugged)
+  virtual void reopen();
+
+  // SDO upload & download (expedited or segmented according to the length)
+  virtual void getObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, void *data, const unsigned int length);
+  virtual void setObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, const void *data,
+                         const unsigned int length);
+  // expedited requests to different nodes are executed in parallel
+  virtual void submitObjects(std::vector< ObjectRequest > &requests);
+
+  virtual void sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                            const void *data);
+  virtual void readCanFrame(const unsigned short cob_id, const unsigned short length, void *data,
+                            const unsigned int timeout);
+  virtual bool readLatestCanFrame(const unsigned short cob_id, const unsigned short length,
+                                  void *data, const unsigned int timeout);
+  virtual void sendNmtService(const unsigned short node_id,
+                              const unsigned short command_specifier);
+
+  // request the device type of all node ids at once, and collect responses
+  // (and boot-up & heartbeat frames) within a single timeout
+  virtual bool discoverNodes(const unsigned short max_node_id,
+                             std::vector< unsigned short > &node_ids);
+
+private:
+  // send a SDO request and wait the response
+  can_frame requestSdo(const unsigned short node_id, const can_frame &request,
+                       const std::string &func_name);
+  void sendSdo(const unsigned short node_id, const can_frame &request);
+  // wait the response. the request is used to abort the transfer on timeout.
+  can_frame receiveSdo(const unsigned short node_id, const can_frame &request,
+                       const std::string &func_name);
+  // wait a frame with the COB-ID. frames with other COB-IDs are kept for later read.
+  bool waitFrame(const canid_t cob_id, can_frame &frame, const unsigned int timeout);
+
+private:
+  boost::scoped_ptr< SocketCan > socket_;
+  // latest unread frame of each COB-ID
+  std::map< canid_t, can_frame > unread_frames_;
+};
+
+} // namespace eposx_hardware
+
+#endif
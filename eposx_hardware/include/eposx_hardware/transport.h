@@ -0,0 +1,402 @@
+#ifndef EPOSX_HARDWARE_TRANSPORT_H
+#define EPOSX_HARDWARE_TRANSPORT_H
+
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/utils.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+
+namespace eposx_hardware {
+
+//
+// object access submitted to a transport in a batch
+//
+
+struct ObjectRequest {
+  ObjectRequest();
+
+  // read an object into the buffer
+  static ObjectRequest read(const unsigned short node_id, const unsigned short index,
+                            const unsigned char subindex, void *data, const unsigned int length);
+  // write the data to an object. data up to 4 bytes is copied into the request,
+  // so that a temporary value can be written.
+  static ObjectRequest write(const unsigned short node_id, const unsigned short index,
+                             const unsigned char subindex, const void *data,
+                             const unsigned int length);
+
+  unsigned short node_id;
+  unsigned short index;
+  unsigned char subindex;
+  bool is_write;
+  // buffer owned by the caller, which must be valid until the batch completes
+  // (NULL for writes up to 4 bytes, whose data is in the payload)
+  void *data;
+  unsigned int length;
+  unsigned char payload[4];
+  // set by the transport if the request failed
+  boost::shared_ptr< EposException > error;
+
+  // data to be written, which is owned by the request or the caller
+  const void *getWriteData() const;
+};
+
+// throw the first error in the requests
+void throwIfFailed(const std::vector< ObjectRequest > &requests);
+
+//
+// communication path to a device (node chain).
+// all functions throw EposException on failure, like the VCS_xxx functions they correspond to.
+// transports are not thread-safe. a thread must hold a DeviceLock while accessing a device.
+//
+
+class Transport : boost::noncopyable {
+public:
+  virtual ~Transport();
+
+  // transport which owns the physical port (the gateway transport for sub devices)
+  virtual const Transport *getPortOwner() const;
+  // mutex of the port owner, which serializes access to all devices on the port
+  boost::recursive_mutex &getMutex() const;
+
+  // close and open the device again in place (e.g. after the cable is reconnected)
+  // so that all handles of the device stay valid. settings are applied again.
+  virtual void reopen() = 0;
+
+  // device information
+  virtual std::string getDeviceName() = 0;
+  virtual std::string getProtocolStackName() = 0;
+  virtual std::string getInterfaceName() = 0;
+  virtual std::string getPortName() = 0;
+
+  // protocol stack settings
+  virtual void getProtocolStackSettings(unsigned int &baudrate, unsigned int &timeout) = 0;
+  virtual void setProtocolStackSettings(const unsigned int baudrate,
+                                        const unsigned int timeout) = 0;
+  virtual void setGatewaySettings(const unsigned int baudrate) = 0;
+
+  // object dictionary
+  virtual void getObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, void *data, const unsigned int length) = 0;
+  virtual void setObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, const void *data,
+                         const unsigned int length) = 0;
+  // execute requests in order and record errors in each request instead of throwing.
+  // transports may overlap requests if the result is same (e.g. requests to different nodes).
+  virtual void submitObjects(std::vector< ObjectRequest > &requests);
+
+  // identity
+  virtual void getVersion(const unsigned short node_id, unsigned short &hardware_version,
+                          unsigned short &software_version, unsigned short &application_number,
+                          unsigned short &application_version) = 0;
+
+  // state machine
+  virtual void setEnableState(const unsigned short node_id) = 0;
+  virtual void setDisableState(const unsigned short node_id) = 0;
+  virtual void setQuickStopState(const unsigned short node_id) = 0;
+  virtual void clearFault(const unsigned short node_id) = 0;
+
+  // error history
+  virtual unsigned char getNbOfDeviceError(const unsigned short node_id) = 0;
+  virtual unsigned int getDeviceErrorCode(const unsigned short node_id,
+                                          const unsigned char error_number) = 0;
+
+  // motor & sensor configuration
+  virtual void setMotorType(const unsigned short node_id, const unsigned short type) = 0;
+  virtual void setDcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant) = 0;
+  virtual void setEcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant,
+                                   const unsigned char number_of_pole_pairs) = 0;
+  virtual void setSensorType(const unsigned short node_id, const unsigned short type) = 0;
+  virtual void setIncEncoderParameter(const unsigned short node_id, const unsigned int resolution,
+                                      const bool inverted_polarity) = 0;
+  virtual void setSsiAbsEncoderParameter(const unsigned short node_id,
+                                         const unsigned short data_rate,
+                                         const unsigned short number_of_multiturn_bits,
+                                         const unsigned short number_of_singleturn_bits,
+                                         const bool inverted_polarity) = 0;
+
+  // safety configuration
+  virtual void setMaxFollowingError(const unsigned short node_id, const unsigned int error) = 0;
+  virtual void setMaxProfileVelocity(const unsigned short node_id,
+                                     const unsigned int velocity) = 0;
+  virtual void setMaxAcceleration(const unsigned short node_id,
+                                  const unsigned int acceleration) = 0;
+
+  // regulator configuration
+  virtual void setPositionRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i, const unsigned short d) = 0;
+  virtual void setPositionRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration) = 0;
+  virtual void setVelocityRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i) = 0;
+  virtual void setVelocityRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration) = 0;
+  virtual void setCurrentRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                       const unsigned short i) = 0;
+
+  // profile configuration
+  virtual void setPositionProfile(const unsigned short node_id, const unsigned int velocity,
+                                  const unsigned int acceleration,
+                                  const unsigned int deceleration) = 0;
+  virtual void enablePositionWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time) = 0;
+  virtual void setVelocityProfile(const unsigned short node_id, const unsigned int acceleration,
+                                  const unsigned int deceleration) = 0;
+  virtual void enableVelocityWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time) = 0;
+
+  // operation modes & motion
+  virtual void setOperationMode(const unsigned short node_id, const char mode) = 0;
+  virtual void activateProfilePositionMode(const unsigned short node_id) = 0;
+  virtual void moveToPosition(const unsigned short node_id, const long position,
+                              const bool absolute, const bool immediately) = 0;
+  virtual void activateProfileVelocityMode(const unsigned short node_id) = 0;
+  virtual void moveWithVelocity(const unsigned short node_id, const long velocity) = 0;
+  virtual void haltVelocityMovement(const unsigned short node_id) = 0;
+  virtual void activateCurrentMode(const unsigned short node_id) = 0;
+  virtual void setCurrentMust(const unsigned short node_id, const short current) = 0;
+
+  // position marker
+  virtual void setPositionMarkerParameter(const unsigned short node_id,
+                                          const unsigned char edge_type,
+                                          const unsigned char mode) = 0;
+  virtual void activatePositionMarker(const unsigned short node_id,
+                                      const unsigned short digital_input_number,
+                                      const int polarity) = 0;
+  virtual unsigned short readPositionMarkerCounter(const unsigned short node_id) = 0;
+  // counter index 0 is the latest capture
+  virtual int readPositionMarkerCapturedPosition(const unsigned short node_id,
+                                                 const unsigned short counter_index) = 0;
+
+  // position compare, which pulses a digital output at positions without the host
+  virtual void setPositionCompareParameter(const unsigned short node_id,
+                                          const unsigned char operational_mode,
+                                          const unsigned char interval_mode,
+                                          const unsigned char direction_dependency,
+                                          const unsigned short interval_width,
+                                          const unsigned short interval_repetitions,
+                                          const unsigned short pulse_width) = 0;
+  virtual void activatePositionCompare(const unsigned short node_id,
+                                       const unsigned short digital_output_number,
+                                       const int polarity) = 0;
+  virtual void enablePositionCompare(const unsigned short node_id) = 0;
+  virtual void disablePositionCompare(const unsigned short node_id) = 0;
+  virtual void setPositionCompareReferencePosition(const unsigned short node_id,
+                                                   const int reference_position) = 0;
+
+  // actual values
+  virtual int getPositionIs(const unsigned short node_id) = 0;
+  virtual int getVelocityIs(const unsigned short node_id) = 0;
+  virtual short getCurrentIs(const unsigned short node_id) = 0;
+
+  // CAN layer (available only on CANopen)
+  virtual void sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                            const void *data) = 0;
+  // wait a frame with the COB-ID up to timeout in ms
+  virtual void readCanFrame(const unsigned short cob_id, const unsigned short length, void *data,
+                            const unsigned int timeout) = 0;
+  // wait a frame with the COB-ID up to timeout in ms, and take the latest one discarding
+  // older frames queued. return false (data unchanged) if no frame is received.
+  virtual bool readLatestCanFrame(const unsigned short cob_id, const unsigned short length,
+                                  void *data, const unsigned int timeout);
+  // node id 0 means all nodes
+  virtual void sendNmtService(const unsigned short node_id,
+                              const unsigned short command_specifier) = 0;
+
+  // find present nodes up to the max node id in a single pass over the bus.
+  // return false if the transport cannot discover nodes (then nodes must be probed one by one).
+  virtual bool discoverNodes(const unsigned short max_node_id,
+                             std::vector< unsigned short > &node_ids);
+
+private:
+  mutable boost::recursive_mutex mutex_;
+};
+
+//
+// exclusive access to a device during the lifetime of the lock.
+// the lock is recursive so that a function holding it can call others which take it again.
+//
+
+class DeviceLock : boost::noncopyable {
+public:
+  explicit DeviceLock(const DeviceHandle &device_handle);
+  virtual ~DeviceLock();
+
+private:
+  // keeps the device opened while locked
+  const boost::shared_ptr< Transport > transport_;
+  boost::unique_lock< boost::recursive_mutex > lock_;
+};
+
+//
+// transport via the EPOS Command Library (libEposCmd)
+//
+
+class VcsTransport : public Transport {
+public:
+  // open a device
+  VcsTransport(const DeviceInfo &device_info);
+  // open a sub device via a gateway device which is kept opened while the sub device is used
+  VcsTransport(const boost::shared_ptr< VcsTransport > &gateway, const DeviceInfo &device_info);
+  virtual ~VcsTransport();
+
+  // key handle for VCS_xxx functions
+  void *getKeyHandle() const;
+
+  virtual const Transport *getPortOwner() const;
+
+  virtual void reopen();
+
+  virtual std::string getDeviceName();
+  virtual std::string getProtocolStackName();
+  virtual std::string getInterfaceName();
+  virtual std::string getPortName();
+
+  virtual void getProtocolStackSettings(unsigned int &baudrate, unsigned int &timeout);
+  virtual void setProtocolStackSettings(const unsigned int baudrate, const unsigned int timeout);
+  virtual void setGatewaySettings(const unsigned int baudrate);
+
+  virtual void getObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, void *data, const unsigned int length);
+  virtual void setObject(const unsigned short node_id, const unsigned short index,
+                         const unsigned char subindex, const void *data,
+                         const unsigned int length);
+
+  virtual void getVersion(const unsigned short node_id, unsigned short &hardware_version,
+                          unsigned short &software_version, unsigned short &application_number,
+                          unsigned short &application_version);
+
+  virtual void setEnableState(const unsigned short node_id);
+  virtual void setDisableState(const unsigned short node_id);
+  virtual void setQuickStopState(const unsigned short node_id);
+  virtual void clearFault(const unsigned short node_id);
+
+  virtual unsigned char getNbOfDeviceError(const unsigned short node_id);
+  virtual unsigned int getDeviceErrorCode(const unsigned short node_id,
+                                          const unsigned char error_number);
+
+  virtual void setMotorType(const unsigned short node_id, const unsigned short type);
+  virtual void setDcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant);
+  virtual void setEcMotorParameter(const unsigned short node_id,
+                                   const unsigned short nominal_current,
+                                   const unsigned short max_output_current,
+                                   const unsigned short thermal_time_constant,
+                                   const unsigned char number_of_pole_pairs);
+  virtual void setSensorType(const unsigned short node_id, const unsigned short type);
+  virtual void setIncEncoderParameter(const unsigned short node_id, const unsigned int resolution,
+                                      const bool inverted_polarity);
+  virtual void setSsiAbsEncoderParameter(const unsigned short node_id,
+                                         const unsigned short data_rate,
+                                         const unsigned short number_of_multiturn_bits,
+                                         const unsigned short number_of_singleturn_bits,
+                                         const bool inverted_polarity);
+
+  virtual void setMaxFollowingError(const unsigned short node_id, const unsigned int error);
+  virtual void setMaxProfileVelocity(const unsigned short node_id, const unsigned int velocity);
+  virtual void setMaxAcceleration(const unsigned short node_id, const unsigned int acceleration);
+
+  virtual void setPositionRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i, const unsigned short d);
+  virtual void setPositionRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration);
+  virtual void setVelocityRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                        const unsigned short i);
+  virtual void setVelocityRegulatorFeedForward(const unsigned short node_id,
+                                               const unsigned short velocity,
+                                               const unsigned short acceleration);
+  virtual void setCurrentRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                       const unsigned short i);
+
+  virtual void setPositionProfile(const unsigned short node_id, const unsigned int velocity,
+                                  const unsigned int acceleration,
+                                  const unsigned int deceleration);
+  virtual void enablePositionWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time);
+  virtual void setVelocityProfile(const unsigned short node_id, const unsigned int acceleration,
+                                  const unsigned int deceleration);
+  virtual void enableVelocityWindow(const unsigned short node_id, const unsigned int window,
+                                    const unsigned short time);
+
+  virtual void setOperationMode(const unsigned short node_id, const char mode);
+  virtual void activateProfilePositionMode(const unsigned short node_id);
+  virtual void moveToPosition(const unsigned short node_id, const long position,
+                              const bool absolute, const bool immediately);
+  virtual void activateProfileVelocityMode(const unsigned short node_id);
+  virtual void moveWithVelocity(const unsigned short node_id, const long velocity);
+  virtual void haltVelocityMovement(const unsigned short node_id);
+  virtual void activateCurrentMode(const unsigned short node_id);
+  virtual void setCurrentMust(const unsigned short node_id, const short current);
+
+  virtual void setPositionMarkerParameter(const unsigned short node_id,
+                                          const unsigned char edge_type, const unsigned char mode);
+  virtual void activatePositionMarker(const unsigned short node_id,
+                                      const unsigned short digital_input_number,
+                                      const int polarity);
+  virtual unsigned short readPositionMarkerCounter(const unsigned short node_id);
+  virtual int readPositionMarkerCapturedPosition(const unsigned short node_id,
+                                                 const unsigned short counter_index);
+
+  virtual void setPositionCompareParameter(const unsigned short node_id,
+                                          const unsigned char operational_mode,
+                                          const unsigned char interval_mode,
+                                          const unsigned char direction_dependency,
+                                          const unsigned short interval_width,
+                                          const unsigned short interval_repetitions,
+                                          const unsigned short pulse_width);
+  virtual void activatePositionCompare(const unsigned short node_id,
+                                       const unsigned short digital_output_number,
+                                       const int polarity);
+  virtual void enablePositionCompare(const unsigned short node_id);
+  virtual void disablePositionCompare(const unsigned short node_id);
+  virtual void setPositionCompareReferencePosition(const unsigned short node_id,
+                                                   const int reference_position);
+
+  virtual int getPositionIs(const unsigned short node_id);
+  virtual int getVelocityIs(const unsigned short node_id);
+  virtual short getCurrentIs(const unsigned short node_id);
+
+  virtual void sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                            const void *data);
+  virtual void readCanFrame(const unsigned short cob_id, const unsigned short length, void *data,
+                            const unsigned int timeout);
+  virtual void sendNmtService(const unsigned short node_id,
+                              const unsigned short command_specifier);
+
+private:
+  void open();
+  // close the handle if opened (never throws)
+  void close();
+
+private:
+  const DeviceInfo device_info_;
+  void *key_handle_;
+  // gateway device if this is a sub device, or null
+  const boost::shared_ptr< VcsTransport > gateway_;
+  // settings to be applied again on reopen (0 if never set)
+  unsigned int baudrate_, timeout_, gateway_baudrate_;
+  // names of the opened device, which never change (empty until the first query)
+  std::string device_name_;
+  std::string protocol_stack_name_;
+  std::string interface_name_;
+  std::string port_name_;
+};
+
+} // namespace eposx_hardware
+
+#endif
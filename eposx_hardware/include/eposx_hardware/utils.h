@@ -1,8 +1,10 @@
 #ifndef EPOSX_HARDWARE_UTILS_H_
 #define EPOSX_HARDWARE_UTILS_H_
 
+#include <map>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <eposx_library/Definitions.h>
@@ -10,6 +12,7 @@
 
 #include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace eposx_hardware {
 
@@ -25,6 +28,8 @@ public:
 
   bool hasErrorCode() const;
   unsigned int getErrorCode() const;
+  // true if the node did not respond in time
+  bool isTimeout() const;
 
   static std::string toErrorInfo(const unsigned int error_code);
 
@@ -42,19 +47,28 @@ public:
   DeviceInfo();
   DeviceInfo(const std::string &device_name, const std::string &protocol_stack_name,
              const std::string &interface_name, const std::string &port_name);
+  // sub device (e.g. node chain on CAN) accessed via a gateway device (e.g. EPOS on USB)
+  DeviceInfo(const DeviceInfo &gateway_info, const std::string &device_name,
+             const std::string &protocol_stack_name);
   virtual ~DeviceInfo();
 
+  bool isSubDevice() const;
+
 public:
   std::string device_name;
   std::string protocol_stack_name;
   std::string interface_name;
   std::string port_name;
+  // info of the gateway device if this is a sub device, or null
+  boost::shared_ptr< const DeviceInfo > gateway_info;
 };
 
 //
 // handle of device (node chain) which finalizes itself on destruction
 //
 
+class Transport;
+
 class DeviceHandle {
 public:
   DeviceHandle();
@@ -62,12 +76,11 @@ public:
   virtual ~DeviceHandle();
 
 private:
-  static boost::shared_ptr< void > makePtr(const DeviceInfo &device_info);
-  static void *openDevice(const DeviceInfo &device_info);
-  static void closeDevice(void *ptr);
+  static boost::shared_ptr< Transport > makeTransport(const DeviceInfo &device_info);
 
 public:
-  boost::shared_ptr< void > ptr;
+  // shared by handles of the same device
+  boost::shared_ptr< Transport > transport;
 };
 
 //
@@ -89,6 +102,43 @@ public:
   unsigned short application_version;
 };
 
+//
+// read-only values of a node which are read from the node once and then served from memory.
+// values must be invalidated when the node may have been replaced (e.g. on reconnection).
+//
+
+class NodeCache {
+public:
+  NodeCache();
+  virtual ~NodeCache();
+
+  // objects (return false if not cached)
+  bool getObject(const unsigned short index, const unsigned char subindex, void *data,
+                 const unsigned int length) const;
+  void setObject(const unsigned short index, const unsigned char subindex, const void *data,
+                 const unsigned int length);
+
+  // version (return false if not cached)
+  bool getVersion(unsigned short &hardware_version, unsigned short &software_version,
+                  unsigned short &application_number, unsigned short &application_version) const;
+  void setVersion(const unsigned short hardware_version, const unsigned short software_version,
+                  const unsigned short application_number,
+                  const unsigned short application_version);
+
+  void invalidate();
+
+private:
+  typedef std::pair< unsigned short, unsigned char > ObjectKey;
+
+  mutable boost::mutex mutex_;
+  std::map< ObjectKey, std::vector< unsigned char > > objects_;
+  bool has_version_;
+  unsigned short hardware_version_;
+  unsigned short software_version_;
+  unsigned short application_number_;
+  unsigned short application_version_;
+};
+
 //
 // handle of node
 //
@@ -96,12 +146,15 @@ public:
 class NodeHandle : public DeviceHandle {
 public:
   NodeHandle();
+  // the cache is initialized with the identity in the info if known (i.e. nonzero)
   NodeHandle(const NodeInfo &node_info);
   NodeHandle(const DeviceHandle &device_handle, unsigned short node_id);
   virtual ~NodeHandle();
 
 public:
   unsigned short node_id;
+  // shared by copies of the handle
+  boost::shared_ptr< NodeCache > cache;
 };
 
 //
@@ -140,6 +193,9 @@ std::string getInterfaceName(const DeviceHandle &device_handle);
 
 std::string getPortName(const DeviceHandle &device_handle);
 
+// key handle for VCS_xxx functions (throw if the device is not opened via libEposCmd)
+void *getKeyHandle(const DeviceHandle &device_handle);
+
 //
 // NodeInfo helper functions
 //
@@ -159,7 +215,20 @@ NodeHandle createNodeHandle(const DeviceInfo &device_info, const unsigned short
                             const boost::uint64_t serial_number,
                             const unsigned short max_node_id = MAX_NODE_ID);
 
+// switch the host side of the device to the highest baudrate in getBaudrateList()
+// at which all the nodes respond. baudrate objects of the nodes are not written,
+// so a higher baudrate works only if the directly connected node follows the host.
+// keep the current baudrate if no higher one works. return the applied baudrate.
+// throw on CANopen where the host must use the bitrate of the bus.
+unsigned int applyHighestBaudrate(const DeviceHandle &device_handle,
+                                  const std::vector< unsigned short > &node_ids,
+                                  const unsigned int timeout);
+
+// identity of the node (cached)
 boost::uint64_t getSerialNumber(const NodeHandle &node_handle);
+void getVersion(const NodeHandle &node_handle, unsigned short &hardware_version,
+                unsigned short &software_version, unsigned short &application_number,
+                unsigned short &application_version);
 
 } // namespace eposx_hardware
 
@@ -180,7 +249,8 @@ boost::uint64_t getSerialNumber(const NodeHandle &node_handle);
   } while (false)
 
 // call a VCS_xxx function with eposx_hardware::DeviceHandle or die
-#define VCS_DN(func, epos_device_handle, ...) VCS(func, epos_device_handle.ptr.get(), __VA_ARGS__)
+#define VCS_DN(func, epos_device_handle, ...)                                                      \
+  VCS(func, ::eposx_hardware::getKeyHandle(epos_device_handle), __VA_ARGS__)
 
 // call a VCS_xxx function with eposx_hardware::NodeHandle or die (no more arguments)
 #define VCS_N0(func, epos_node_handle) VCS_DN(func, epos_node_handle, epos_node_handle.node_id)
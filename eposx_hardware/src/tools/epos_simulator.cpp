@@ -0,0 +1,1270 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <ios>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/canopen.h>
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/program_options/errors.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace eh = eposx_hardware;
+namespace bpo = boost::program_options;
+
+//
+// util
+//
+
+// monotonic time in seconds
+static double now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// approximate length of a standard frame on the bus in bits (without bit stuffing)
+static unsigned int frameBits(const can_frame &frame) { return 47 + 8 * frame.can_dlc; }
+
+static volatile std::sig_atomic_t stop_requested(0);
+
+static void requestStop(int) { stop_requested = 1; }
+
+//
+// frame counters for bus load measurement
+//
+
+struct BusStats {
+  BusStats() : rx_frames(0), rx_bits(0), tx_frames(0), tx_bits(0), tx_errors(0) {}
+
+  boost::uint64_t rx_frames, rx_bits;
+  boost::uint64_t tx_frames, tx_bits;
+  boost::uint64_t tx_errors;
+};
+
+// send a frame and count it. a full tx queue is counted as an error but not fatal.
+static void sendFrame(eh::SocketCan *socket, BusStats &stats, const can_frame &frame) {
+  if (!socket) {
+    return;
+  }
+  try {
+    socket->send(frame);
+    ++stats.tx_frames;
+    stats.tx_bits += frameBits(frame);
+  } catch (const eh::EposException &) {
+    ++stats.tx_errors;
+  }
+}
+
+//
+// SDO abort codes (CiA-301)
+//
+
+#define ABORT_TOGGLE_BIT 0x05030000
+#define ABORT_INVALID_COMMAND 0x05040001
+#define ABORT_READ_ONLY 0x06010002
+#define ABORT_NO_OBJECT 0x06020000
+#define ABORT_LENGTH_MISMATCH 0x06070010
+#define ABORT_VALUE_RANGE 0x06090030
+#define ABORT_STATE 0x08000022
+
+//
+// emulated EPOS4 node (CAN is disabled if the socket is null)
+//
+
+class SimulatedNode : boost::noncopyable {
+public:
+  SimulatedNode(eh::SocketCan *socket, BusStats &stats, const unsigned short node_id,
+                const boost::uint64_t serial_number)
+      : socket_(socket), stats_(stats), node_id_(node_id), serial_number_(serial_number) {}
+
+  unsigned short getNodeId() const { return node_id_; }
+
+  // reset the application and send a boot-up message
+  void boot(const double time) {
+    resetDictionary(false);
+    nmt_state_ = CANOPEN_NMT_PRE_OPERATIONAL;
+    state_ = SWITCH_ON_DISABLED;
+    position_ = 0.;
+    position_target_ = 0.;
+    velocity_ = 0.;
+    current_ = 0.;
+    last_controlword_ = 0;
+    sdo_.active = false;
+    sync_counters_.assign(4, 0);
+    last_tpdo_times_.assign(4, -1.);
+    last_tpdo_data_.assign(4, std::vector< unsigned char >());
+    pending_rpdos_.clear();
+    last_heartbeat_time_ = time;
+    updateStatusword();
+
+    const unsigned char data[1] = {CANOPEN_NMT_BOOT_UP};
+    send(CANOPEN_HEARTBEAT + node_id_, data, 1);
+  }
+
+  void handleFrame(const can_frame &frame, const double time) {
+    if ((frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0) {
+      return;
+    }
+    const canid_t cob_id(frame.can_id & CAN_SFF_MASK);
+    if (cob_id == CANOPEN_NMT) {
+      handleNmt(frame, time);
+    } else if (cob_id == CANOPEN_SYNC) {
+      handleSync(time);
+    } else if (cob_id == static_cast< canid_t >(CANOPEN_SDO_RX + node_id_)) {
+      if (nmt_state_ != CANOPEN_NMT_STOPPED) {
+        handleSdo(frame);
+      }
+    } else if (nmt_state_ == CANOPEN_NMT_OPERATIONAL) {
+      for (unsigned char number = 0; number < 4; ++number) {
+        const boost::uint32_t rpdo_cob_id(get< boost::uint32_t >(0x1400 + number, 0x01));
+        if ((rpdo_cob_id & 0x80000000) == 0 && (rpdo_cob_id & CAN_SFF_MASK) == cob_id) {
+          handleRpdo(number, frame);
+        }
+      }
+    }
+  }
+
+  // advance the motor model and produce time-triggered frames
+  void update(const double time, const double dt) {
+    updateMotor(dt);
+    updateStatusword();
+
+    if (nmt_state_ == CANOPEN_NMT_OPERATIONAL) {
+      for (unsigned char number = 0; number < 4; ++number) {
+        const boost::uint8_t type(get< boost::uint8_t >(0x1800 + number, 0x02));
+        if (type == 254 || type == 255) {
+          transmitEventTpdo(number, time);
+        }
+      }
+    }
+
+    const boost::uint16_t heartbeat_time(get< boost::uint16_t >(0x1017, 0x00));
+    if (heartbeat_time > 0 && time - last_heartbeat_time_ >= heartbeat_time / 1000.) {
+      const unsigned char data[1] = {nmt_state_};
+      send(CANOPEN_HEARTBEAT + node_id_, data, 1);
+      last_heartbeat_time_ = time;
+    }
+  }
+
+  // read an object via SDO or the serial protocol. return an abort code or 0.
+  boost::uint32_t readObject(const unsigned short index, const unsigned char subindex,
+                             std::vector< unsigned char > &data) const {
+    const Dictionary::const_iterator object(dictionary_.find(key(index, subindex)));
+    if (object == dictionary_.end()) {
+      return ABORT_NO_OBJECT;
+    }
+    data = object->second.data;
+    return 0;
+  }
+
+  // write an object via SDO, RPDO or the serial protocol. return an abort code or 0.
+  boost::uint32_t writeObject(const unsigned short index, const unsigned char subindex,
+                              const unsigned char *data, const std::size_t length) {
+    const Dictionary::iterator object(dictionary_.find(key(index, subindex)));
+    if (object == dictionary_.end()) {
+      return ABORT_NO_OBJECT;
+    }
+    if (!object->second.writable) {
+      return ABORT_READ_ONLY;
+    }
+    if (length != object->second.data.size()) {
+      return ABORT_LENGTH_MISMATCH;
+    }
+    // only deleting is allowed on the error history
+    if (index == 0x1003 && data[0] != 0) {
+      return ABORT_VALUE_RANGE;
+    }
+    // supported modes of operation
+    if (index == 0x6060) {
+      const boost::int8_t mode(data[0]);
+      if (mode != 1 && mode != 3 && mode != 8 && mode != 9 && mode != 10) {
+        return ABORT_VALUE_RANGE;
+      }
+    }
+
+    std::memcpy(&object->second.data[0], data, length);
+    if (index == 0x6040) {
+      applyControlword(get< boost::uint16_t >(0x6040, 0x00));
+    } else if (index == 0x6060) {
+      set< boost::int8_t >(0x6061, 0x00, get< boost::int8_t >(0x6060, 0x00));
+    } else if (index == 0x1003) {
+      set< boost::uint8_t >(0x1001, 0x00, 0);
+    }
+    return 0;
+  }
+
+  // enter the fault state with an emergency message
+  void injectFault(const boost::uint16_t error_code) {
+    state_ = FAULT;
+    updateStatusword();
+    set< boost::uint8_t >(0x1001, 0x00, 0x01 /* generic error */);
+
+    // push the error to the history (sub 1 is the newest)
+    const boost::uint8_t num_errors(std::min(get< boost::uint8_t >(0x1003, 0x00) + 1, 8));
+    for (unsigned char sub = num_errors; sub > 1; --sub) {
+      set< boost::uint32_t >(0x1003, sub, get< boost::uint32_t >(0x1003, sub - 1));
+    }
+    set< boost::uint32_t >(0x1003, 0x01, error_code);
+    set< boost::uint8_t >(0x1003, 0x00, num_errors);
+
+    const unsigned char data[8] = {static_cast< unsigned char >(error_code & 0xFF),
+                                   static_cast< unsigned char >(error_code >> 8),
+                                   get< boost::uint8_t >(0x1001, 0x00),
+                                   0,
+                                   0,
+                                   0,
+                                   0,
+                                   0};
+    send(CANOPEN_EMCY + node_id_, data, 8);
+  }
+
+private:
+  //
+  // object dictionary
+  //
+
+  struct Object {
+    std::vector< unsigned char > data;
+    bool writable;
+  };
+  typedef std::map< boost::uint32_t, Object > Dictionary;
+
+  static boost::uint32_t key(const unsigned short index, const unsigned char subindex) {
+    return (index << 8) | subindex;
+  }
+
+  void addObject(const unsigned short index, const unsigned char subindex,
+                 const unsigned char length, const boost::uint64_t value, const bool writable) {
+    Object &object(dictionary_[key(index, subindex)]);
+    object.data.resize(length);
+    for (unsigned char i = 0; i < length; ++i) {
+      object.data[i] = (value >> (8 * i)) & 0xFF;
+    }
+    object.writable = writable;
+  }
+
+  template < typename T > T get(const unsigned short index, const unsigned char subindex) const {
+    const Dictionary::const_iterator object(dictionary_.find(key(index, subindex)));
+    T value(0);
+    if (object != dictionary_.end()) {
+      std::memcpy(&value, &object->second.data[0], std::min(sizeof(T), object->second.data.size()));
+    }
+    return value;
+  }
+
+  template < typename T >
+  void set(const unsigned short index, const unsigned char subindex, const T value) {
+    const Dictionary::iterator object(dictionary_.find(key(index, subindex)));
+    if (object != dictionary_.end()) {
+      std::memcpy(&object->second.data[0], &value, std::min(sizeof(T), object->second.data.size()));
+    }
+  }
+
+  void resetDictionary(const bool communication_only) {
+    const Dictionary old_dictionary(dictionary_);
+    dictionary_.clear();
+
+    // communication profile (CiA-301)
+    addObject(0x1000, 0x00, 4, 0x00020192 /* CiA-402 servo drive */, false);
+    addObject(0x1001, 0x00, 1, 0, false);
+    addObject(0x1003, 0x00, 1, 0, true);
+    for (unsigned char sub = 1; sub <= 8; ++sub) {
+      addObject(0x1003, sub, 4, 0, false);
+    }
+    addObject(0x1017, 0x00, 2, 0, true);
+    addObject(0x1018, 0x00, 1, 4, false);
+    addObject(0x1018, 0x01, 4, 0x000000FB /* maxon */, false);
+    addObject(0x1018, 0x02, 4, 0x65500000, false);
+    addObject(0x1018, 0x03, 4, 0x01700150, false);
+    addObject(0x1018, 0x04, 4, serial_number_ & 0xFFFFFFFF, false);
+    for (unsigned char number = 0; number < 4; ++number) {
+      // RPDOs are disabled and TPDOs are asynchronous by default
+      addObject(0x1400 + number, 0x01, 4, 0x80000000 | (0x200 + 0x100 * number + node_id_), true);
+      addObject(0x1400 + number, 0x02, 1, 255, true);
+      addObject(0x1600 + number, 0x00, 1, 0, true);
+      addObject(0x1800 + number, 0x01, 4, 0x80000000 | (0x180 + 0x100 * number + node_id_), true);
+      addObject(0x1800 + number, 0x02, 1, 255, true);
+      addObject(0x1800 + number, 0x03, 2, 0, true);
+      addObject(0x1800 + number, 0x05, 2, 0, true);
+      addObject(0x1A00 + number, 0x00, 1, 0, true);
+      for (unsigned char sub = 1; sub <= 8; ++sub) {
+        addObject(0x1600 + number, sub, 4, 0, true);
+        addObject(0x1A00 + number, sub, 4, 0, true);
+      }
+    }
+    if (communication_only) {
+      // restore application objects
+      BOOST_FOREACH (const Dictionary::value_type &object, old_dictionary) {
+        if ((object.first >> 8) >= 0x2000) {
+          dictionary_.insert(object);
+        }
+      }
+      return;
+    }
+
+    // manufacturer specific objects (EPOS4)
+    addObject(0x2003, 0x01, 2, 0x6551, false); // hardware version
+    addObject(0x2003, 0x02, 2, 0x0170, false); // software version
+    addObject(0x2003, 0x03, 2, 0x0000, false); // application number
+    addObject(0x2003, 0x04, 2, 0x0000, false); // application version
+    addObject(0x2100, 0x01, 8, serial_number_, false);
+    addObject(0x2200, 0x01, 2, 240 /* 24.0 V */, false);
+    addObject(0x3001, 0x01, 4, 2000 /* mA */, true);
+    addObject(0x3001, 0x02, 4, 4000 /* mA */, true);
+    addObject(0x3001, 0x03, 1, 1, true);
+    addObject(0x3001, 0x04, 2, 400 /* 100 ms */, true);
+    addObject(0x3001, 0x05, 4, 30000 /* uNm/A */, true);
+    addObject(0x3010, 0x01, 4, 1024 /* pulses per revolution */, true);
+    addObject(0x3010, 0x02, 2, 0x0000 /* with index */, true);
+    addObject(0x30A0, 0x01, 4, 0, true);
+    addObject(0x30A0, 0x02, 4, 0, true);
+    for (unsigned char sub = 1; sub <= 5; ++sub) {
+      addObject(0x30A1, sub, 4, 0, true);
+    }
+    for (unsigned char sub = 1; sub <= 4; ++sub) {
+      addObject(0x30A2, sub, 4, 0, true);
+    }
+    addObject(0x30D1, 0x01, 4, 0, false);
+    addObject(0x30D1, 0x02, 4, 0, false);
+
+    // device profile (CiA-402)
+    addObject(0x6040, 0x00, 2, 0, true);
+    addObject(0x6041, 0x00, 2, 0, false);
+    addObject(0x605E, 0x00, 2, 2, true);
+    addObject(0x6060, 0x00, 1, 0, true);
+    addObject(0x6061, 0x00, 1, 0, false);
+    addObject(0x6064, 0x00, 4, 0, false);
+    addObject(0x6065, 0x00, 4, 2000, true);
+    addObject(0x6067, 0x00, 4, 10, true);
+    addObject(0x6068, 0x00, 2, 10, true);
+    addObject(0x606C, 0x00, 4, 0, false);
+    addObject(0x606D, 0x00, 2, 20, true);
+    addObject(0x606E, 0x00, 2, 10, true);
+    addObject(0x6071, 0x00, 2, 0, true);
+    addObject(0x6077, 0x00, 2, 0, false);
+    addObject(0x607A, 0x00, 4, 0, true);
+    addObject(0x607F, 0x00, 4, 10000, true);
+    addObject(0x6080, 0x00, 4, 10000, true);
+    addObject(0x6081, 0x00, 4, 1000, true);
+    addObject(0x6083, 0x00, 4, 10000, true);
+    addObject(0x6084, 0x00, 4, 10000, true);
+    addObject(0x6085, 0x00, 4, 100000, true);
+    addObject(0x60C5, 0x00, 4, 100000, true);
+    addObject(0x60FF, 0x00, 4, 0, true);
+    addObject(0x6402, 0x00, 2, 10, true);
+  }
+
+  //
+  // NMT
+  //
+
+  void handleNmt(const can_frame &frame, const double time) {
+    if (frame.can_dlc < 2 || (frame.data[1] != 0 && frame.data[1] != node_id_)) {
+      return;
+    }
+    switch (frame.data[0]) {
+    case NCS_START_REMOTE_NODE:
+      nmt_state_ = CANOPEN_NMT_OPERATIONAL;
+      break;
+    case NCS_STOP_REMOTE_NODE:
+      nmt_state_ = CANOPEN_NMT_STOPPED;
+      break;
+    case NCS_ENTER_PRE_OPERATIONAL:
+      nmt_state_ = CANOPEN_NMT_PRE_OPERATIONAL;
+      break;
+    case NCS_RESET_NODE:
+      boot(time);
+      break;
+    case NCS_RESET_COMMUNICATION: {
+      resetDictionary(true);
+      nmt_state_ = CANOPEN_NMT_PRE_OPERATIONAL;
+      const unsigned char data[1] = {CANOPEN_NMT_BOOT_UP};
+      send(CANOPEN_HEARTBEAT + node_id_, data, 1);
+      break;
+    }
+    }
+  }
+
+  //
+  // SDO server
+  //
+
+  struct SdoTransfer {
+    bool active;
+    bool upload;
+    unsigned short index;
+    unsigned char subindex;
+    std::vector< unsigned char > buffer;
+    std::size_t offset;
+    unsigned char toggle;
+  };
+
+  void handleSdo(const can_frame &request) {
+    const unsigned char command(request.data[0] & 0xE0);
+    const unsigned short index(request.data[1] | (request.data[2] << 8));
+    const unsigned char subindex(request.data[3]);
+
+    if (command == 0x20 /* initiate download */) {
+      if (request.data[0] & 0x02 /* expedited */) {
+        const std::size_t size((request.data[0] & 0x01) ? 4 - ((request.data[0] >> 2) & 0x03) : 4);
+        const boost::uint32_t abort_code(writeObject(index, subindex, request.data + 4, size));
+        if (abort_code != 0) {
+          sendSdoAbort(index, subindex, abort_code);
+          return;
+        }
+      } else {
+        sdo_.active = true;
+        sdo_.upload = false;
+        sdo_.index = index;
+        sdo_.subindex = subindex;
+        sdo_.buffer.clear();
+        sdo_.toggle = 0;
+      }
+      sendSdo(0x60, index, subindex, NULL, 0);
+    } else if (command == 0x00 /* download segment */) {
+      if (!sdo_.active || sdo_.upload) {
+        sendSdoAbort(0, 0, ABORT_INVALID_COMMAND);
+        return;
+      }
+      if ((request.data[0] & 0x10) != sdo_.toggle) {
+        sdo_.active = false;
+        sendSdoAbort(sdo_.index, sdo_.subindex, ABORT_TOGGLE_BIT);
+        return;
+      }
+      const std::size_t size(7 - ((request.data[0] >> 1) & 0x07));
+      sdo_.buffer.insert(sdo_.buffer.end(), request.data + 1, request.data + 1 + size);
+      if (request.data[0] & 0x01 /* last segment */) {
+        sdo_.active = false;
+        const boost::uint32_t abort_code(
+            writeObject(sdo_.index, sdo_.subindex, &sdo_.buffer[0], sdo_.buffer.size()));
+        if (abort_code != 0) {
+          sendSdoAbort(sdo_.index, sdo_.subindex, abort_code);
+          return;
+        }
+      }
+      can_frame response(makeFrame(CANOPEN_SDO_TX + node_id_, 8));
+      response.data[0] = 0x20 | sdo_.toggle;
+      send(response);
+      sdo_.toggle ^= 0x10;
+    } else if (command == 0x40 /* initiate upload */) {
+      const Dictionary::const_iterator object(dictionary_.find(key(index, subindex)));
+      if (object == dictionary_.end()) {
+        sendSdoAbort(index, subindex, ABORT_NO_OBJECT);
+        return;
+      }
+      const std::vector< unsigned char > &data(object->second.data);
+      if (data.size() <= 4) {
+        sendSdo(0x43 | ((4 - data.size()) << 2), index, subindex, &data[0], data.size());
+      } else {
+        sdo_.active = true;
+        sdo_.upload = true;
+        sdo_.index = index;
+        sdo_.subindex = subindex;
+        sdo_.buffer = data;
+        sdo_.offset = 0;
+        sdo_.toggle = 0;
+        const unsigned char size[4] = {static_cast< unsigned char >(data.size()), 0, 0, 0};
+        sendSdo(0x41, index, subindex, size, 4);
+      }
+    } else if (command == 0x60 /* upload segment */) {
+      if (!sdo_.active || !sdo_.upload) {
+        sendSdoAbort(0, 0, ABORT_INVALID_COMMAND);
+        return;
+      }
+      if ((request.data[0] & 0x10) != sdo_.toggle) {
+        sdo_.active = false;
+        sendSdoAbort(sdo_.index, sdo_.subindex, ABORT_TOGGLE_BIT);
+        return;
+      }
+      const std::size_t size(std::min< std::size_t >(7, sdo_.buffer.size() - sdo_.offset));
+      const bool last(sdo_.offset + size >= sdo_.buffer.size());
+      can_frame response(makeFrame(CANOPEN_SDO_TX + node_id_, 8));
+      response.data[0] = sdo_.toggle | ((7 - size) << 1) | (last ? 0x01 : 0x00);
+      std::memcpy(response.data + 1, &sdo_.buffer[sdo_.offset], size);
+      send(response);
+      sdo_.offset += size;
+      sdo_.toggle ^= 0x10;
+      sdo_.active = !last;
+    } else if (command == 0x80 /* abort */) {
+      sdo_.active = false;
+    } else {
+      sendSdoAbort(index, subindex, ABORT_INVALID_COMMAND);
+    }
+  }
+
+  void sendSdo(const unsigned char command, const unsigned short index,
+               const unsigned char subindex, const unsigned char *data, const std::size_t length) {
+    can_frame response(makeFrame(CANOPEN_SDO_TX + node_id_, 8));
+    response.data[0] = command;
+    response.data[1] = index & 0xFF;
+    response.data[2] = index >> 8;
+    response.data[3] = subindex;
+    if (data) {
+      std::memcpy(response.data + 4, data, length);
+    }
+    send(response);
+  }
+
+  void sendSdoAbort(const unsigned short index, const unsigned char subindex,
+                    const boost::uint32_t abort_code) {
+    const unsigned char data[4] = {static_cast< unsigned char >(abort_code & 0xFF),
+                                   static_cast< unsigned char >((abort_code >> 8) & 0xFF),
+                                   static_cast< unsigned char >((abort_code >> 16) & 0xFF),
+                                   static_cast< unsigned char >((abort_code >> 24) & 0xFF)};
+    sendSdo(0x80, index, subindex, data, 4);
+  }
+
+  //
+  // PDO & SYNC
+  //
+
+  // copy objects mapped to a PDO into a buffer. return false if the mapping is invalid.
+  bool readMappedObjects(const unsigned short mapping_index, std::vector< unsigned char > &data) {
+    data.clear();
+    const boost::uint8_t num_entries(get< boost::uint8_t >(mapping_index, 0x00));
+    for (unsigned char sub = 1; sub <= num_entries; ++sub) {
+      const boost::uint32_t entry(get< boost::uint32_t >(mapping_index, sub));
+      const Dictionary::const_iterator object(
+          dictionary_.find(key(entry >> 16, (entry >> 8) & 0xFF)));
+      if (object == dictionary_.end() || object->second.data.size() * 8 != (entry & 0xFF)) {
+        return false;
+      }
+      data.insert(data.end(), object->second.data.begin(), object->second.data.end());
+    }
+    return data.size() <= 8;
+  }
+
+  void transmitTpdo(const unsigned char number, const double time) {
+    std::vector< unsigned char > data;
+    if (!readMappedObjects(0x1A00 + number, data)) {
+      return;
+    }
+    const boost::uint32_t cob_id(get< boost::uint32_t >(0x1800 + number, 0x01));
+    send(cob_id & CAN_SFF_MASK, data.empty() ? NULL : &data[0], data.size());
+    last_tpdo_times_[number] = time;
+    last_tpdo_data_[number] = data;
+  }
+
+  void transmitEventTpdo(const unsigned char number, const double time) {
+    if (get< boost::uint32_t >(0x1800 + number, 0x01) & 0x80000000) {
+      return;
+    }
+    const double inhibit_time(get< boost::uint16_t >(0x1800 + number, 0x03) * 1e-4);
+    const double event_timer(get< boost::uint16_t >(0x1800 + number, 0x05) * 1e-3);
+    const double elapsed(time - last_tpdo_times_[number]);
+    if (last_tpdo_times_[number] >= 0. && elapsed < inhibit_time) {
+      return;
+    }
+    // transmit on change of mapped objects, or on expiration of the event timer
+    std::vector< unsigned char > data;
+    if (!readMappedObjects(0x1A00 + number, data)) {
+      return;
+    }
+    if (data != last_tpdo_data_[number] ||
+        (event_timer > 0. && (last_tpdo_times_[number] < 0. || elapsed >= event_timer))) {
+      transmitTpdo(number, time);
+    }
+  }
+
+  void handleRpdo(const unsigned char number, const can_frame &frame) {
+    const boost::uint8_t type(get< boost::uint8_t >(0x1400 + number, 0x02));
+    if (type <= 240) {
+      // synchronous RPDOs are applied on the next SYNC
+      pending_rpdos_[number] = frame;
+    } else {
+      applyRpdo(number, frame);
+    }
+  }
+
+  void applyRpdo(const unsigned char number, const can_frame &frame) {
+    const unsigned short mapping_index(0x1600 + number);
+    const boost::uint8_t num_entries(get< boost::uint8_t >(mapping_index, 0x00));
+    std::size_t offset(0);
+    for (unsigned char sub = 1; sub <= num_entries; ++sub) {
+      const boost::uint32_t entry(get< boost::uint32_t >(mapping_index, sub));
+      const std::size_t length((entry & 0xFF) / 8);
+      if (offset + length > frame.can_dlc) {
+        return;
+      }
+      writeObject(entry >> 16, (entry >> 8) & 0xFF, frame.data + offset, length);
+      offset += length;
+    }
+  }
+
+  void handleSync(const double time) {
+    if (nmt_state_ != CANOPEN_NMT_OPERATIONAL) {
+      return;
+    }
+    // apply synchronous RPDOs received since the last SYNC
+    for (std::map< unsigned char, can_frame >::const_iterator rpdo = pending_rpdos_.begin();
+         rpdo != pending_rpdos_.end(); ++rpdo) {
+      applyRpdo(rpdo->first, rpdo->second);
+    }
+    pending_rpdos_.clear();
+    // transmit synchronous TPDOs every N SYNCs
+    for (unsigned char number = 0; number < 4; ++number) {
+      const boost::uint8_t type(get< boost::uint8_t >(0x1800 + number, 0x02));
+      if (type == 0 || type > 240 || (get< boost::uint32_t >(0x1800 + number, 0x01) & 0x80000000)) {
+        continue;
+      }
+      if (++sync_counters_[number] >= type) {
+        sync_counters_[number] = 0;
+        transmitTpdo(number, time);
+      }
+    }
+  }
+
+  //
+  // CiA-402 state machine
+  //
+
+  enum State {
+    SWITCH_ON_DISABLED,
+    READY_TO_SWITCH_ON,
+    SWITCHED_ON,
+    OPERATION_ENABLED,
+    QUICK_STOP_ACTIVE,
+    FAULT
+  };
+
+  void applyControlword(const boost::uint16_t controlword) {
+    const bool fault_reset((controlword & 0x0080) && !(last_controlword_ & 0x0080));
+    const bool new_setpoint((controlword & 0x0010) && !(last_controlword_ & 0x0010));
+    const State last_state(state_);
+    last_controlword_ = controlword;
+
+    if (state_ == FAULT) {
+      if (fault_reset) {
+        state_ = SWITCH_ON_DISABLED;
+        set< boost::uint8_t >(0x1001, 0x00, 0);
+      }
+    } else if ((controlword & 0x0002) == 0 /* disable voltage */) {
+      state_ = SWITCH_ON_DISABLED;
+    } else if ((controlword & 0x0006) == 0x0002 /* quick stop */) {
+      state_ = (state_ == OPERATION_ENABLED) ? QUICK_STOP_ACTIVE : SWITCH_ON_DISABLED;
+    } else if ((controlword & 0x0087) == 0x0006 /* shutdown */) {
+      if (state_ != QUICK_STOP_ACTIVE) {
+        state_ = READY_TO_SWITCH_ON;
+      }
+    } else if ((controlword & 0x008F) == 0x0007 /* switch on */) {
+      if (state_ == READY_TO_SWITCH_ON || state_ == OPERATION_ENABLED) {
+        state_ = SWITCHED_ON;
+      }
+    } else if ((controlword & 0x008F) == 0x000F /* enable operation */) {
+      if (state_ == READY_TO_SWITCH_ON || state_ == SWITCHED_ON || state_ == QUICK_STOP_ACTIVE) {
+        state_ = OPERATION_ENABLED;
+      }
+    }
+
+    // hold the current position when enabled
+    if (state_ == OPERATION_ENABLED && last_state != OPERATION_ENABLED) {
+      position_target_ = position_;
+    }
+    // accept a new target in profile position mode
+    if (state_ == OPERATION_ENABLED && get< boost::int8_t >(0x6061, 0x00) == 1 && new_setpoint) {
+      const double target(get< boost::int32_t >(0x607A, 0x00));
+      position_target_ = (controlword & 0x0040 /* relative */) ? position_ + target : target;
+    }
+    updateStatusword();
+  }
+
+  void updateStatusword() {
+    boost::uint16_t statusword(0x0200 /* remote */ | 0x0010 /* voltage enabled */);
+    switch (state_) {
+    case SWITCH_ON_DISABLED:
+      statusword |= 0x0040;
+      break;
+    case READY_TO_SWITCH_ON:
+      statusword |= 0x0021;
+      break;
+    case SWITCHED_ON:
+      statusword |= 0x0023;
+      break;
+    case OPERATION_ENABLED:
+      statusword |= 0x0027;
+      break;
+    case QUICK_STOP_ACTIVE:
+      statusword |= 0x0007;
+      break;
+    case FAULT:
+      statusword |= 0x0008;
+      break;
+    }
+    const boost::int8_t mode(get< boost::int8_t >(0x6061, 0x00));
+    if (mode == 1) {
+      if (last_controlword_ & 0x0010) {
+        statusword |= 0x1000; // setpoint acknowledge
+      }
+      if (std::fabs(position_target_ - position_) <= get< boost::uint32_t >(0x6067, 0x00) &&
+          velocity_ == 0.) {
+        statusword |= 0x0400; // target reached
+      }
+    } else if (mode == 3) {
+      if (std::fabs(velocityTarget() - velocity_) <= get< boost::uint16_t >(0x606D, 0x00)) {
+        statusword |= 0x0400; // target reached
+      }
+    }
+    set< boost::uint16_t >(0x6041, 0x00, statusword);
+  }
+
+  //
+  // motor model
+  //
+
+  // quad-counts per revolution
+  double countsPerRevolution() const { return 4. * get< boost::uint32_t >(0x3010, 0x01); }
+
+  // torque constant in Nm/A
+  double torqueConstant() const { return get< boost::uint32_t >(0x3001, 0x05) * 1e-6; }
+
+  double velocityTarget() const {
+    return (get< boost::uint16_t >(0x6040, 0x00) & 0x0100 /* halt */)
+               ? 0.
+               : get< boost::int32_t >(0x60FF, 0x00);
+  }
+
+  // change velocity (rpm) toward a target with limited acceleration (rpm/s)
+  void rampVelocity(const double target, const double acceleration, const double dt) {
+    const double step(acceleration * dt);
+    velocity_ = (std::fabs(target - velocity_) <= step)
+                    ? target
+                    : velocity_ + (target > velocity_ ? step : -step);
+  }
+
+  void updateMotor(const double dt) {
+    const double counts_per_rev(countsPerRevolution());
+    const double last_velocity(velocity_);
+    const boost::int8_t mode(get< boost::int8_t >(0x6061, 0x00));
+
+    if (state_ == QUICK_STOP_ACTIVE) {
+      rampVelocity(0., get< boost::uint32_t >(0x6085, 0x00), dt);
+    } else if (state_ != OPERATION_ENABLED) {
+      // the motor coasts and stops by friction
+      rampVelocity(0., friction_deceleration_, dt);
+    } else if (mode == 1 /* profile position */) {
+      const double distance(position_target_ - position_);
+      const double deceleration(std::max< double >(get< boost::uint32_t >(0x6084, 0x00), 1.));
+      // velocity which can stop at the target with the deceleration (rpm)
+      const double stoppable(
+          std::sqrt(2. * deceleration * 60. * std::fabs(distance) / counts_per_rev));
+      const double target(std::min< double >(get< boost::uint32_t >(0x6081, 0x00), stoppable));
+      rampVelocity(distance > 0. ? target : -target, get< boost::uint32_t >(0x6083, 0x00), dt);
+      // settle at the target instead of passing it
+      if (std::fabs(distance) <= std::fabs(velocity_) / 60. * counts_per_rev * dt) {
+        position_ = position_target_;
+        velocity_ = 0.;
+      }
+    } else if (mode == 3 /* profile velocity */) {
+      const double target(velocityTarget());
+      rampVelocity(target, get< boost::uint32_t >(std::fabs(target) > std::fabs(velocity_)
+                                                      ? 0x6083
+                                                      : 0x6084,
+                                                  0x00),
+                   dt);
+    } else if (mode == 8 /* cyclic synchronous position */) {
+      const double target(get< boost::int32_t >(0x607A, 0x00));
+      velocity_ = (target - position_) / counts_per_rev / dt * 60.;
+    } else if (mode == 9 /* cyclic synchronous velocity */) {
+      velocity_ = get< boost::int32_t >(0x60FF, 0x00);
+    } else if (mode == 10 /* cyclic synchronous torque */) {
+      // torque in per mille of the rated torque
+      const double rated_torque(get< boost::uint32_t >(0x3001, 0x01) * 1e-3 * torqueConstant());
+      const double torque(get< boost::int16_t >(0x6071, 0x00) * 1e-3 * rated_torque);
+      const double omega(velocity_ * M_PI / 30.);
+      const double alpha((torque - damping_ * omega) / inertia_);
+      velocity_ += alpha * dt * 30. / M_PI;
+    }
+
+    // limit velocity
+    const double max_velocity(get< boost::uint32_t >(0x607F, 0x00));
+    velocity_ = std::max(-max_velocity, std::min(max_velocity, velocity_));
+    position_ += velocity_ / 60. * counts_per_rev * dt;
+
+    // current required by the motion
+    const double alpha((velocity_ - last_velocity) * M_PI / 30. / dt);
+    const double torque(inertia_ * alpha + damping_ * velocity_ * M_PI / 30.);
+    current_ = (state_ == OPERATION_ENABLED || state_ == QUICK_STOP_ACTIVE)
+                   ? torque / std::max(torqueConstant(), 1e-6) * 1000.
+                   : 0.;
+
+    // publish actual values
+    const double rated_torque(get< boost::uint32_t >(0x3001, 0x01) * 1e-3 * torqueConstant());
+    set< boost::int32_t >(0x6064, 0x00, static_cast< boost::int32_t >(std::floor(position_)));
+    set< boost::int32_t >(0x606C, 0x00, static_cast< boost::int32_t >(velocity_));
+    set< boost::int32_t >(0x30D1, 0x01, static_cast< boost::int32_t >(current_));
+    set< boost::int32_t >(0x30D1, 0x02, static_cast< boost::int32_t >(current_));
+    set< boost::int16_t >(0x6077, 0x00,
+                          rated_torque > 0. ? static_cast< boost::int16_t >(torque / rated_torque *
+                                                                            1000.)
+                                            : 0);
+  }
+
+  //
+  // frames
+  //
+
+  static can_frame makeFrame(const canid_t cob_id, const unsigned char length) {
+    can_frame frame;
+    std::memset(&frame, 0, sizeof(frame));
+    frame.can_id = cob_id;
+    frame.can_dlc = length;
+    return frame;
+  }
+
+  void send(const can_frame &frame) { sendFrame(socket_, stats_, frame); }
+
+  void send(const canid_t cob_id, const unsigned char *data, const std::size_t length) {
+    can_frame frame(makeFrame(cob_id, length));
+    if (data) {
+      std::memcpy(frame.data, data, length);
+    }
+    send(frame);
+  }
+
+private:
+  eh::SocketCan *const socket_;
+  BusStats &stats_;
+  const unsigned short node_id_;
+  const boost::uint64_t serial_number_;
+
+  Dictionary dictionary_;
+  unsigned char nmt_state_;
+  State state_;
+  boost::uint16_t last_controlword_;
+  SdoTransfer sdo_;
+  std::vector< unsigned int > sync_counters_;
+  std::vector< double > last_tpdo_times_;
+  std::vector< std::vector< unsigned char > > last_tpdo_data_;
+  std::map< unsigned char, can_frame > pending_rpdos_;
+  double last_heartbeat_time_;
+
+  // motor state (position in quad-counts, velocity in rpm, current in mA)
+  double position_, position_target_, velocity_, current_;
+  // motor constants (kg*m^2, Nm*s/rad, rpm/s)
+  static const double inertia_, damping_, friction_deceleration_;
+};
+
+const double SimulatedNode::inertia_(1e-5);
+const double SimulatedNode::damping_(1e-5);
+const double SimulatedNode::friction_deceleration_(5000.);
+
+//
+// MAXON SERIAL V2 server on a pseudo terminal
+//
+
+class SerialServer : boost::noncopyable {
+public:
+  explicit SerialServer(const std::vector< boost::shared_ptr< SimulatedNode > > &nodes)
+      : nodes_(nodes), master_fd_(-1), slave_fd_(-1), segment_node_(NULL) {
+    master_fd_ = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd_ < 0 || grantpt(master_fd_) < 0 || unlockpt(master_fd_) < 0) {
+      throw eh::EposException("posix_openpt (" + std::string(std::strerror(errno)) + ")");
+    }
+    port_name_ = ptsname(master_fd_);
+    // keep the slave opened so that the master is valid even if no clients are connected,
+    // and make it raw so that bytes are not altered before a client configures it
+    slave_fd_ = open(port_name_.c_str(), O_RDWR | O_NOCTTY);
+    if (slave_fd_ < 0) {
+      throw eh::EposException("open(" + port_name_ + ") (" + std::strerror(errno) + ")");
+    }
+    termios tio;
+    tcgetattr(slave_fd_, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd_, TCSANOW, &tio);
+  }
+
+  virtual ~SerialServer() {
+    close(slave_fd_);
+    close(master_fd_);
+  }
+
+  const std::string &getPortName() const { return port_name_; }
+
+  int getFileDescriptor() const { return master_fd_; }
+
+  // respond to all received requests in order
+  void process() {
+    unsigned char bytes[256];
+    const ssize_t size(read(master_fd_, bytes, sizeof(bytes)));
+    if (size < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        return;
+      }
+      throw eh::EposException("read(" + port_name_ + ") (" + std::strerror(errno) + ")");
+    }
+    std::vector< unsigned char > response_bytes;
+    for (ssize_t i = 0; i < size; ++i) {
+      eh::MaxonSerialFrame request;
+      if (decoder_.feed(bytes[i], request)) {
+        eh::encodeMaxonSerialFrame(handleRequest(request), response_bytes);
+      }
+    }
+    if (!response_bytes.empty() &&
+        write(master_fd_, &response_bytes[0], response_bytes.size()) < 0) {
+      throw eh::EposException("write(" + port_name_ + ") (" + std::strerror(errno) + ")");
+    }
+  }
+
+private:
+  eh::MaxonSerialFrame handleRequest(const eh::MaxonSerialFrame &request) {
+    eh::MaxonSerialFrame response(MAXON_SERIAL_RESPONSE);
+    const std::vector< unsigned char > &data(request.data);
+    // node id 0 means the node connected directly
+    SimulatedNode *const node(data.empty() ? NULL : findNode(data[0]));
+    if (!node) {
+      response.addUint32(0x05040000 /* timeout of the gateway */);
+      return response;
+    }
+    const unsigned short index(data.size() >= 4 ? data[1] | (data[2] << 8) : 0);
+    const unsigned char subindex(data.size() >= 4 ? data[3] : 0);
+
+    switch (request.op_code) {
+    case MAXON_SERIAL_READ_OBJECT: {
+      std::vector< unsigned char > value;
+      boost::uint32_t error_code(node->readObject(index, subindex, value));
+      if (error_code == 0 && value.size() > 4) {
+        error_code = ABORT_LENGTH_MISMATCH;
+      }
+      value.resize(4, 0);
+      response.addUint32(error_code);
+      response.addBytes(&value[0], 4);
+      break;
+    }
+    case MAXON_SERIAL_WRITE_OBJECT: {
+      std::vector< unsigned char > value;
+      boost::uint32_t error_code(node->readObject(index, subindex, value));
+      if (error_code == 0) {
+        error_code = (value.size() > 4 || data.size() < 8)
+                         ? ABORT_LENGTH_MISMATCH
+                         : node->writeObject(index, subindex, &data[4], value.size());
+      }
+      response.addUint32(error_code);
+      break;
+    }
+    case MAXON_SERIAL_INIT_SEGMENT_READ: {
+      const boost::uint32_t error_code(node->readObject(index, subindex, segment_buffer_));
+      segment_node_ = (error_code == 0) ? node : NULL;
+      segment_upload_ = true;
+      segment_offset_ = 0;
+      segment_toggle_ = 0;
+      response.addUint32(error_code);
+      response.addUint32(segment_buffer_.size());
+      break;
+    }
+    case MAXON_SERIAL_SEGMENT_READ: {
+      const unsigned char toggle(data.size() >= 2 ? data[1] & MAXON_SERIAL_SEGMENT_TOGGLE : 0);
+      if (segment_node_ != node || !segment_upload_ || toggle != segment_toggle_) {
+        segment_node_ = NULL;
+        response.addUint32(ABORT_TOGGLE_BIT);
+        break;
+      }
+      const std::size_t size(std::min< std::size_t >(MAXON_SERIAL_SEGMENT_LENGTH_MASK,
+                                                     segment_buffer_.size() - segment_offset_));
+      const bool last(segment_offset_ + size >= segment_buffer_.size());
+      response.addUint32(0);
+      response.addUint8(toggle | (last ? MAXON_SERIAL_SEGMENT_LAST : 0) | size);
+      response.addBytes(&segment_buffer_[segment_offset_], size);
+      segment_offset_ += size;
+      segment_toggle_ ^= MAXON_SERIAL_SEGMENT_TOGGLE;
+      if (last) {
+        segment_node_ = NULL;
+      }
+      break;
+    }
+    case MAXON_SERIAL_INIT_SEGMENT_WRITE: {
+      segment_node_ = node;
+      segment_upload_ = false;
+      segment_index_ = index;
+      segment_subindex_ = subindex;
+      segment_buffer_.clear();
+      segment_toggle_ = 0;
+      response.addUint32(0);
+      break;
+    }
+    case MAXON_SERIAL_SEGMENT_WRITE: {
+      const unsigned char control(data.size() >= 2 ? data[1] : 0);
+      const unsigned char toggle(control & MAXON_SERIAL_SEGMENT_TOGGLE);
+      const std::size_t size(control & MAXON_SERIAL_SEGMENT_LENGTH_MASK);
+      if (segment_node_ != node || segment_upload_ || toggle != segment_toggle_ ||
+          data.size() < 2 + size) {
+        segment_node_ = NULL;
+        response.addUint32(ABORT_TOGGLE_BIT);
+        break;
+      }
+      segment_buffer_.insert(segment_buffer_.end(), data.begin() + 2, data.begin() + 2 + size);
+      boost::uint32_t error_code(0);
+      if (control & MAXON_SERIAL_SEGMENT_LAST) {
+        segment_node_ = NULL;
+        error_code = node->writeObject(segment_index_, segment_subindex_, &segment_buffer_[0],
+                                       segment_buffer_.size());
+      }
+      segment_toggle_ ^= MAXON_SERIAL_SEGMENT_TOGGLE;
+      response.addUint32(error_code);
+      response.addUint8(toggle);
+      break;
+    }
+    default:
+      response.addUint32(ABORT_INVALID_COMMAND);
+      break;
+    }
+    return response;
+  }
+
+  SimulatedNode *findNode(const unsigned short node_id) const {
+    if (node_id == 0) {
+      return nodes_.front().get();
+    }
+    BOOST_FOREACH (const boost::shared_ptr< SimulatedNode > &node, nodes_) {
+      if (node->getNodeId() == node_id) {
+        return node.get();
+      }
+    }
+    return NULL;
+  }
+
+private:
+  const std::vector< boost::shared_ptr< SimulatedNode > > nodes_;
+  int master_fd_, slave_fd_;
+  std::string port_name_;
+  eh::MaxonSerialDecoder decoder_;
+
+  // segmented transfer in progress (null node if none)
+  SimulatedNode *segment_node_;
+  bool segment_upload_;
+  unsigned short segment_index_;
+  unsigned char segment_subindex_;
+  std::vector< unsigned char > segment_buffer_;
+  std::size_t segment_offset_;
+  unsigned char segment_toggle_;
+};
+
+//
+// main
+//
+
+int main(int argc, char *argv[]) {
+  std::string interface_name, serial_number_str;
+  std::vector< unsigned short > node_ids;
+  double period, stats_period, fault_at, load_rate;
+  unsigned int bitrate, load_length;
+  unsigned short load_cob_id;
+  bool use_pty;
+  try {
+    // define available options
+    bpo::options_description options;
+    bool show_help;
+    options.add(
+        boost::make_shared< bpo::option_description >("help", bpo::bool_switch(&show_help)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "interface", bpo::value(&interface_name)->default_value("vcan0")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "node-ids", bpo::value(&node_ids)->multitoken()->default_value(
+                        std::vector< unsigned short >(1, 1), "1")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "serial-number", bpo::value(&serial_number_str)->default_value("682129000000")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "period", bpo::value(&period)->default_value(1.)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "fault-at", bpo::value(&fault_at)->default_value(0.)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "load-rate", bpo::value(&load_rate)->default_value(0.)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "load-cob-id", bpo::value(&load_cob_id)->default_value(0x7FF)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "load-length", bpo::value(&load_length)->default_value(8)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "bitrate", bpo::value(&bitrate)->default_value(1000000)));
+    options.add(boost::make_shared< bpo::option_description >(
+        "stats-period", bpo::value(&stats_period)->default_value(1.)));
+    options.add(boost::make_shared< bpo::option_description >("pty", bpo::bool_switch(&use_pty)));
+    // parse the command line
+    bpo::variables_map args;
+    bpo::store(bpo::parse_command_line(argc, argv, options), args);
+    bpo::notify(args);
+    // show help if requested
+    if (show_help) {
+      std::cout << "Available options:\n"
+                << options << "\n"
+                << "  --interface: CAN network interface (empty: no CAN)\n"
+                << "  --pty: serve MAXON SERIAL V2 on a pseudo terminal\n"
+                << "  --period: simulation step in ms\n"
+                << "  --serial-number: serial number of the first node in hex "
+                << "(incremented for the following nodes)\n"
+                << "  --fault-at: time in s to inject a following error (0: never)\n"
+                << "  --load-rate: frames per second of background traffic (0: none)\n"
+                << "  --bitrate, --stats-period: bus load report (0: no report)" << std::endl;
+      return 0;
+    }
+  } catch (const bpo::error &error) {
+    std::cerr << "Error: " << error.what() << std::endl;
+    return 1;
+  }
+
+  boost::uint64_t serial_number;
+  {
+    std::istringstream iss(serial_number_str);
+    iss >> std::hex >> serial_number;
+    if (!iss) {
+      std::cerr << "Error: Invalid serial number (" << serial_number_str << ")" << std::endl;
+      return 1;
+    }
+  }
+  if (load_length > 8 || period <= 0.) {
+    std::cerr << "Error: Invalid load length or period" << std::endl;
+    return 1;
+  }
+  if (interface_name.empty() && !use_pty) {
+    std::cerr << "Error: Neither CAN interface nor pty is enabled" << std::endl;
+    return 1;
+  }
+
+  try {
+    boost::scoped_ptr< eh::SocketCan > socket(
+        interface_name.empty() ? NULL : new eh::SocketCan(interface_name));
+    BusStats stats;
+
+    // create & boot nodes
+    std::vector< boost::shared_ptr< SimulatedNode > > nodes;
+    const double start_time(now());
+    BOOST_FOREACH (const unsigned short node_id, node_ids) {
+      if (node_id < 1 || node_id > MAX_NODE_ID) {
+        std::cerr << "Error: Invalid node id (" << node_id << ")" << std::endl;
+        return 1;
+      }
+      nodes.push_back(boost::make_shared< SimulatedNode >(
+          socket.get(), boost::ref(stats), node_id, serial_number + nodes.size()));
+      nodes.back()->boot(start_time);
+      std::cout << "Simulating EPOS4 node " << node_id << " (serial number 0x" << std::hex
+                << serial_number + nodes.size() - 1 << std::dec << ")";
+      if (socket) {
+        std::cout << " on " << interface_name;
+      }
+      std::cout << std::endl;
+    }
+    boost::scoped_ptr< SerialServer > serial_server(use_pty ? new SerialServer(nodes) : NULL);
+    if (serial_server) {
+      std::cout << "Serving MAXON SERIAL V2 on " << serial_server->getPortName() << std::endl;
+    }
+
+    // file descriptors to wait
+    std::vector< pollfd > pfds;
+    if (socket) {
+      const pollfd pfd = {socket->getFileDescriptor(), POLLIN, 0};
+      pfds.push_back(pfd);
+    }
+    if (serial_server) {
+      const pollfd pfd = {serial_server->getFileDescriptor(), POLLIN, 0};
+      pfds.push_back(pfd);
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    const double dt(period / 1000.);
+    double next_tick(start_time + dt), next_load(start_time), next_stats(start_time + stats_period);
+    bool fault_injected(false);
+    boost::uint64_t load_counter(0);
+    BusStats last_stats;
+    while (stop_requested == 0) {
+      // process received frames & requests until the next tick
+      const double remaining(next_tick - now());
+      if (remaining > 0.) {
+        if (poll(&pfds[0], pfds.size(), static_cast< int >(std::ceil(remaining * 1000.))) <= 0) {
+          continue;
+        }
+        can_frame frame;
+        if (socket && (pfds.front().revents & POLLIN) && socket->receive(frame, 0)) {
+          ++stats.rx_frames;
+          stats.rx_bits += frameBits(frame);
+          const double time(now());
+          BOOST_FOREACH (const boost::shared_ptr< SimulatedNode > &node, nodes) {
+            node->handleFrame(frame, time);
+          }
+        }
+        if (serial_server && (pfds.back().revents & POLLIN)) {
+          serial_server->process();
+        }
+        continue;
+      }
+      const double time(now());
+      if (time < next_tick) {
+        continue;
+      }
+      next_tick += dt;
+
+      // simulation step
+      BOOST_FOREACH (const boost::shared_ptr< SimulatedNode > &node, nodes) {
+        node->update(time, dt);
+      }
+      if (fault_at > 0. && !fault_injected && time - start_time >= fault_at) {
+        BOOST_FOREACH (const boost::shared_ptr< SimulatedNode > &node, nodes) {
+          node->injectFault(0x8611 /* following error */);
+        }
+        fault_injected = true;
+      }
+
+      // background traffic
+      if (load_rate > 0.) {
+        while (next_load <= time) {
+          can_frame load_frame;
+          std::memset(&load_frame, 0, sizeof(load_frame));
+          load_frame.can_id = load_cob_id & CAN_SFF_MASK;
+          load_frame.can_dlc = load_length;
+          std::memcpy(load_frame.data, &load_counter, load_length);
+          sendFrame(socket.get(), stats, load_frame);
+          ++load_counter;
+          next_load += 1. / load_rate;
+        }
+      }
+
+      // bus load report
+      if (stats_period > 0. && time >= next_stats) {
+        const double rx_rate((stats.rx_frames - last_stats.rx_frames) / stats_period);
+        const double tx_rate((stats.tx_frames - last_stats.tx_frames) / stats_period);
+        const double bus_load(100. *
+                              ((stats.rx_bits - last_stats.rx_bits) +
+                               (stats.tx_bits - last_stats.tx_bits)) /
+                              (stats_period * bitrate));
+        std::cout << "rx: " << rx_rate << " frames/s, tx: " << tx_rate
+                  << " frames/s, bus load: " << bus_load << " % (without bit stuffing)";
+        if (stats.tx_errors > last_stats.tx_errors) {
+          std::cout << ", tx dropped: " << (stats.tx_errors - last_stats.tx_errors);
+        }
+        std::cout << std::endl;
+        last_stats = stats;
+        next_stats += stats_period;
+      }
+    }
+  } catch (const eh::EposException &error) {
+    std::cerr << "Error: " << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <string>
 
+#include <eposx_hardware/transport.h>
 #include <eposx_hardware/utils.h>
 #include <eposx_library/Definitions.h>
 
@@ -19,7 +20,7 @@ namespace eh = eposx_hardware;
 namespace bpo = boost::program_options;
 
 int main(int argc, char *argv[]) {
-  eh::DeviceInfo device_info;
+  eh::DeviceInfo device_info, gateway_info;
   std::string serial_number_str;
   unsigned short node_id, max_node_id;
   try {
@@ -37,6 +38,15 @@ int main(int argc, char *argv[]) {
         "interface", bpo::value(&device_info.interface_name)->default_value("USB")));
     options.add(boost::make_shared< bpo::option_description >(
         "port", bpo::value(&device_info.port_name)->default_value("")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "gateway-device", bpo::value(&gateway_info.device_name)->default_value("EPOS4")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "gateway-protocol-stack",
+        bpo::value(&gateway_info.protocol_stack_name)->default_value("MAXON SERIAL V2")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "gateway-interface", bpo::value(&gateway_info.interface_name)->default_value("")));
+    options.add(boost::make_shared< bpo::option_description >(
+        "gateway-port", bpo::value(&gateway_info.port_name)->default_value("")));
     options.add(boost::make_shared< bpo::option_description >(
         "serial-number", bpo::value(&serial_number_str)->default_value("0")));
     options.add(boost::make_shared< bpo::option_description >(
@@ -67,28 +77,39 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // access the node via a gateway if gateway's interface is given
+  if (!gateway_info.interface_name.empty()) {
+    device_info = eh::DeviceInfo(gateway_info, device_info.device_name,
+                                 device_info.protocol_stack_name);
+  }
+
   std::cout << "Identifing a node for\n"
             << "  device: " << device_info.device_name << "\n"
-            << "  protocol stack: " << device_info.protocol_stack_name << "\n"
-            << "  interface: " << device_info.interface_name << "\n"
-            << "  port (ignored if empty): " << device_info.port_name << "\n"
-            << "  node id (ignored if 0): " << node_id << "\n"
+            << "  protocol stack: " << device_info.protocol_stack_name << "\n";
+  if (device_info.isSubDevice()) {
+    std::cout << "  gateway device: " << gateway_info.device_name << "\n"
+              << "  gateway protocol stack: " << gateway_info.protocol_stack_name << "\n"
+              << "  gateway interface: " << gateway_info.interface_name << "\n"
+              << "  gateway port (ignored if empty): " << gateway_info.port_name << "\n";
+  } else {
+    std::cout << "  interface: " << device_info.interface_name << "\n"
+              << "  port (ignored if empty): " << device_info.port_name << "\n";
+  }
+  std::cout << "  node id (ignored if 0): " << node_id << "\n"
             << "  serial number (ignored if 0): " << serial_number_str << std::endl;
 
   try {
     eh::NodeHandle epos_handle(
         eh::createNodeHandle(device_info, node_id, serial_number, max_node_id));
+    const eh::DeviceLock lock(epos_handle);
 
-    int position;
-    VCS_NN(GetPositionIs, epos_handle, &position);
+    const int position(epos_handle.transport->getPositionIs(epos_handle.node_id));
     std::cout << "Position: " << std::dec << position << std::endl;
 
-    int velocity;
-    VCS_NN(GetVelocityIs, epos_handle, &velocity);
+    const int velocity(epos_handle.transport->getVelocityIs(epos_handle.node_id));
     std::cout << "Velocity: " << std::dec << velocity << std::endl;
 
-    short current;
-    VCS_NN(GetCurrentIs, epos_handle, &current);
+    const short current(epos_handle.transport->getCurrentIs(epos_handle.node_id));
     std::cout << "Current: " << std::dec << current << std::endl;
   } catch (const eh::EposException &error) {
     std::cerr << "Error: " << error.what() << std::endl;
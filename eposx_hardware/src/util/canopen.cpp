@@ -0,0 +1,326 @@
+#include <cerrno>
+#include <cstring>
+#include <ios>
+
+#include <eposx_hardware/canopen.h>
+#include <eposx_hardware/utils.h>
+#include <ros/console.h>
+
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace eposx_hardware {
+
+//
+// emergency message
+//
+
+bool decodeEmcy(const can_frame &frame, unsigned short &node_id, CanopenEmcy &emcy) {
+  // an emergency has COB-ID 0x081-0x0FF (0x080 is SYNC) and 8 bytes of data
+  const canid_t cob_id(frame.can_id & CAN_SFF_MASK);
+  if ((frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG)) != 0 || cob_id <= CANOPEN_EMCY ||
+      cob_id > CANOPEN_EMCY + 0x7F || frame.can_dlc != 8) {
+    return false;
+  }
+  node_id = cob_id - CANOPEN_EMCY;
+  emcy.error_code = frame.data[0] | (frame.data[1] << 8);
+  emcy.error_register = frame.data[2];
+  std::memcpy(emcy.manufacturer_error, frame.data + 3, 5);
+  return true;
+}
+
+//
+// heartbeat
+//
+
+bool decodeHeartbeat(const can_frame &frame, unsigned short &node_id, unsigned char &nmt_state) {
+  // a boot-up or heartbeat has COB-ID 0x701-0x77F and 1 byte of data
+  const canid_t cob_id(frame.can_id & CAN_SFF_MASK);
+  if ((frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG)) != 0 || cob_id <= CANOPEN_HEARTBEAT ||
+      cob_id > CANOPEN_HEARTBEAT + 0x7F || frame.can_dlc != 1) {
+    return false;
+  }
+  node_id = cob_id - CANOPEN_HEARTBEAT;
+  // the toggle bit is used only for node guarding
+  nmt_state = frame.data[0] & 0x7F;
+  return true;
+}
+
+//
+// SocketCan
+//
+
+std::vector< std::string > getSocketCanInterfaceNames() {
+  const int fd(socket(PF_CAN, SOCK_RAW, CAN_RAW));
+  if (fd < 0) {
+    throw EposException("socket (" + std::string(std::strerror(errno)) + ")");
+  }
+  std::vector< std::string > interface_names;
+  struct if_nameindex *const entries(if_nameindex());
+  for (const struct if_nameindex *entry = entries; entry && entry->if_index != 0; ++entry) {
+    // pick network interfaces whose hardware type is CAN
+    ifreq ifr;
+    std::memset(&ifr, 0, sizeof(ifr));
+    std::strncpy(ifr.ifr_name, entry->if_name, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0 && ifr.ifr_hwaddr.sa_family == ARPHRD_CAN) {
+      interface_names.push_back(entry->if_name);
+    }
+  }
+  if (entries) {
+    if_freenameindex(entries);
+  }
+  close(fd);
+  return interface_names;
+}
+
+SocketCan::SocketCan(const std::string &interface_name)
+    : interface_name_(interface_name), fd_(-1) {
+  fd_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd_ < 0) {
+    throw EposException("socket (" + std::string(std::strerror(errno)) + ")");
+  }
+
+  // bind the socket to the interface
+  ifreq ifr;
+  std::memset(&ifr, 0, sizeof(ifr));
+  std::strncpy(ifr.ifr_name, interface_name_.c_str(), IFNAMSIZ - 1);
+  if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0) {
+    const std::string error(std::strerror(errno));
+    close(fd_);
+    throw EposException("ioctl(SIOCGIFINDEX, " + interface_name_ + ") (" + error + ")");
+  }
+  sockaddr_can addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(fd_, reinterpret_cast< sockaddr * >(&addr), sizeof(addr)) < 0) {
+    const std::string error(std::strerror(errno));
+    close(fd_);
+    throw EposException("bind(" + interface_name_ + ") (" + error + ")");
+  }
+}
+
+SocketCan::~SocketCan() { close(fd_); }
+
+const std::string &SocketCan::getInterfaceName() const { return interface_name_; }
+
+int SocketCan::getFileDescriptor() const { return fd_; }
+
+void SocketCan::send(const can_frame &frame) {
+  if (write(fd_, &frame, sizeof(frame)) != sizeof(frame)) {
+    throw EposException("write(" + interface_name_ + ") (" + std::strerror(errno) + ")");
+  }
+}
+
+bool SocketCan::trySend(const can_frame &frame) {
+  if (::send(fd_, &frame, sizeof(frame), MSG_DONTWAIT) == sizeof(frame)) {
+    return true;
+  }
+  if (errno == ENOBUFS || errno == EAGAIN) {
+    return false;
+  }
+  throw EposException("send(" + interface_name_ + ") (" + std::strerror(errno) + ")");
+}
+
+void SocketCan::setFilters(const std::vector< can_filter > &filters) {
+  // standard data frames only
+  std::vector< can_filter > raw_filters(filters);
+  BOOST_FOREACH (can_filter &raw_filter, raw_filters) {
+    raw_filter.can_mask |= CAN_EFF_FLAG | CAN_RTR_FLAG;
+  }
+  if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, raw_filters.empty() ? NULL : &raw_filters[0],
+                 raw_filters.size() * sizeof(can_filter)) < 0) {
+    throw EposException("setsockopt(CAN_RAW_FILTER, " + interface_name_ + ") (" +
+                        std::strerror(errno) + ")");
+  }
+}
+
+bool SocketCan::receive(can_frame &frame, const unsigned int timeout) {
+  pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+  const int result(poll(&pfd, 1, timeout));
+  if (result < 0) {
+    if (errno == EINTR) {
+      return false;
+    }
+    throw EposException("poll(" + interface_name_ + ") (" + std::strerror(errno) + ")");
+  }
+  if (result == 0) {
+    return false;
+  }
+  if (read(fd_, &frame, sizeof(frame)) != sizeof(frame)) {
+    throw EposException("read(" + interface_name_ + ") (" + std::strerror(errno) + ")");
+  }
+  return true;
+}
+
+//
+// CanopenMonitor
+//
+
+// interval to check the stop request
+#define CANOPEN_MONITOR_POLL_TIMEOUT 100
+
+CanopenMonitor::NodeStatus::NodeStatus() : num_emcys(0), has_heartbeat(false), nmt_state(0) {
+  std::memset(&emcy, 0, sizeof(emcy));
+}
+
+CanopenMonitor::CanopenMonitor(const std::string &interface_name)
+    : interface_name_(interface_name), stopping_(false) {
+  openSocket();
+  thread_ = boost::thread(boost::bind(&CanopenMonitor::run, this));
+}
+
+CanopenMonitor::~CanopenMonitor() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    stopping_ = true;
+  }
+  thread_.join();
+}
+
+void CanopenMonitor::setEmcyCallback(const unsigned short node_id,
+                                     const EmcyCallback &callback) {
+  boost::lock_guard< boost::mutex > lock(callback_mutex_);
+  if (callback) {
+    emcy_callbacks_[node_id] = callback;
+  } else {
+    emcy_callbacks_.erase(node_id);
+  }
+}
+
+unsigned int CanopenMonitor::getLatestEmcy(const unsigned short node_id,
+                                           CanopenEmcy &emcy) const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  const std::map< unsigned short, NodeStatus >::const_iterator node_status(
+      node_statuses_.find(node_id));
+  if (node_status == node_statuses_.end()) {
+    return 0;
+  }
+  emcy = node_status->second.emcy;
+  return node_status->second.num_emcys;
+}
+
+bool CanopenMonitor::getLatestHeartbeat(const unsigned short node_id, unsigned char &nmt_state,
+                                        ros::WallTime &stamp) const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  const std::map< unsigned short, NodeStatus >::const_iterator node_status(
+      node_statuses_.find(node_id));
+  if (node_status == node_statuses_.end() || !node_status->second.has_heartbeat) {
+    return false;
+  }
+  nmt_state = node_status->second.nmt_state;
+  stamp = node_status->second.heartbeat_stamp;
+  return true;
+}
+
+void CanopenMonitor::run() {
+  while (true) {
+    {
+      boost::lock_guard< boost::mutex > lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+    }
+
+    can_frame frame;
+    try {
+      if (!socket_->receive(frame, CANOPEN_MONITOR_POLL_TIMEOUT)) {
+        continue;
+      }
+    } catch (const EposException &error) {
+      ROS_ERROR_STREAM_THROTTLE(1., error.what());
+      boost::this_thread::sleep(boost::posix_time::milliseconds(CANOPEN_MONITOR_POLL_TIMEOUT));
+      // the interface may have been replugged
+      try {
+        openSocket();
+      } catch (const EposException &) {
+        // retry on the next error
+      }
+      continue;
+    }
+
+    unsigned short node_id;
+    CanopenEmcy emcy;
+    unsigned char nmt_state;
+    if (decodeEmcy(frame, node_id, emcy)) {
+      handleEmcy(node_id, emcy);
+    } else if (decodeHeartbeat(frame, node_id, nmt_state)) {
+      handleHeartbeat(node_id, nmt_state);
+    }
+  }
+}
+
+void CanopenMonitor::openSocket() {
+  boost::scoped_ptr< SocketCan > socket(new SocketCan(interface_name_));
+  std::vector< can_filter > filters(2);
+  // 0x080-0x0FF (SYNC is dropped by decodeEmcy())
+  filters[0].can_id = CANOPEN_EMCY;
+  filters[0].can_mask = 0x780;
+  // 0x700-0x77F
+  filters[1].can_id = CANOPEN_HEARTBEAT;
+  filters[1].can_mask = 0x780;
+  socket->setFilters(filters);
+  socket_.swap(socket);
+}
+
+void CanopenMonitor::handleEmcy(const unsigned short node_id, const CanopenEmcy &emcy) {
+  // error code 0 tells the node has recovered from all errors
+  if (emcy.error_code != 0) {
+    ROS_ERROR_STREAM("EMCY from node " << node_id << " on " << interface_name_
+                                       << ": 0x" << std::hex << emcy.error_code
+                                       << " (error register: 0x"
+                                       << static_cast< unsigned int >(emcy.error_register)
+                                       << ")");
+  } else {
+    ROS_INFO_STREAM("EMCY from node " << node_id << " on " << interface_name_
+                                      << ": error reset");
+  }
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    NodeStatus &node_status(node_statuses_[node_id]);
+    ++node_status.num_emcys;
+    node_status.emcy = emcy;
+  }
+
+  boost::lock_guard< boost::mutex > lock(callback_mutex_);
+  const std::map< unsigned short, EmcyCallback >::const_iterator callback(
+      emcy_callbacks_.find(node_id));
+  if (callback != emcy_callbacks_.end()) {
+    callback->second(emcy);
+  }
+}
+
+void CanopenMonitor::handleHeartbeat(const unsigned short node_id, const unsigned char nmt_state) {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  NodeStatus &node_status(node_statuses_[node_id]);
+  node_status.has_heartbeat = true;
+  node_status.nmt_state = nmt_state;
+  node_status.heartbeat_stamp = ros::WallTime::now();
+}
+
+boost::shared_ptr< CanopenMonitor > getCanopenMonitor(const std::string &interface_name) {
+  static boost::mutex mutex;
+  static std::map< std::string, boost::weak_ptr< CanopenMonitor > > existing_monitors;
+
+  boost::lock_guard< boost::mutex > lock(mutex);
+  boost::weak_ptr< CanopenMonitor > &existing_monitor(existing_monitors[interface_name]);
+  boost::shared_ptr< CanopenMonitor > monitor(existing_monitor.lock());
+  if (!monitor) {
+    monitor.reset(new CanopenMonitor(interface_name));
+    existing_monitor = monitor;
+  }
+  return monitor;
+}
+
+} // namespace eposx_hardware
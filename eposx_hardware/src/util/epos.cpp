@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ios>
 #include <limits>
 #include <sstream>
@@ -6,6 +7,10 @@
 #include <battery_state_interface/battery_state_interface.hpp>
 #include <eposx_hardware/epos.h>
 #include <eposx_hardware/epos_diagnostic_updater.h>
+#include <eposx_hardware/executor.h>
+#include <eposx_hardware/object_dictionary.h>
+#include <eposx_hardware/serial_transport.h>
+#include <eposx_hardware/transport.h>
 #include <hardware_interface/actuator_command_interface.h>
 #include <hardware_interface/actuator_state_interface.h>
 
@@ -14,14 +19,36 @@
 #include <boost/cstdint.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 
 namespace eposx_hardware {
 
-Epos::Epos() : position_(0), velocity_(0), effort_(0), current_(0) {}
+Epos::Epos()
+    : num_emcys_(0), heartbeat_timeout_(0.), nmt_state_(CANOPEN_NMT_PRE_OPERATIONAL),
+      is_alive_(true), max_read_failures_(0), num_read_failures_(0), is_reconnecting_(false),
+      max_timeouts_(0), num_timeouts_(0), is_quarantined_(false), probe_interval_(0.),
+      host_node_id_(0), host_heartbeat_consumer_time_(0.), position_(0),
+      velocity_(0), effort_(0), current_(0), statusword_(0), position_marker_counter_(0),
+      device_error_bits_(0), are_device_errors_stale_(true), is_position_compare_stale_(true),
+      fast_state_machine_(false) {}
 
 Epos::~Epos() {
+  // the monitor thread notifies faults to the recovery
+  if (canopen_monitor_) {
+    canopen_monitor_->setEmcyCallback(epos_handle_.node_id, CanopenMonitor::EmcyCallback());
+  }
+  // stop recovery first so that the node is never enabled again
+  fault_recovery_.reset();
+  // the probe in flight accesses the device
+  if (probe_.valid()) {
+    probe_.wait();
+  }
+  // init() failed before opening the device
+  if (!epos_handle_.transport) {
+    return;
+  }
   try {
-    VCS_N0(SetDisableState, epos_handle_);
+    setDisableState();
   } catch (const EposException &error) {
     ROS_ERROR_STREAM(error.what());
   }
@@ -38,24 +65,51 @@ void Epos::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
   initHardwareInterface(hw, motor_nh);
 
   initEposNodeHandle(motor_nh);
+  // keep other threads (e.g. tools or other motors on the same port) off the device
+  // until the node is configured
+  const DeviceLock lock(epos_handle_);
   initProtocolStackSettings(motor_nh);
-
-  VCS_N0(SetDisableState, epos_handle_);
-
+  initCanopenMonitor(motor_nh);
+  initPdo(motor_nh);
   initOperationMode(hw, root_nh, motor_nh);
-  initFaultReaction(motor_nh);
-  initMotorParameter(motor_nh);
-  initSensorParameter(motor_nh);
-  initSafetyParameter(motor_nh);
-  initPositionRegulator(motor_nh);
-  initVelocityRegulator(motor_nh);
-  initCurrentRegulator(motor_nh);
-  initPositionProfile(motor_nh);
-  initVelocityProfile(motor_nh);
-  initDeviceError(motor_nh);
+  initFaultRecovery(motor_nh);
+  initEmcyCallback();
+  initReconnection(motor_nh);
+  initCircuitBreaker(motor_nh);
   initMiscParameters(motor_nh);
+  initPositionCompareServer(motor_nh);
+
+  // write parameters to the node, which is repeated on reconnection
+  motor_nh_ = motor_nh;
+  configure();
+}
+
+void Epos::configure() {
+  initHeartbeat(motor_nh_);
 
-  VCS_N0(SetEnableState, epos_handle_);
+  setDisableState();
+
+  initFaultReaction(motor_nh_);
+  initMotorParameter(motor_nh_);
+  initSensorParameter(motor_nh_);
+  initSafetyParameter(motor_nh_);
+  initPositionRegulator(motor_nh_);
+  initVelocityRegulator(motor_nh_);
+  initCurrentRegulator(motor_nh_);
+  initPositionProfile(motor_nh_);
+  initVelocityProfile(motor_nh_);
+  initDeviceError(motor_nh_);
+  initCommunicationTimeout(motor_nh_);
+  initPositionMarker(motor_nh_);
+  initPositionCompare(motor_nh_);
+
+  setEnableState();
+
+  // start exchanging PDOs after the node is enabled
+  // so that the process image is initialized with the enabled controlword
+  if (pdo_) {
+    pdo_->start();
+  }
 }
 
 // helper function to register a handle to a hardware interface in hardware
@@ -90,14 +144,44 @@ void Epos::initHardwareInterface(hardware_interface::RobotHW &hw, ros::NodeHandl
     registerTo< bsi::BatteryStateInterface >(
         hw, bsi::BatteryStateHandle(power_supply_name, power_supply_state_.get()));
   }
+
+  // if position_marker is given, additionally register captured positions
+  if (motor_nh.hasParam("position_marker")) {
+    position_marker_data_.reset(new EposPositionMarkerData);
+    registerTo< EposPositionMarkerInterface >(
+        hw, EposPositionMarkerHandle(motor_name_, position_marker_data_.get()));
+  }
+
+  // if position_compare is given, additionally register the position compare command
+  if (motor_nh.hasParam("position_compare")) {
+    position_compare_command_.reset(new EposPositionCompareCommand);
+    motor_nh.param("position_compare/reference_position",
+                   position_compare_command_->reference_position, 0.);
+    motor_nh.param("position_compare/enabled", position_compare_command_->enabled, false);
+    registerTo< EposPositionCompareInterface >(
+        hw, EposPositionCompareHandle(motor_name_, position_compare_command_.get()));
+  }
 }
 
 void Epos::initEposNodeHandle(ros::NodeHandle &motor_nh) {
   // load optional device info
-  const DeviceInfo device_info(motor_nh.param< std::string >("device", "EPOS4"),
-                               motor_nh.param< std::string >("protocol_stack", "MAXON SERIAL V2"),
-                               motor_nh.param< std::string >("interface", "USB"),
-                               motor_nh.param< std::string >("port", ""));
+  DeviceInfo device_info;
+  if (motor_nh.hasParam("gateway")) {
+    // the node is on a sub device (e.g. CAN) behind a gateway device (e.g. EPOS on USB)
+    ros::NodeHandle gateway_nh(motor_nh, "gateway");
+    const DeviceInfo gateway_info(
+        gateway_nh.param< std::string >("device", "EPOS4"),
+        gateway_nh.param< std::string >("protocol_stack", "MAXON SERIAL V2"),
+        gateway_nh.param< std::string >("interface", "USB"),
+        gateway_nh.param< std::string >("port", ""));
+    device_info = DeviceInfo(gateway_info, motor_nh.param< std::string >("device", "EPOS4"),
+                             motor_nh.param< std::string >("protocol_stack", "CANopen"));
+  } else {
+    device_info = DeviceInfo(motor_nh.param< std::string >("device", "EPOS4"),
+                             motor_nh.param< std::string >("protocol_stack", "MAXON SERIAL V2"),
+                             motor_nh.param< std::string >("interface", "USB"),
+                             motor_nh.param< std::string >("port", ""));
+  }
   const unsigned short node_id(motor_nh.param("node_id", 0));
   const std::string serial_number_str(motor_nh.param< std::string >("serial_number", "0"));
 
@@ -115,34 +199,124 @@ void Epos::initEposNodeHandle(ros::NodeHandle &motor_nh) {
   epos_handle_ = createNodeHandle(device_info, node_id, serial_number);
 }
 
+void Epos::initCanopenMonitor(ros::NodeHandle &motor_nh) {
+  // emergencies & heartbeats are monitored only on SocketCAN
+  // because the EPOS Command Library can read CAN frames only by polling on the device
+  if (getInterfaceName(epos_handle_) != SOCKETCAN_INTERFACE_NAME ||
+      !motor_nh.param("canopen_monitor", true)) {
+    return;
+  }
+  canopen_monitor_ = getCanopenMonitor(getPortName(epos_handle_));
+  // ignore emergencies before initialization
+  CanopenEmcy emcy;
+  num_emcys_ = canopen_monitor_->getLatestEmcy(epos_handle_.node_id, emcy);
+}
+
+void Epos::initEmcyCallback() {
+  // after fault recovery is initialized, which the callback accesses
+  if (canopen_monitor_) {
+    canopen_monitor_->setEmcyCallback(epos_handle_.node_id,
+                                      boost::bind(&Epos::handleEmcy, this, _1));
+  }
+}
+
+void Epos::initHeartbeat(ros::NodeHandle &motor_nh) {
+  // let the node produce heartbeats if the interval is given
+  int producer_time;
+  if (!motor_nh.getParam("heartbeat/producer_time", producer_time)) {
+    return;
+  }
+  writeObject< objects::ProducerHeartbeatTime >(epos_handle_, producer_time);
+  if (producer_time == 0) {
+    return;
+  }
+
+  // consume heartbeats on the host
+  if (!canopen_monitor_) {
+    ROS_WARN_STREAM("Heartbeats of " << motor_name_
+                                     << " are not monitored because they are available only on "
+                                        "SocketCAN with canopen_monitor enabled");
+    return;
+  }
+  heartbeat_timeout_ =
+      ros::WallDuration(motor_nh.param("heartbeat/timeout", 2 * producer_time) / 1000.);
+  // the first heartbeat is expected within the timeout from now
+  heartbeat_stamp_ = ros::WallTime::now();
+}
+
 void Epos::initProtocolStackSettings(ros::NodeHandle &motor_nh) {
-  // load optional settings
-  const unsigned int baudrate(motor_nh.param("baudrate", 0));
+  // load optional settings. baudrate may be 'auto' instead of a number.
+  std::string baudrate_str;
+  const bool auto_baudrate(motor_nh.getParam("baudrate", baudrate_str));
+  if (auto_baudrate && baudrate_str != "auto") {
+    throw EposException("Invalid baudrate (" + baudrate_str + ")");
+  }
+  const unsigned int baudrate(auto_baudrate ? 0 : motor_nh.param("baudrate", 0));
   const unsigned int timeout(motor_nh.param("timeout", 0));
-  if (baudrate == 0 && timeout == 0) {
+  const unsigned int gateway_baudrate(motor_nh.param("gateway/baudrate", 0));
+  const int pipeline_depth(motor_nh.param("pipeline_depth", 0));
+  if (!auto_baudrate && baudrate == 0 && timeout == 0 && gateway_baudrate == 0 &&
+      pipeline_depth <= 0) {
     return;
   }
 
   // check if the node is the first one initialized in the device
-  if (epos_handle_.ptr.use_count() != 1) {
+  if (epos_handle_.transport.use_count() != 1) {
     ROS_WARN_STREAM(
         motor_nh.getNamespace()
-        << "/{baudrate,timeout} is ignored. "
+        << "/{baudrate,timeout,gateway/baudrate,pipeline_depth} is ignored. "
         << "Only the first-initialized node in a device can set protocol stack settings.");
     return;
   }
 
+  // apply bitrate of the bus behind the gateway
+  if (gateway_baudrate > 0) {
+    epos_handle_.transport->setGatewaySettings(gateway_baudrate);
+  }
+
+  // number of requests in flight on the serial protocol
+  if (pipeline_depth > 0) {
+    const boost::shared_ptr< SerialTransport > serial_transport(
+        boost::dynamic_pointer_cast< SerialTransport >(epos_handle_.transport));
+    if (!serial_transport) {
+      throw EposException("pipeline_depth is available only on " +
+                          std::string(MAXON_SERIAL_INTERFACE_NAME));
+    }
+    serial_transport->setPipelineDepth(pipeline_depth);
+  }
+
   // apply settings
-  if (baudrate > 0 && timeout > 0) {
-    VCS(SetProtocolStackSettings, epos_handle_.ptr.get(), baudrate, timeout);
+  if (auto_baudrate) {
+    // all nodes on the device must follow the new baudrate
+    std::vector< unsigned short > node_ids;
+    if (!epos_handle_.transport->discoverNodes(MAX_NODE_ID, node_ids) || node_ids.empty()) {
+      node_ids.assign(1, epos_handle_.node_id);
+    }
+    const unsigned int applied_baudrate(applyHighestBaudrate(epos_handle_, node_ids, timeout));
+    ROS_INFO_STREAM(motor_name_ << " communicates at baudrate " << applied_baudrate);
+  } else if (baudrate == 0 && timeout == 0) {
+    return;
+  } else if (baudrate > 0 && timeout > 0) {
+    epos_handle_.transport->setProtocolStackSettings(baudrate, timeout);
   } else {
     unsigned int current_baudrate, current_timeout;
-    VCS(GetProtocolStackSettings, epos_handle_.ptr.get(), &current_baudrate, &current_timeout);
-    VCS(SetProtocolStackSettings, epos_handle_.ptr.get(),
-        baudrate > 0 ? baudrate : current_baudrate, timeout > 0 ? timeout : current_timeout);
+    epos_handle_.transport->getProtocolStackSettings(current_baudrate, current_timeout);
+    epos_handle_.transport->setProtocolStackSettings(baudrate > 0 ? baudrate : current_baudrate,
+                                                     timeout > 0 ? timeout : current_timeout);
   }
 }
 
+void Epos::initPdo(ros::NodeHandle &motor_nh) {
+  // PDOs are optional
+  if (!motor_nh.hasParam("pdo")) {
+    return;
+  }
+
+  // load PDO mapping which will be written to the node at the end of init()
+  pdo_.reset(new EposPdo());
+  pdo_->init(motor_nh, epos_handle_);
+}
+
 void Epos::initOperationMode(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                              ros::NodeHandle &motor_nh) {
   // load map from ros-controller name to epos's operation mode name
@@ -169,7 +343,7 @@ void Epos::initOperationMode(hardware_interface::RobotHW &hw, ros::NodeHandle &r
     } else {
       throw EposException("Unsupported operation mode (" + str_pair.second + ")");
     }
-    mode->init(hw, root_nh, motor_nh, motor_name_, epos_handle_);
+    mode->init(hw, root_nh, motor_nh, motor_name_, epos_handle_, pdo_);
     ptr_map[str_pair.second] = mode;
   }
 
@@ -197,17 +371,13 @@ void Epos::initFaultReaction(ros::NodeHandle &motor_nh) {
 
   // set fault reaction
   if (fault_reaction_str == "signal_only") {
-    boost::int16_t data(-1);
-    VCS_OBJ(SetObject, epos_handle_, 0x605E, 0x00, &data, 2);
+    writeObject< objects::FaultReactionOption >(epos_handle_, -1);
   } else if (fault_reaction_str == "disable_drive") {
-    boost::int16_t data(0);
-    VCS_OBJ(SetObject, epos_handle_, 0x605E, 0x00, &data, 2);
+    writeObject< objects::FaultReactionOption >(epos_handle_, 0);
   } else if (fault_reaction_str == "slow_down_ramp") {
-    boost::int16_t data(1);
-    VCS_OBJ(SetObject, epos_handle_, 0x605E, 0x00, &data, 2);
+    writeObject< objects::FaultReactionOption >(epos_handle_, 1);
   } else if (fault_reaction_str == "slow_down_quickstop") {
-    boost::int16_t data(2);
-    VCS_OBJ(SetObject, epos_handle_, 0x605E, 0x00, &data, 2);
+    writeObject< objects::FaultReactionOption >(epos_handle_, 2);
   } else {
     throw EposException("Invalid fault reaction option (" + fault_reaction_str + ")");
   }
@@ -218,17 +388,18 @@ void Epos::initMotorParameter(ros::NodeHandle &motor_nh) {
   // set motor type
   int type;
   GET_PARAM_V(motor_param_nh, type);
-  VCS_NN(SetMotorType, epos_handle_, type);
+  epos_handle_.transport->setMotorType(epos_handle_.node_id, type);
   // set motor parameters
   if (type == 1 /* DC MOTOR */) {
     double nominal_current, max_output_current, thermal_time_constant;
     GET_PARAM_V(motor_param_nh, nominal_current);
     GET_PARAM_V(motor_param_nh, max_output_current);
     GET_PARAM_V(motor_param_nh, thermal_time_constant);
-    VCS_NN(SetDcMotorParameter, epos_handle_,
-           static_cast< int >(1000 * nominal_current),      // A -> mA
-           static_cast< int >(1000 * max_output_current),   // A -> mA
-           static_cast< int >(10 * thermal_time_constant)); // s -> 100ms
+    epos_handle_.transport->setDcMotorParameter(
+        epos_handle_.node_id,
+        static_cast< int >(1000 * nominal_current),      // A -> mA
+        static_cast< int >(1000 * max_output_current),   // A -> mA
+        static_cast< int >(10 * thermal_time_constant)); // s -> 100ms
   } else if (type == 10 || type == 11 /*EC MOTOR*/) {
     double nominal_current, max_output_current, thermal_time_constant;
     int number_of_pole_pairs;
@@ -236,11 +407,12 @@ void Epos::initMotorParameter(ros::NodeHandle &motor_nh) {
     GET_PARAM_V(motor_param_nh, max_output_current);
     GET_PARAM_V(motor_param_nh, thermal_time_constant);
     GET_PARAM_V(motor_param_nh, number_of_pole_pairs);
-    VCS_NN(SetEcMotorParameter, epos_handle_,
-           static_cast< int >(1000 * nominal_current),     // A -> mA
-           static_cast< int >(1000 * max_output_current),  // A -> mA
-           static_cast< int >(10 * thermal_time_constant), // s -> 100ms
-           number_of_pole_pairs);
+    epos_handle_.transport->setEcMotorParameter(
+        epos_handle_.node_id,
+        static_cast< int >(1000 * nominal_current),     // A -> mA
+        static_cast< int >(1000 * max_output_current),  // A -> mA
+        static_cast< int >(10 * thermal_time_constant), // s -> 100ms
+        number_of_pole_pairs);
   } else {
     throw EposException("Invalid motor type (" + boost::lexical_cast< std::string >(type) + ")");
   }
@@ -249,11 +421,11 @@ void Epos::initMotorParameter(ros::NodeHandle &motor_nh) {
   if (motor_param_nh.getParam("max_speed", max_speed)) {
     const std::string device_name(getDeviceName(epos_handle_));
     if (device_name == "EPOS2") {
-      boost::uint32_t data(max_speed);
-      VCS_OBJ(SetObject, epos_handle_, 0x6410, 0x04, &data, 4);
+      writeObject< objects::MaxMotorSpeedEpos2 >(epos_handle_,
+                                                 static_cast< boost::uint32_t >(max_speed));
     } else if (device_name == "EPOS4") {
-      boost::uint32_t data(max_speed);
-      VCS_OBJ(SetObject, epos_handle_, 0x6080, 0x00, &data, 4);
+      writeObject< objects::MaxMotorSpeed >(epos_handle_,
+                                            static_cast< boost::uint32_t >(max_speed));
     } else {
       ROS_WARN_STREAM("Skip initializing max motor speed on " << motor_name_ << " because "
                                                               << device_name
@@ -267,14 +439,15 @@ void Epos::initSensorParameter(ros::NodeHandle &motor_nh) {
   // set sensor type
   int type;
   GET_PARAM_V(sensor_nh, type);
-  VCS_NN(SetSensorType, epos_handle_, type);
+  epos_handle_.transport->setSensorType(epos_handle_.node_id, type);
   // set sensor parameters (TODO: support hall sensors)
   encoder_resolution_ = 0;
   if (type == 1 || type == 2 /* INC ENCODER */) {
     bool inverted_polarity;
     GET_PARAM_KV(sensor_nh, "resolution", encoder_resolution_);
     GET_PARAM_V(sensor_nh, inverted_polarity);
-    VCS_NN(SetIncEncoderParameter, epos_handle_, encoder_resolution_, inverted_polarity);
+    epos_handle_.transport->setIncEncoderParameter(epos_handle_.node_id, encoder_resolution_,
+                                                   inverted_polarity);
     if (inverted_polarity) {
       encoder_resolution_ = -encoder_resolution_;
     }
@@ -285,8 +458,9 @@ void Epos::initSensorParameter(ros::NodeHandle &motor_nh) {
     GET_PARAM_V(sensor_nh, number_of_multiturn_bits);
     GET_PARAM_V(sensor_nh, number_of_singleturn_bits);
     GET_PARAM_V(sensor_nh, inverted_polarity);
-    VCS_NN(SetSsiAbsEncoderParameter, epos_handle_, data_rate, number_of_multiturn_bits,
-           number_of_singleturn_bits, inverted_polarity);
+    epos_handle_.transport->setSsiAbsEncoderParameter(epos_handle_.node_id, data_rate,
+                                                      number_of_multiturn_bits,
+                                                      number_of_singleturn_bits, inverted_polarity);
     if (inverted_polarity) {
       encoder_resolution_ = -(1 << number_of_singleturn_bits);
     } else {
@@ -302,15 +476,15 @@ void Epos::initSafetyParameter(ros::NodeHandle &motor_nh) {
 
   int max_following_error;
   GET_PARAM_V(safety_nh, max_following_error);
-  VCS_NN(SetMaxFollowingError, epos_handle_, max_following_error);
+  epos_handle_.transport->setMaxFollowingError(epos_handle_.node_id, max_following_error);
 
   int max_profile_velocity;
   GET_PARAM_V(safety_nh, max_profile_velocity);
-  VCS_NN(SetMaxProfileVelocity, epos_handle_, max_profile_velocity);
+  epos_handle_.transport->setMaxProfileVelocity(epos_handle_.node_id, max_profile_velocity);
 
   int max_acceleration;
   GET_PARAM_V(safety_nh, max_acceleration);
-  VCS_NN(SetMaxAcceleration, epos_handle_, max_acceleration);
+  epos_handle_.transport->setMaxAcceleration(epos_handle_.node_id, max_acceleration);
 }
 
 void Epos::initPositionRegulator(ros::NodeHandle &motor_nh) {
@@ -321,14 +495,15 @@ void Epos::initPositionRegulator(ros::NodeHandle &motor_nh) {
     GET_PARAM_V(gain_nh, p);
     GET_PARAM_V(gain_nh, i);
     GET_PARAM_V(gain_nh, d);
-    VCS_NN(SetPositionRegulatorGain, epos_handle_, p, i, d);
+    epos_handle_.transport->setPositionRegulatorGain(epos_handle_.node_id, p, i, d);
   }
   if (position_regulator_nh.hasParam("feed_forward")) {
     ros::NodeHandle feed_forward_nh(position_regulator_nh, "feed_forward");
     int velocity, acceleration;
     GET_PARAM_V(feed_forward_nh, velocity);
     GET_PARAM_V(feed_forward_nh, acceleration);
-    VCS_NN(SetPositionRegulatorFeedForward, epos_handle_, velocity, acceleration);
+    epos_handle_.transport->setPositionRegulatorFeedForward(epos_handle_.node_id, velocity,
+                                                            acceleration);
   }
 }
 
@@ -339,14 +514,15 @@ void Epos::initVelocityRegulator(ros::NodeHandle &motor_nh) {
     int p, i;
     GET_PARAM_V(gain_nh, p);
     GET_PARAM_V(gain_nh, i);
-    VCS_NN(SetVelocityRegulatorGain, epos_handle_, p, i);
+    epos_handle_.transport->setVelocityRegulatorGain(epos_handle_.node_id, p, i);
   }
   if (velocity_regulator_nh.hasParam("feed_forward")) {
     ros::NodeHandle feed_forward_nh(velocity_regulator_nh, "feed_forward");
     int velocity, acceleration;
     GET_PARAM_V(feed_forward_nh, velocity);
     GET_PARAM_V(feed_forward_nh, acceleration);
-    VCS_NN(SetVelocityRegulatorFeedForward, epos_handle_, velocity, acceleration);
+    epos_handle_.transport->setVelocityRegulatorFeedForward(epos_handle_.node_id, velocity,
+                                                            acceleration);
   }
 }
 
@@ -357,7 +533,7 @@ void Epos::initCurrentRegulator(ros::NodeHandle &motor_nh) {
     int p, i;
     GET_PARAM_V(gain_nh, p);
     GET_PARAM_V(gain_nh, i);
-    VCS_NN(SetCurrentRegulatorGain, epos_handle_, p, i);
+    epos_handle_.transport->setCurrentRegulatorGain(epos_handle_.node_id, p, i);
   }
 }
 
@@ -368,7 +544,8 @@ void Epos::initPositionProfile(ros::NodeHandle &motor_nh) {
     GET_PARAM_V(position_profile_nh, velocity);
     GET_PARAM_V(position_profile_nh, acceleration);
     GET_PARAM_V(position_profile_nh, deceleration);
-    VCS_NN(SetPositionProfile, epos_handle_, velocity, acceleration, deceleration);
+    epos_handle_.transport->setPositionProfile(epos_handle_.node_id, velocity, acceleration,
+                                               deceleration);
   }
   if (position_profile_nh.hasParam("window")) {
     ros::NodeHandle window_nh(position_profile_nh, "window");
@@ -376,8 +553,8 @@ void Epos::initPositionProfile(ros::NodeHandle &motor_nh) {
     double time;
     GET_PARAM_V(window_nh, window);
     GET_PARAM_V(window_nh, time);
-    VCS_NN(EnablePositionWindow, epos_handle_, window,
-           static_cast< int >(1000 * time) /* s -> ms */);
+    epos_handle_.transport->enablePositionWindow(epos_handle_.node_id, window,
+                                                 static_cast< int >(1000 * time) /* s -> ms */);
   }
 }
 
@@ -387,7 +564,7 @@ void Epos::initVelocityProfile(ros::NodeHandle &motor_nh) {
     int acceleration, deceleration;
     GET_PARAM_V(velocity_profile_nh, acceleration);
     GET_PARAM_V(velocity_profile_nh, deceleration);
-    VCS_NN(SetVelocityProfile, epos_handle_, acceleration, deceleration);
+    epos_handle_.transport->setVelocityProfile(epos_handle_.node_id, acceleration, deceleration);
   }
   if (velocity_profile_nh.hasParam("window")) {
     ros::NodeHandle window_nh(velocity_profile_nh, "window");
@@ -395,31 +572,214 @@ void Epos::initVelocityProfile(ros::NodeHandle &motor_nh) {
     double time;
     GET_PARAM_V(window_nh, window);
     GET_PARAM_V(window_nh, time);
-    VCS_NN(EnableVelocityWindow, epos_handle_, window,
-           static_cast< int >(1000 * time) /* s -> ms */);
+    epos_handle_.transport->enableVelocityWindow(epos_handle_.node_id, window,
+                                                 static_cast< int >(1000 * time) /* s -> ms */);
   }
 }
 
 void Epos::initDeviceError(ros::NodeHandle &motor_nh) {
-  unsigned char num_device_errors;
-  VCS_NN(GetNbOfDeviceError, epos_handle_, &num_device_errors);
+  unsigned char num_device_errors(epos_handle_.transport->getNbOfDeviceError(epos_handle_.node_id));
   for (int i = 1; i <= num_device_errors; ++i) {
-    unsigned int device_error_code;
-    VCS_NN(GetDeviceErrorCode, epos_handle_, i, &device_error_code);
+    const unsigned int device_error_code(
+        epos_handle_.transport->getDeviceErrorCode(epos_handle_.node_id, i));
     ROS_WARN_STREAM("EPOS Device Error: 0x" << std::hex << device_error_code);
   }
 
   if (motor_nh.param("clear_faults", false)) {
-    VCS_N0(ClearFault, epos_handle_);
+    epos_handle_.transport->clearFault(epos_handle_.node_id);
   }
 
-  VCS_NN(GetNbOfDeviceError, epos_handle_, &num_device_errors);
+  num_device_errors = epos_handle_.transport->getNbOfDeviceError(epos_handle_.node_id);
   if (num_device_errors > 0) {
     throw EposException(boost::lexical_cast< std::string >(num_device_errors) +
                         " faults uncleared on the device");
   }
 }
 
+void Epos::initCommunicationTimeout(ros::NodeHandle &motor_nh) {
+  // let the node stop by itself if heartbeats of the host stop (e.g. the host is dead).
+  // the manager produces the heartbeats in the control cycle.
+  int consumer_time;
+  if (motor_nh.getParam("communication_timeout/heartbeat_consumer_time", consumer_time) &&
+      consumer_time > 0) {
+    if (getProtocolStackName(epos_handle_) != "CANopen") {
+      throw EposException("Invalid communication timeout (" + motor_name_ +
+                          " is not on CANopen where heartbeats are available)");
+    }
+    host_node_id_ = motor_nh.param("communication_timeout/host_node_id", 127);
+    writeObject< objects::ConsumerHeartbeatTime >(epos_handle_,
+                                                  (host_node_id_ << 16) | (consumer_time & 0xFFFF));
+    host_heartbeat_consumer_time_ = ros::WallDuration(consumer_time / 1000.);
+  }
+
+  // reaction of the node on the timeout
+  std::string abort_connection_str;
+  if (!motor_nh.getParam("communication_timeout/abort_connection_option", abort_connection_str)) {
+    return;
+  }
+  if (abort_connection_str == "none") {
+    writeObject< objects::AbortConnectionOptionCode >(epos_handle_, 0);
+  } else if (abort_connection_str == "fault") {
+    writeObject< objects::AbortConnectionOptionCode >(epos_handle_, 1);
+  } else if (abort_connection_str == "disable_voltage") {
+    writeObject< objects::AbortConnectionOptionCode >(epos_handle_, 2);
+  } else if (abort_connection_str == "quick_stop") {
+    writeObject< objects::AbortConnectionOptionCode >(epos_handle_, 3);
+  } else {
+    throw EposException("Invalid abort connection option (" + abort_connection_str + ")");
+  }
+}
+
+void Epos::initPositionMarker(ros::NodeHandle &motor_nh) {
+  if (!position_marker_data_) {
+    return;
+  }
+
+  // arm the marker on the digital input
+  int digital_input;
+  GET_PARAM_KV(motor_nh, "position_marker/digital_input", digital_input);
+
+  const std::string edge_type_str(
+      motor_nh.param< std::string >("position_marker/edge_type", "rising"));
+  unsigned char edge_type;
+  if (edge_type_str == "both") {
+    edge_type = 0;
+  } else if (edge_type_str == "rising") {
+    edge_type = 1;
+  } else if (edge_type_str == "falling") {
+    edge_type = 2;
+  } else {
+    throw EposException("Invalid position marker edge type (" + edge_type_str + ")");
+  }
+
+  const std::string mode_str(motor_nh.param< std::string >("position_marker/mode", "continuous"));
+  unsigned char mode;
+  if (mode_str == "continuous") {
+    mode = 0;
+  } else if (mode_str == "single") {
+    mode = 1;
+  } else if (mode_str == "multiple") {
+    mode = 2;
+  } else {
+    throw EposException("Invalid position marker mode (" + mode_str + ")");
+  }
+
+  const std::string polarity_str(
+      motor_nh.param< std::string >("position_marker/polarity", "high_active"));
+  int polarity;
+  if (polarity_str == "high_active") {
+    polarity = 0;
+  } else if (polarity_str == "low_active") {
+    polarity = 1;
+  } else {
+    throw EposException("Invalid position marker polarity (" + polarity_str + ")");
+  }
+
+  epos_handle_.transport->setPositionMarkerParameter(epos_handle_.node_id, edge_type, mode);
+  epos_handle_.transport->activatePositionMarker(epos_handle_.node_id, digital_input, polarity);
+  // captures before arming (or before reconnection) are not new
+  position_marker_counter_ =
+      epos_handle_.transport->readPositionMarkerCounter(epos_handle_.node_id);
+}
+
+void Epos::initPositionCompare(ros::NodeHandle &motor_nh) {
+  if (!position_compare_command_) {
+    return;
+  }
+
+  // load configuration of pulses on the digital output
+  int digital_output;
+  GET_PARAM_KV(motor_nh, "position_compare/digital_output", digital_output);
+
+  const std::string operational_mode_str(
+      motor_nh.param< std::string >("position_compare/operational_mode", "single_position"));
+  unsigned char operational_mode;
+  if (operational_mode_str == "single_position") {
+    operational_mode = 0;
+  } else if (operational_mode_str == "position_sequence") {
+    operational_mode = 1;
+  } else {
+    throw EposException("Invalid position compare operational mode (" + operational_mode_str +
+                        ")");
+  }
+
+  const std::string interval_mode_str(
+      motor_nh.param< std::string >("position_compare/interval_mode", "both"));
+  unsigned char interval_mode;
+  if (interval_mode_str == "negative") {
+    interval_mode = 0;
+  } else if (interval_mode_str == "positive") {
+    interval_mode = 1;
+  } else if (interval_mode_str == "both") {
+    interval_mode = 2;
+  } else {
+    throw EposException("Invalid position compare interval mode (" + interval_mode_str + ")");
+  }
+
+  const std::string direction_str(
+      motor_nh.param< std::string >("position_compare/direction_dependency", "both"));
+  unsigned char direction_dependency;
+  if (direction_str == "negative") {
+    direction_dependency = 0;
+  } else if (direction_str == "positive") {
+    direction_dependency = 1;
+  } else if (direction_str == "both") {
+    direction_dependency = 2;
+  } else {
+    throw EposException("Invalid position compare direction dependency (" + direction_str + ")");
+  }
+
+  const std::string polarity_str(
+      motor_nh.param< std::string >("position_compare/polarity", "high_active"));
+  int polarity;
+  if (polarity_str == "high_active") {
+    polarity = 0;
+  } else if (polarity_str == "low_active") {
+    polarity = 1;
+  } else {
+    throw EposException("Invalid position compare polarity (" + polarity_str + ")");
+  }
+
+  const unsigned short interval_width(motor_nh.param("position_compare/interval_width", 0));
+  const unsigned short interval_repetitions(
+      motor_nh.param("position_compare/interval_repetitions", 0));
+  const unsigned short pulse_width(motor_nh.param("position_compare/pulse_width", 1000));
+
+  // the parameters are accepted only while disabled
+  const unsigned short node_id(epos_handle_.node_id);
+  epos_handle_.transport->disablePositionCompare(node_id);
+  epos_handle_.transport->setPositionCompareParameter(node_id, operational_mode, interval_mode,
+                                                      direction_dependency, interval_width,
+                                                      interval_repetitions, pulse_width);
+  epos_handle_.transport->activatePositionCompare(node_id, digital_output, polarity);
+  // write the reference position and enable again in the next write()
+  is_position_compare_stale_ = true;
+}
+
+void Epos::initFaultRecovery(ros::NodeHandle &motor_nh) {
+  if (motor_nh.param("fault_recovery/enabled", false)) {
+    fault_recovery_.reset(new EposFaultRecovery(motor_nh, motor_name_, epos_handle_));
+  }
+}
+
+void Epos::initReconnection(ros::NodeHandle &motor_nh) {
+  // 0 means the node is never regarded as lost
+  motor_nh.param("reconnection/max_failures", max_read_failures_, 0);
+}
+
+void Epos::initPositionCompareServer(ros::NodeHandle &motor_nh) {
+  if (position_compare_command_) {
+    position_compare_server_ = motor_nh.advertiseService(
+        "reload_position_compare", &Epos::reloadPositionCompareCallback, this);
+  }
+}
+
+void Epos::initCircuitBreaker(ros::NodeHandle &motor_nh) {
+  // 0 means the node is never quarantined
+  motor_nh.param("circuit_breaker/max_timeouts", max_timeouts_, 0);
+  probe_interval_ = ros::WallDuration(motor_nh.param("circuit_breaker/probe_interval", 1.));
+}
+
 void Epos::initMiscParameters(ros::NodeHandle &motor_nh) {
   // constant whose unit is mNm/A
   GET_PARAM_KV(motor_nh, "motor/torque_constant", torque_constant_);
@@ -427,6 +787,9 @@ void Epos::initMiscParameters(ros::NodeHandle &motor_nh) {
   // unit of outgoing states
   motor_nh.param("rw_ros_units", rw_ros_units_, false);
 
+  // drive the state machine by controlword instead of high-level functions
+  motor_nh.param("fast_state_machine", fast_state_machine_, false);
+
   // constants in battery state
   if (power_supply_state_) {
     power_supply_state_->power_supply_technology = motor_nh.param< int >(
@@ -443,48 +806,270 @@ void Epos::initMiscParameters(ros::NodeHandle &motor_nh) {
 
 void Epos::doSwitch(const std::list< hardware_interface::ControllerInfo > &start_list,
                     const std::list< hardware_interface::ControllerInfo > &stop_list) {
-  // switch epos's operation mode according to starting controllers
+  // switch epos's operation mode according to starting controllers.
+  // the mode is activated in the next write() on the I/O path of the port so that
+  // the controller manager is never blocked by the device, and all ports switch in parallel.
   BOOST_FOREACH (const hardware_interface::ControllerInfo &starting_controller, start_list) {
     const OperationModeMap::const_iterator mode_to_switch(
         operation_mode_map_.find(starting_controller.name));
     if (mode_to_switch == operation_mode_map_.end()) {
       continue;
     }
-    try {
-      mode_to_switch->second->activate();
-      operation_mode_ = mode_to_switch->second;
-      ROS_INFO_STREAM(motor_name_ << " switched to operation mode associated with "
-                                  << mode_to_switch->first);
-    } catch (const EposException &error) {
-      ROS_ERROR_STREAM(error.what());
-    }
+    // reset states before the commands of the starting controller are saturated
+    mode_to_switch->second->prepare();
+    pending_operation_mode_ = mode_to_switch->second;
+    pending_controller_name_ = mode_to_switch->first;
+    switch_request_stamp_ = ros::WallTime::now();
+  }
+}
+
+//
+// accessors
+//
+
+bool Epos::isSynchronous() const { return pdo_ && pdo_->isSynchronous(); }
+
+const eposx_hardware::NodeHandle &Epos::getNodeHandle() const { return epos_handle_; }
+
+const std::string &Epos::getMotorName() const { return motor_name_; }
+
+void Epos::disableFaultRecovery() {
+  if (fault_recovery_) {
+    fault_recovery_->disable();
+  }
+}
+
+void Epos::stopPdo() {
+  const DeviceLock lock(epos_handle_);
+  if (pdo_) {
+    pdo_->stop();
+  }
+}
+
+//
+// reconnection
+//
+
+bool Epos::isLost() const {
+  return max_read_failures_ > 0 && num_read_failures_ >= max_read_failures_;
+}
+
+bool Epos::isReconnecting() const {
+  boost::lock_guard< boost::mutex > lock(reconnection_mutex_);
+  return is_reconnecting_;
+}
+
+void Epos::setReconnecting(const bool is_reconnecting) {
+  boost::lock_guard< boost::mutex > lock(reconnection_mutex_);
+  is_reconnecting_ = is_reconnecting;
+}
+
+void Epos::reconnect() {
+  const DeviceLock lock(epos_handle_);
+
+  // the node may have been replaced while it was lost
+  const boost::uint64_t serial_number(getSerialNumber(epos_handle_));
+  epos_handle_.cache->invalidate();
+  if (getSerialNumber(epos_handle_) != serial_number) {
+    throw EposException("Reconnect (" + motor_name_ + " has been replaced by another node)");
+  }
+
+  // the node may have been power-cycled and lost its configuration
+  configure();
+  if (operation_mode_) {
+    operation_mode_->prepare();
+    operation_mode_->activate();
+  }
+  if (fault_recovery_) {
+    fault_recovery_->reset();
+  }
+  num_read_failures_ = 0;
+  num_timeouts_ = 0;
+  setQuarantined(false);
+  // forget the probe in flight without waiting because it waits for the device lock held here.
+  // it owns its result buffer and never accesses this.
+  probe_ = boost::shared_future< void >();
+}
+
+//
+// deadline watchdog
+//
+
+ros::WallTime Epos::getLastWriteStamp() const {
+  boost::lock_guard< boost::mutex > lock(write_stamp_mutex_);
+  return write_stamp_;
+}
+
+void Epos::halt() {
+  // the device lock also keeps write() from switching the mode
+  const DeviceLock lock(epos_handle_);
+  if (operation_mode_) {
+    operation_mode_->halt();
+  } else {
+    writeObject< objects::Controlword >(epos_handle_, CW_ENABLE_OPERATION | CW_HALT);
   }
 }
 
+bool Epos::getHostHeartbeat(unsigned short &host_node_id,
+                            ros::WallDuration &consumer_time) const {
+  if (host_heartbeat_consumer_time_.isZero()) {
+    return false;
+  }
+  host_node_id = host_node_id_;
+  consumer_time = host_heartbeat_consumer_time_;
+  return true;
+}
+
 //
 // read() and subfunctions
 //
 
 void Epos::read() {
+  // the node is being configured by the reconnector
+  if (isReconnecting()) {
+    if (diagnostic_data_) {
+      diagnostic_data_->is_reconnecting = true;
+    }
+    return;
+  }
+  if (diagnostic_data_) {
+    diagnostic_data_->is_reconnecting = false;
+    diagnostic_data_->is_quarantined = isQuarantined();
+  }
+  // every access to an unresponsive node would block the port for the protocol timeout
+  if (isQuarantined()) {
+    readQuarantine();
+    return;
+  }
+
   try {
+    const DeviceLock lock(epos_handle_);
+    // monitored states first because they are available even if the node is lost
+    readEmcy();
+    readHeartbeat();
+    if (pdo_) {
+      pdo_->receive();
+    }
     if (operation_mode_) {
       operation_mode_->read();
     }
     readJointState();
+    readFaultRecovery();
     readPowerSupply();
+    readPositionMarker();
     readDiagnostic();
+    num_read_failures_ = 0;
+    num_timeouts_ = 0;
   } catch (const EposException &error) {
     ROS_ERROR_STREAM(error.what());
+    ++num_read_failures_;
+    countTimeout(error);
   }
 }
 
+void Epos::countTimeout(const EposException &error) {
+  if (max_timeouts_ <= 0) {
+    return;
+  }
+  num_timeouts_ = error.isTimeout() ? num_timeouts_ + 1 : 0;
+  if (num_timeouts_ >= max_timeouts_) {
+    ROS_ERROR_STREAM("Quarantined " << motor_name_ << " after " << num_timeouts_
+                                    << " timeouts in a row");
+    setQuarantined(true);
+    probe_stamp_ = ros::WallTime::now();
+  }
+}
+
+// read the statusword into the buffer shared with the task (run on the executor)
+static void probeStatusword(const NodeHandle &node_handle,
+                            const boost::shared_ptr< boost::uint16_t > &statusword) {
+  const DeviceLock lock(node_handle);
+  *statusword = readObject< objects::Statusword >(node_handle);
+}
+
+void Epos::readQuarantine() {
+  // wait for the probe in flight without blocking the cycle
+  if (probe_.valid()) {
+    if (!probe_.is_ready()) {
+      return;
+    }
+    const boost::shared_future< void > probe(probe_);
+    probe_ = boost::shared_future< void >();
+    try {
+      probe.get();
+      ROS_INFO_STREAM(motor_name_ << " responds again");
+      setQuarantined(false);
+      num_timeouts_ = 0;
+      num_read_failures_ = 0;
+      // errors may have been recorded while unresponsive
+      markDeviceErrorsStale();
+      return;
+    } catch (const EposException &) {
+      // a failed probe counts as a failed read so that a lost device is reconnected
+      ++num_read_failures_;
+    }
+  }
+
+  // probe at a low rate because an unanswered probe also blocks the port
+  const ros::WallTime now(ros::WallTime::now());
+  if (now - probe_stamp_ < probe_interval_) {
+    return;
+  }
+  probe_stamp_ = now;
+  probe_ = getDeviceExecutor(epos_handle_)
+               ->post< void >(boost::bind(&probeStatusword, epos_handle_,
+                                          boost::make_shared< boost::uint16_t >(0)));
+}
+
+bool Epos::isQuarantined() const {
+  boost::lock_guard< boost::mutex > lock(quarantine_mutex_);
+  return is_quarantined_;
+}
+
+void Epos::setQuarantined(const bool is_quarantined) {
+  boost::lock_guard< boost::mutex > lock(quarantine_mutex_);
+  is_quarantined_ = is_quarantined;
+}
+
 void Epos::readJointState() {
-  int position_raw;
-  int velocity_raw;
-  short current_raw;
-  VCS_NN(GetPositionIs, epos_handle_, &position_raw);
-  VCS_NN(GetVelocityIs, epos_handle_, &velocity_raw);
-  VCS_NN(GetCurrentIs, epos_handle_, &current_raw);
+  // use values in PDOs if mapped, or read them from the node in a batch
+  namespace od = objects;
+  const unsigned short node_id(epos_handle_.node_id);
+  std::vector< ObjectRequest > requests;
+  od::PositionActualValue::Type position_raw;
+  if (!pdo_ || !pdo_->getTxObject< od::PositionActualValue >(position_raw)) {
+    requests.push_back(makeReadRequest< od::PositionActualValue >(node_id, position_raw));
+  }
+  od::VelocityActualValue::Type velocity_raw;
+  if (!pdo_ || !pdo_->getTxObject< od::VelocityActualValue >(velocity_raw)) {
+    requests.push_back(makeReadRequest< od::VelocityActualValue >(node_id, velocity_raw));
+  }
+  od::CurrentActualValueEpos4::Type current_raw;
+  od::CurrentActualValue::Type current_raw16;
+  bool has_current16(false);
+  if (pdo_ && pdo_->getTxObject< od::CurrentActualValueEpos4 >(current_raw)) {
+    // EPOS4's current actual value
+  } else if (pdo_ && pdo_->getTxObject< od::CurrentActualValue >(current_raw16)) {
+    has_current16 = true;
+  } else if (od::CurrentActualValueEpos4::isAvailableOn(getDeviceName(epos_handle_))) {
+    // EPOS4 has the current actual value in INT32
+    requests.push_back(makeReadRequest< od::CurrentActualValueEpos4 >(node_id, current_raw));
+  } else {
+    requests.push_back(makeReadRequest< od::CurrentActualValue >(node_id, current_raw16));
+    has_current16 = true;
+  }
+  // the statusword in the same batch tells faults without an extra transaction
+  if ((fault_recovery_ || diagnostic_data_) &&
+      (!pdo_ || !pdo_->getTxObject< od::Statusword >(statusword_))) {
+    requests.push_back(makeReadRequest< od::Statusword >(node_id, statusword_));
+  }
+  if (!requests.empty()) {
+    epos_handle_.transport->submitObjects(requests);
+    throwIfFailed(requests);
+  }
+  if (has_current16) {
+    current_raw = current_raw16;
+  }
   if (rw_ros_units_) {
     // quad-counts of the encoder -> rad
     position_ = position_raw * M_PI / (2. * encoder_resolution_);
@@ -508,9 +1093,8 @@ void Epos::readPowerSupply() {
   }
 
   const std::string device_name(getDeviceName(epos_handle_));
-  if (device_name == "EPOS4") {
-    boost::uint16_t voltage10x;
-    VCS_OBJ(GetObject, epos_handle_, 0x2200, 0x01, &voltage10x, 2);
+  if (objects::PowerSupplyVoltage::isAvailableOn(device_name)) {
+    const boost::uint16_t voltage10x(readObject< objects::PowerSupplyVoltage >(epos_handle_));
     // measured variables
     power_supply_state_->voltage = voltage10x / 10.;
     power_supply_state_->present = true;
@@ -518,11 +1102,13 @@ void Epos::readPowerSupply() {
     ROS_WARN_STREAM_ONCE("Power supply voltage of " << motor_name_ << " cannot be measured because "
                                                     << device_name
                                                     << " does not offer voltage information");
-    // read something from the node to make sure power supply is present
-    boost::uint16_t statusword;
-    VCS_OBJ(GetObject, epos_handle_, 0x6041, 0x00, &statusword, 2);
+    // make sure power supply is present by heartbeats (see readHeartbeat()),
+    // or by reading something from the node
+    if (heartbeat_timeout_.isZero()) {
+      readObject< objects::Statusword >(epos_handle_);
+      power_supply_state_->present = true;
+    }
     power_supply_state_->voltage = std::numeric_limits< float >::quiet_NaN();
-    power_supply_state_->present = true;
   }
   // unmeasured variables
   power_supply_state_->current = std::numeric_limits< float >::quiet_NaN();
@@ -534,23 +1120,171 @@ void Epos::readPowerSupply() {
   power_supply_state_->power_supply_health = sensor_msgs::BatteryState::POWER_SUPPLY_HEALTH_UNKNOWN;
 }
 
+void Epos::readPositionMarker() {
+  if (!position_marker_data_) {
+    return;
+  }
+
+  // read the captured position only when the node tells a new capture by the counter,
+  // which costs no transaction if it is mapped to a transmit PDO
+  objects::PositionMarkerCounter::Type counter;
+  if (!pdo_ || !pdo_->getTxObject< objects::PositionMarkerCounter >(counter)) {
+    counter = epos_handle_.transport->readPositionMarkerCounter(epos_handle_.node_id);
+  }
+  if (counter != position_marker_counter_) {
+    const int position_raw(
+        epos_handle_.transport->readPositionMarkerCapturedPosition(epos_handle_.node_id, 0));
+    // same unit as the actual position
+    position_marker_data_->position =
+        rw_ros_units_ ? position_raw * M_PI / (2. * encoder_resolution_) : position_raw;
+    // the counter of the node wraps around
+    position_marker_data_->count += static_cast< boost::uint16_t >(counter -
+                                                                   position_marker_counter_);
+    position_marker_data_->stamp = ros::Time::now();
+    position_marker_counter_ = counter;
+  }
+
+  if (diagnostic_data_) {
+    diagnostic_data_->has_position_marker = true;
+    diagnostic_data_->position_marker_count = position_marker_data_->count;
+    diagnostic_data_->position_marker_position = position_marker_data_->position;
+  }
+}
+
 void Epos::readDiagnostic() {
   if (!diagnostic_data_) {
     return;
   }
 
-  // read actual operation mode (this is common in all types of devices)
-  VCS_OBJ(GetObject, epos_handle_, 0x6061, 0x00, &diagnostic_data_->operation_mode_display, 1);
+  // read actual operation mode (common in all types of devices)
+  namespace od = objects;
+  std::vector< ObjectRequest > requests;
+  if (!pdo_ || !pdo_->getTxObject< od::ModesOfOperationDisplay >(
+                   diagnostic_data_->operation_mode_display)) {
+    requests.push_back(makeReadRequest< od::ModesOfOperationDisplay >(
+        epos_handle_.node_id, diagnostic_data_->operation_mode_display));
+  }
+  // the statusword has been read with the joint state
+  diagnostic_data_->statusword = statusword_;
+  if (!requests.empty()) {
+    epos_handle_.transport->submitObjects(requests);
+    throwIfFailed(requests);
+  }
+
+  // read fault info only when the fault or warning state changes
+  // because it takes a transaction per error
+  const boost::uint16_t device_error_bits(diagnostic_data_->statusword &
+                                          (SW_FAULT_BIT | SW_WARNING_BIT));
+  if (takeDeviceErrorsStale() || device_error_bits != device_error_bits_) {
+    try {
+      readDeviceErrors();
+    } catch (const EposException &) {
+      // read again in the next cycle
+      markDeviceErrorsStale();
+      throw;
+    }
+    device_error_bits_ = device_error_bits;
+  }
+}
+
+void Epos::readEmcy() {
+  if (!canopen_monitor_) {
+    return;
+  }
+
+  // faults have been handled by handleEmcy() on the monitor thread. update diagnostic only.
+  CanopenEmcy emcy;
+  const unsigned int num_emcys(canopen_monitor_->getLatestEmcy(epos_handle_.node_id, emcy));
+  if (num_emcys == num_emcys_) {
+    return;
+  }
+  num_emcys_ = num_emcys;
+  if (diagnostic_data_) {
+    diagnostic_data_->num_emcys = num_emcys;
+    diagnostic_data_->emcy_error_code = emcy.error_code;
+    diagnostic_data_->emcy_error_register = emcy.error_register;
+  }
+}
+
+void Epos::handleEmcy(const CanopenEmcy &emcy) {
+  // new emergencies mean the fault info has changed
+  markDeviceErrorsStale();
+  // start recovery without waiting for the next read()
+  if (fault_recovery_ && emcy.error_code != 0) {
+    fault_recovery_->notifyFault();
+  }
+}
+
+void Epos::markDeviceErrorsStale() {
+  boost::lock_guard< boost::mutex > lock(device_errors_mutex_);
+  are_device_errors_stale_ = true;
+}
+
+bool Epos::takeDeviceErrorsStale() {
+  boost::lock_guard< boost::mutex > lock(device_errors_mutex_);
+  const bool are_stale(are_device_errors_stale_);
+  are_device_errors_stale_ = false;
+  return are_stale;
+}
+
+void Epos::readHeartbeat() {
+  if (heartbeat_timeout_.isZero()) {
+    return;
+  }
+
+  unsigned char nmt_state;
+  ros::WallTime stamp;
+  if (canopen_monitor_->getLatestHeartbeat(epos_handle_.node_id, nmt_state, stamp) &&
+      stamp > heartbeat_stamp_) {
+    if (nmt_state == CANOPEN_NMT_BOOT_UP) {
+      ROS_WARN_STREAM(motor_name_ << " has booted up");
+    }
+    heartbeat_stamp_ = stamp;
+    nmt_state_ = nmt_state;
+  }
 
-  // read statusword (this is common in all types of devices)
-  VCS_OBJ(GetObject, epos_handle_, 0x6041, 0x00, &diagnostic_data_->statusword, 2);
+  const bool is_alive(ros::WallTime::now() - heartbeat_stamp_ <= heartbeat_timeout_);
+  if (is_alive && !is_alive_) {
+    ROS_INFO_STREAM("Heartbeats of " << motor_name_ << " have resumed");
+  } else if (!is_alive && is_alive_) {
+    ROS_ERROR_STREAM("Heartbeats of " << motor_name_ << " have timed out");
+  }
+  is_alive_ = is_alive;
 
-  // read fault info
-  unsigned char num_device_errors;
-  VCS_NN(GetNbOfDeviceError, epos_handle_, &num_device_errors);
+  if (power_supply_state_) {
+    power_supply_state_->present = is_alive_;
+  }
+  if (diagnostic_data_) {
+    diagnostic_data_->is_heartbeat_monitored = true;
+    diagnostic_data_->is_alive = is_alive_;
+    diagnostic_data_->nmt_state = nmt_state_;
+  }
+}
+
+void Epos::readFaultRecovery() {
+  if (!fault_recovery_) {
+    return;
+  }
+
+  // start recovery if the statusword read in this cycle tells a fault
+  // (the recovery itself reads the statusword again)
+  if (statusword_ & SW_FAULT_BIT) {
+    fault_recovery_->notifyFault();
+  }
+
+  if (diagnostic_data_) {
+    diagnostic_data_->fault_recovery_state = toString(fault_recovery_->getState());
+    diagnostic_data_->num_fault_recoveries = fault_recovery_->getNumRecoveries();
+  }
+}
+
+void Epos::readDeviceErrors() {
+  const unsigned char num_device_errors(
+      epos_handle_.transport->getNbOfDeviceError(epos_handle_.node_id));
   diagnostic_data_->device_errors.resize(num_device_errors, 0);
   for (unsigned char i = 1; i <= num_device_errors; ++i) {
-    VCS_NN(GetDeviceErrorCode, epos_handle_, i, &diagnostic_data_->device_errors[i]);
+    diagnostic_data_->device_errors[i - 1] =
+        epos_handle_.transport->getDeviceErrorCode(epos_handle_.node_id, i);
   }
 }
 
@@ -559,13 +1293,140 @@ void Epos::readDiagnostic() {
 //
 
 void Epos::write() {
+  // commands would disturb recovery. a faulted node executes no target,
+  // so the skipped write is exempt from the deadline watchdog.
+  if (fault_recovery_ && fault_recovery_->isRecovering()) {
+    updateWriteStamp();
+    return;
+  }
+  // commands would disturb reconnection, or block the port if unresponsive.
+  // the node may keep executing the last target, so the watchdog regards the write as late.
+  if (isReconnecting() || isQuarantined()) {
+    return;
+  }
+
   try {
+    const DeviceLock lock(epos_handle_);
+    // the operation mode is restored in this thread because it is shared with controllers
+    const bool is_recovered(fault_recovery_ && fault_recovery_->takeRecovered());
+    if (pending_operation_mode_) {
+      switchOperationMode();
+    } else if (is_recovered && operation_mode_) {
+      operation_mode_->prepare();
+      operation_mode_->activate();
+    }
     if (operation_mode_) {
       operation_mode_->write();
     }
+    writePositionCompare();
+    if (pdo_) {
+      pdo_->transmit();
+    }
+    updateWriteStamp();
   } catch (const EposException &error) {
     ROS_ERROR_STREAM(error.what());
+    // commands are rejected by a faulted node
+    if (fault_recovery_) {
+      fault_recovery_->notifyFault();
+    }
   }
 }
 
+void Epos::writePositionCompare() {
+  if (!position_compare_command_) {
+    return;
+  }
+
+  // write changes only because the node fires pulses by itself
+  const EposPositionCompareCommand command(*position_compare_command_);
+  const unsigned short node_id(epos_handle_.node_id);
+  if (is_position_compare_stale_ ||
+      command.reference_position != written_position_compare_.reference_position) {
+    const int reference_position(
+        rw_ros_units_
+            ? static_cast< int >(command.reference_position * 2. * encoder_resolution_ / M_PI)
+            : static_cast< int >(command.reference_position));
+    epos_handle_.transport->setPositionCompareReferencePosition(node_id, reference_position);
+  }
+  if (is_position_compare_stale_ || command.enabled != written_position_compare_.enabled) {
+    if (command.enabled) {
+      epos_handle_.transport->enablePositionCompare(node_id);
+    } else {
+      epos_handle_.transport->disablePositionCompare(node_id);
+    }
+  }
+  written_position_compare_ = command;
+  is_position_compare_stale_ = false;
+
+  if (diagnostic_data_) {
+    diagnostic_data_->has_position_compare = true;
+    diagnostic_data_->position_compare_enabled = command.enabled;
+    diagnostic_data_->position_compare_reference_position = command.reference_position;
+  }
+}
+
+bool Epos::reloadPositionCompareCallback(std_srvs::Trigger::Request & /* request */,
+                                         std_srvs::Trigger::Response &response) {
+  if (isReconnecting() || isQuarantined()) {
+    response.success = false;
+    response.message = motor_name_ + " is not responding";
+    return true;
+  }
+  try {
+    // the device lock keeps write() off the node during reconfiguration
+    const DeviceLock lock(epos_handle_);
+    initPositionCompare(motor_nh_);
+    response.success = true;
+    response.message = "Reloaded position compare of " + motor_name_;
+  } catch (const EposException &error) {
+    response.success = false;
+    response.message = error.what();
+  }
+  return true;
+}
+
+void Epos::switchOperationMode() {
+  const OperationModePtr mode(pending_operation_mode_);
+  pending_operation_mode_.reset();
+  // the current mode keeps the last target of the stopped controller if activation fails
+  try {
+    mode->activate();
+  } catch (const EposException &error) {
+    ROS_ERROR_STREAM(error.what());
+    return;
+  }
+  operation_mode_ = mode;
+
+  const double latency((ros::WallTime::now() - switch_request_stamp_).toSec());
+  ROS_INFO_STREAM(motor_name_ << " switched to operation mode associated with "
+                              << pending_controller_name_ << " in " << latency * 1000. << " ms");
+  if (diagnostic_data_) {
+    ++diagnostic_data_->num_mode_switches;
+    diagnostic_data_->last_mode_switch_latency = latency;
+    diagnostic_data_->max_mode_switch_latency =
+        std::max(diagnostic_data_->max_mode_switch_latency, latency);
+  }
+}
+
+void Epos::setEnableState() {
+  if (fast_state_machine_) {
+    setEnableStateDirectly(epos_handle_);
+  } else {
+    epos_handle_.transport->setEnableState(epos_handle_.node_id);
+  }
+}
+
+void Epos::setDisableState() {
+  if (fast_state_machine_) {
+    setDisableStateDirectly(epos_handle_);
+  } else {
+    epos_handle_.transport->setDisableState(epos_handle_.node_id);
+  }
+}
+
+void Epos::updateWriteStamp() {
+  boost::lock_guard< boost::mutex > lock(write_stamp_mutex_);
+  write_stamp_ = ros::WallTime::now();
+}
+
 } // namespace eposx_hardware
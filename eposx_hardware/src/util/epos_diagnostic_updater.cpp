@@ -1,7 +1,9 @@
 #include <ios>
 #include <sstream>
 
+#include <eposx_hardware/canopen.h>
 #include <eposx_hardware/epos_diagnostic_updater.h>
+#include <eposx_hardware/epos_fault_recovery.h>
 #include <eposx_hardware/utils.h>
 #include <hardware_interface/actuator_command_interface.h>
 #include <hardware_interface/actuator_state_interface.h>
@@ -161,6 +163,62 @@ void EposDiagnosticUpdater::updateMotorDiagnostic(
       error_msg << "EPOS Device Error: 0x" << std::hex << device_error;
       stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, error_msg.str());
     }
+    if (diagnostic_data_->num_emcys > 0) {
+      std::ostringstream emcy_msg;
+      emcy_msg << "0x" << std::hex << diagnostic_data_->emcy_error_code << " (error register: 0x"
+               << static_cast< unsigned int >(diagnostic_data_->emcy_error_register) << ")";
+      stat.add("Number of EMCYs", diagnostic_data_->num_emcys);
+      stat.add("Last EMCY", emcy_msg.str());
+    }
+    if (diagnostic_data_->is_heartbeat_monitored) {
+      if (!diagnostic_data_->is_alive) {
+        stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Heartbeat timeout");
+      }
+      stat.add< bool >("Alive", diagnostic_data_->is_alive);
+      switch (diagnostic_data_->nmt_state) {
+      case CANOPEN_NMT_BOOT_UP:
+        stat.add("NMT State", "Boot-up");
+        break;
+      case CANOPEN_NMT_STOPPED:
+        stat.add("NMT State", "Stopped");
+        break;
+      case CANOPEN_NMT_OPERATIONAL:
+        stat.add("NMT State", "Operational");
+        break;
+      case CANOPEN_NMT_PRE_OPERATIONAL:
+        stat.add("NMT State", "Pre-operational");
+        break;
+      default:
+        stat.add("NMT State", "Unknown");
+        break;
+      }
+    }
+    if (diagnostic_data_->is_reconnecting) {
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Reconnecting");
+    }
+    if (diagnostic_data_->is_quarantined) {
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Not responding");
+    }
+    stat.add("Quarantined", diagnostic_data_->is_quarantined);
+    if (!diagnostic_data_->fault_recovery_state.empty()) {
+      if (diagnostic_data_->fault_recovery_state == toString(FAULT_RECOVERY_GAVE_UP)) {
+        stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Fault recovery gave up");
+      }
+      stat.add("Fault Recovery", diagnostic_data_->fault_recovery_state);
+      stat.add("Number of Fault Recoveries", diagnostic_data_->num_fault_recoveries);
+    }
+    stat.add("Number of Mode Switches", diagnostic_data_->num_mode_switches);
+    stat.add("Last Mode Switch Latency [ms]", diagnostic_data_->last_mode_switch_latency * 1000.);
+    stat.add("Worst Mode Switch Latency [ms]", diagnostic_data_->max_mode_switch_latency * 1000.);
+    if (diagnostic_data_->has_position_marker) {
+      stat.add("Position Marker Count", diagnostic_data_->position_marker_count);
+      stat.add("Position Marker Position", diagnostic_data_->position_marker_position);
+    }
+    if (diagnostic_data_->has_position_compare) {
+      stat.add("Position Compare Enabled", diagnostic_data_->position_compare_enabled);
+      stat.add("Position Compare Reference Position",
+               diagnostic_data_->position_compare_reference_position);
+    }
   } else {
     stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "No device errors read");
   }
@@ -0,0 +1,185 @@
+#include <algorithm>
+
+#include <eposx_hardware/epos_fault_recovery.h>
+#include <eposx_hardware/object_dictionary.h>
+#include <eposx_hardware/transport.h>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace eposx_hardware {
+
+std::string toString(const FaultRecoveryState state) {
+  switch (state) {
+  case FAULT_RECOVERY_IDLE:
+    return "Idle";
+  case FAULT_RECOVERY_WAITING:
+    return "Waiting";
+  case FAULT_RECOVERY_RECOVERING:
+    return "Recovering";
+  case FAULT_RECOVERY_RECOVERED:
+    return "Recovered";
+  case FAULT_RECOVERY_GAVE_UP:
+    return "Gave up";
+  case FAULT_RECOVERY_DISABLED:
+    return "Disabled";
+  }
+  return "Unknown";
+}
+
+EposFaultRecovery::EposFaultRecovery(ros::NodeHandle &motor_nh, const std::string &motor_name,
+                                     const eposx_hardware::NodeHandle &epos_handle)
+    : motor_name_(motor_name), epos_handle_(epos_handle),
+      delay_(motor_nh.param("fault_recovery/delay", 0.5)),
+      max_delay_(motor_nh.param("fault_recovery/max_delay", 10.)),
+      max_attempts_(motor_nh.param("fault_recovery/max_attempts", 5)),
+      fast_state_machine_(motor_nh.param("fast_state_machine", false)),
+      state_(FAULT_RECOVERY_IDLE), has_fault_(false), num_recoveries_(0), stopping_(false),
+      thread_(boost::bind(&EposFaultRecovery::run, this)) {}
+
+EposFaultRecovery::~EposFaultRecovery() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+void EposFaultRecovery::notifyFault() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    if (state_ != FAULT_RECOVERY_IDLE) {
+      return;
+    }
+    state_ = FAULT_RECOVERY_WAITING;
+    has_fault_ = true;
+  }
+  condition_.notify_all();
+}
+
+bool EposFaultRecovery::takeRecovered() {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  if (state_ != FAULT_RECOVERY_RECOVERED) {
+    return false;
+  }
+  state_ = FAULT_RECOVERY_IDLE;
+  return true;
+}
+
+void EposFaultRecovery::disable() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    state_ = FAULT_RECOVERY_DISABLED;
+    has_fault_ = false;
+  }
+  condition_.notify_all();
+}
+
+void EposFaultRecovery::reset() {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  if (state_ == FAULT_RECOVERY_GAVE_UP) {
+    state_ = FAULT_RECOVERY_IDLE;
+  }
+}
+
+FaultRecoveryState EposFaultRecovery::getState() const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  return state_;
+}
+
+bool EposFaultRecovery::isRecovering() const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  return state_ == FAULT_RECOVERY_WAITING || state_ == FAULT_RECOVERY_RECOVERING;
+}
+
+unsigned int EposFaultRecovery::getNumRecoveries() const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  return num_recoveries_;
+}
+
+void EposFaultRecovery::run() {
+  boost::unique_lock< boost::mutex > lock(mutex_);
+  while (true) {
+    while (!has_fault_ && !stopping_) {
+      condition_.wait(lock);
+    }
+    if (stopping_) {
+      return;
+    }
+    has_fault_ = false;
+
+    // attempt with exponential backoff
+    double delay(delay_);
+    bool is_recovered(false);
+    for (int attempt = 1; max_attempts_ <= 0 || attempt <= max_attempts_; ++attempt) {
+      if (!wait(lock, delay)) {
+        return;
+      }
+      if (state_ == FAULT_RECOVERY_DISABLED) {
+        break;
+      }
+      state_ = FAULT_RECOVERY_RECOVERING;
+      ROS_WARN_STREAM("Recovering " << motor_name_ << " from fault (attempt " << attempt << ")");
+      lock.unlock();
+      try {
+        recover();
+        is_recovered = true;
+      } catch (const EposException &error) {
+        ROS_ERROR_STREAM(error.what());
+      }
+      lock.lock();
+      if (is_recovered || state_ == FAULT_RECOVERY_DISABLED) {
+        break;
+      }
+      state_ = FAULT_RECOVERY_WAITING;
+      delay = std::min(delay * 2., max_delay_);
+    }
+
+    if (state_ == FAULT_RECOVERY_DISABLED) {
+      continue;
+    }
+    if (is_recovered) {
+      state_ = FAULT_RECOVERY_RECOVERED;
+      ++num_recoveries_;
+      ROS_INFO_STREAM(motor_name_ << " has recovered from fault");
+    } else {
+      state_ = FAULT_RECOVERY_GAVE_UP;
+      ROS_ERROR_STREAM("Gave up recovering " << motor_name_ << " from fault");
+    }
+  }
+}
+
+bool EposFaultRecovery::wait(boost::unique_lock< boost::mutex > &lock, const double duration) {
+  const boost::system_time deadline(
+      boost::get_system_time() +
+      boost::posix_time::microseconds(static_cast< boost::int64_t >(duration * 1000000.)));
+  while (!stopping_ && state_ != FAULT_RECOVERY_DISABLED &&
+         condition_.timed_wait(lock, deadline)) {
+  }
+  return !stopping_;
+}
+
+void EposFaultRecovery::recover() {
+  // keep other threads off the device during the sequence
+  const DeviceLock lock(epos_handle_);
+  {
+    // the node must stay disabled once recovery is disabled
+    boost::lock_guard< boost::mutex > state_lock(mutex_);
+    if (state_ == FAULT_RECOVERY_DISABLED) {
+      return;
+    }
+  }
+  const objects::Statusword::Type statusword(readObject< objects::Statusword >(epos_handle_));
+  if (statusword & SW_FAULT_BIT) {
+    epos_handle_.transport->clearFault(epos_handle_.node_id);
+  }
+  if (fast_state_machine_) {
+    setEnableStateDirectly(epos_handle_);
+  } else {
+    epos_handle_.transport->setEnableState(epos_handle_.node_id);
+  }
+}
+
+} // namespace eposx_hardware
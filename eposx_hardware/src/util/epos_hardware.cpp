@@ -11,13 +11,19 @@
 #include <transmission_interface/transmission_info.h>
 #include <urdf/model.h>
 
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/foreach.hpp>
 
 namespace eposx_hardware {
 
-EposHardware::EposHardware() {}
+EposHardware::EposHardware() : watchdog_deadline_(0.), watchdog_quick_stop_(true) {}
 
-EposHardware::~EposHardware() {}
+EposHardware::~EposHardware() {
+  // the watchdog accesses the motors
+  watchdog_thread_.interrupt();
+  watchdog_thread_.join();
+}
 
 //
 // init()
@@ -41,6 +47,7 @@ bool EposHardware::init(ros::NodeHandle &root_nh, ros::NodeHandle &hw_nh,
     initMotors(hw_nh, motor_names);
     initTransmissions(urdf_str);
     initJointLimits(urdf_str);
+    initWatchdog(hw_nh);
   } catch (const std::exception &error) {
     ROS_ERROR_STREAM(error.what());
     return false;
@@ -55,6 +62,8 @@ void EposHardware::initInterfaces() {
   registerInterface(&eff_ator_iface_);
   registerInterface(&bat_state_iface_);
   registerInterface(&epos_diag_iface_);
+  registerInterface(&epos_marker_iface_);
+  registerInterface(&epos_compare_iface_);
   registerInterface(&pos_jnt_sat_iface_);
   registerInterface(&vel_jnt_sat_iface_);
   registerInterface(&eff_jnt_sat_iface_);
@@ -160,6 +169,43 @@ void EposHardware::initJointLimits(const std::string &urdf_str) {
   eff_jnt_sat_iface_.updateLimits(root_nh_);
 }
 
+void EposHardware::initWatchdog(ros::NodeHandle &hw_nh) {
+  const double deadline(hw_nh.param("watchdog/deadline", 0.));
+  if (deadline <= 0.) {
+    return;
+  }
+  watchdog_deadline_ = ros::WallDuration(deadline);
+
+  const std::string action(hw_nh.param< std::string >("watchdog/action", "quick_stop"));
+  if (action == "quick_stop") {
+    watchdog_quick_stop_ = true;
+  } else if (action == "halt") {
+    watchdog_quick_stop_ = false;
+  } else {
+    throw EposException("Invalid watchdog action (" + action + ")");
+  }
+
+  watchdog_thread_ = boost::thread(boost::bind(&EposHardware::runWatchdog, this));
+}
+
+//
+// runWatchdog()
+//
+
+void EposHardware::runWatchdog() {
+  // check several times within the deadline so that a miss is detected soon after it happens
+  const boost::posix_time::microseconds interval(
+      static_cast< boost::int64_t >(watchdog_deadline_.toSec() * 1000000. / 4.));
+  try {
+    while (true) {
+      boost::this_thread::sleep(interval);
+      epos_manager_.checkDeadline(watchdog_deadline_, watchdog_quick_stop_);
+    }
+  } catch (const boost::thread_interrupted &) {
+    // destructed
+  }
+}
+
 //
 // doSwitch()
 //
@@ -1,12 +1,30 @@
+#include <algorithm>
+#include <map>
+
+#include <eposx_hardware/canopen.h>
 #include <eposx_hardware/epos_manager.h>
+#include <eposx_hardware/epos_pdo.h>
+#include <eposx_hardware/object_dictionary.h>
+#include <eposx_hardware/transport.h>
+#include <ros/time.h>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 
 namespace eposx_hardware {
 
-EposManager::EposManager() {}
+EposManager::EposManager()
+    : is_stopped_(false), num_stops_(0), num_deadline_misses_(0), last_stop_latency_(0.),
+      max_stop_latency_(0.) {}
 
-EposManager::~EposManager() {}
+EposManager::~EposManager() {
+  // disable all nodes in parallel before each motor disables its node on destruction
+  if (!motors_.empty()) {
+    stop(false);
+  }
+}
 
 void EposManager::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                        ros::NodeHandle &motors_nh, const std::vector< std::string > &motor_names) {
@@ -18,10 +36,93 @@ void EposManager::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh
     motor->init(hw, root_nh, motor_nh, motor_name);
     motors_.push_back(motor);
 
+    // group the motor with others on the same physical port
+    const boost::shared_ptr< DeviceExecutor > executor(getDeviceExecutor(motor->getNodeHandle()));
+    bool is_grouped(false);
+    BOOST_FOREACH (MotorGroup &motor_group, motor_groups_) {
+      if (motor_group.executor == executor) {
+        motor_group.motors.push_back(motor);
+        is_grouped = true;
+        break;
+      }
+    }
+    if (!is_grouped) {
+      MotorGroup motor_group;
+      motor_group.executor = executor;
+      motor_group.motors.push_back(motor);
+      motor_groups_.push_back(motor_group);
+    }
+
+    // register the device of the motor as a SYNC destination if required
+    if (motor->isSynchronous()) {
+      const DeviceHandle &device(motor->getNodeHandle());
+      bool is_registered(false);
+      BOOST_FOREACH (const DeviceHandle &sync_device, sync_devices_) {
+        if (sync_device.transport == device.transport) {
+          is_registered = true;
+          break;
+        }
+      }
+      if (!is_registered) {
+        sync_devices_.push_back(device);
+      }
+    }
+
+    addHostHeartbeat(motor);
+
     boost::shared_ptr< EposDiagnosticUpdater > diagnostic_updater(new EposDiagnosticUpdater());
     diagnostic_updater->init(hw, root_nh, motor_nh, motor_name);
     diagnostic_updaters_.push_back(diagnostic_updater);
   }
+
+  halted_write_stamps_.resize(motors_.size());
+
+  // reconnection of each device (sub devices on a port are different devices)
+  typedef std::map< Transport *,
+                    std::pair< DeviceHandle, std::vector< boost::shared_ptr< Epos > > > >
+      DeviceMotors;
+  DeviceMotors device_motors;
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) {
+    std::pair< DeviceHandle, std::vector< boost::shared_ptr< Epos > > > &motors(
+        device_motors[motor->getNodeHandle().transport.get()]);
+    motors.first = motor->getNodeHandle();
+    motors.second.push_back(motor);
+  }
+  BOOST_FOREACH (const DeviceMotors::value_type &motors, device_motors) {
+    reconnectors_.push_back(
+        boost::make_shared< EposReconnector >(motors.second.first, motors.second.second));
+  }
+
+  // emergency stop of all motors
+  quick_stop_server_ =
+      motors_nh.advertiseService("quick_stop", &EposManager::quickStopCallback, this);
+  diagnostic_updater_.reset(new diagnostic_updater::Updater(root_nh, motors_nh));
+  diagnostic_updater_->setHardwareID("EPOS manager");
+  diagnostic_updater_->add("EPOS manager: Stop",
+                           boost::bind(&EposManager::updateStopDiagnostic, this, _1));
+}
+
+void EposManager::addHostHeartbeat(const boost::shared_ptr< Epos > &motor) {
+  unsigned short node_id;
+  ros::WallDuration consumer_time;
+  if (!motor->getHostHeartbeat(node_id, consumer_time)) {
+    return;
+  }
+  // produce heartbeats twice as frequently as the node consumes them
+  // so that a single late cycle is tolerated
+  const ros::WallDuration period(consumer_time * 0.5);
+  const DeviceHandle &device(motor->getNodeHandle());
+  BOOST_FOREACH (HostHeartbeat &host_heartbeat, host_heartbeats_) {
+    if (host_heartbeat.device.transport == device.transport && host_heartbeat.node_id == node_id) {
+      host_heartbeat.period = std::min(host_heartbeat.period, period);
+      return;
+    }
+  }
+  HostHeartbeat host_heartbeat;
+  host_heartbeat.device = device;
+  host_heartbeat.node_id = node_id;
+  host_heartbeat.period = period;
+  host_heartbeats_.push_back(host_heartbeat);
 }
 
 void EposManager::doSwitch(const std::list< hardware_interface::ControllerInfo > &start_list,
@@ -32,11 +133,77 @@ void EposManager::doSwitch(const std::list< hardware_interface::ControllerInfo >
 }
 
 void EposManager::read() {
-  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) { motor->read(); }
+  // let all nodes sample their states at the same moment,
+  // and apply commands received in the last cycle
+  BOOST_FOREACH (const DeviceHandle &sync_device, sync_devices_) {
+    try {
+      EposPdo::sendSync(sync_device);
+    } catch (const EposException &error) {
+      ROS_ERROR_STREAM(error.what());
+    }
+  }
+
+  runOnGroups(&EposManager::readMotors);
+
+  // start reconnection of devices whose motors are all lost
+  BOOST_FOREACH (const boost::shared_ptr< EposReconnector > &reconnector, reconnectors_) {
+    reconnector->update();
+  }
 }
 
 void EposManager::write() {
-  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) { motor->write(); }
+  // heartbeats are produced in the control cycle so that nodes detect a stalled cycle as well as
+  // a dead host. they continue after stop so that stopped nodes do not detect timeouts.
+  sendHostHeartbeats();
+
+  // commands would bring stopped nodes back to motion
+  if (isStopped()) {
+    return;
+  }
+  runOnGroups(&EposManager::writeMotors);
+}
+
+void EposManager::sendHostHeartbeats() {
+  const ros::WallTime now(ros::WallTime::now());
+  BOOST_FOREACH (HostHeartbeat &host_heartbeat, host_heartbeats_) {
+    if (now - host_heartbeat.stamp < host_heartbeat.period) {
+      continue;
+    }
+    host_heartbeat.stamp = now;
+    try {
+      const DeviceLock lock(host_heartbeat.device);
+      const unsigned char nmt_state(CANOPEN_NMT_OPERATIONAL);
+      host_heartbeat.device.transport->sendCanFrame(CANOPEN_HEARTBEAT + host_heartbeat.node_id, 1,
+                                                    &nmt_state);
+    } catch (const EposException &error) {
+      ROS_ERROR_STREAM(error.what());
+    }
+  }
+}
+
+void EposManager::readMotors(const std::vector< boost::shared_ptr< Epos > > &motors) {
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors) { motor->read(); }
+}
+
+void EposManager::writeMotors(const std::vector< boost::shared_ptr< Epos > > &motors) {
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors) { motor->write(); }
+}
+
+void EposManager::runOnGroups(
+    void (*function)(const std::vector< boost::shared_ptr< Epos > > &)) {
+  // no benefit of threads if all motors share a port
+  if (motor_groups_.size() <= 1) {
+    function(motors_);
+    return;
+  }
+
+  // overlap I/O on the ports, and wait for all of them to complete the cycle
+  std::vector< boost::shared_future< void > > futures;
+  BOOST_FOREACH (const MotorGroup &motor_group, motor_groups_) {
+    futures.push_back(motor_group.executor->post< void >(
+        boost::bind(function, boost::cref(motor_group.motors))));
+  }
+  waitAll(futures);
 }
 
 void EposManager::updateDiagnostics() {
@@ -44,6 +211,161 @@ void EposManager::updateDiagnostics() {
                  diagnostic_updaters_) {
     diagnostic_updater_->update();
   }
+  if (diagnostic_updater_) {
+    diagnostic_updater_->update();
+  }
+}
+
+//
+// stop()
+//
+
+double EposManager::stop(const bool quick_stop) {
+  {
+    boost::lock_guard< boost::mutex > lock(stop_mutex_);
+    is_stopped_ = true;
+  }
+  // stopped nodes must not be enabled by recovery or reconnection
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) {
+    motor->disableFaultRecovery();
+  }
+  BOOST_FOREACH (const boost::shared_ptr< EposReconnector > &reconnector, reconnectors_) {
+    reconnector->disable();
+  }
+
+  // stop motors on all ports in parallel, and wait all ports even if some of them fail
+  const ros::WallTime start(ros::WallTime::now());
+  std::vector< boost::shared_future< void > > futures;
+  BOOST_FOREACH (const MotorGroup &motor_group, motor_groups_) {
+    futures.push_back(motor_group.executor->post< void >(
+        boost::bind(&EposManager::stopMotors, boost::cref(motor_group.motors), quick_stop)));
+  }
+  BOOST_FOREACH (const boost::shared_future< void > &future, futures) {
+    try {
+      future.get();
+    } catch (const EposException &error) {
+      ROS_ERROR_STREAM(error.what());
+    }
+  }
+  const double latency((ros::WallTime::now() - start).toSec());
+
+  boost::lock_guard< boost::mutex > lock(stop_mutex_);
+  ++num_stops_;
+  last_stop_latency_ = latency;
+  max_stop_latency_ = std::max(max_stop_latency_, latency);
+  return latency;
+}
+
+bool EposManager::isStopped() const {
+  boost::lock_guard< boost::mutex > lock(stop_mutex_);
+  return is_stopped_;
+}
+
+void EposManager::checkDeadline(const ros::WallDuration &deadline, const bool quick_stop) {
+  if (isStopped()) {
+    return;
+  }
+
+  const ros::WallTime now(ros::WallTime::now());
+  for (std::size_t i = 0; i < motors_.size(); ++i) {
+    // the watchdog is armed by the first write
+    const ros::WallTime write_stamp(motors_[i]->getLastWriteStamp());
+    if (write_stamp.isZero() || now - write_stamp <= deadline) {
+      continue;
+    }
+    // halt once for each late write
+    if (!quick_stop && write_stamp == halted_write_stamps_[i]) {
+      continue;
+    }
+    ROS_ERROR_STREAM("Commands to " << motors_[i]->getMotorName() << " are late by "
+                                    << (now - write_stamp).toSec() << " s");
+    {
+      boost::lock_guard< boost::mutex > lock(stop_mutex_);
+      ++num_deadline_misses_;
+    }
+    if (quick_stop) {
+      stop(true);
+      return;
+    }
+    try {
+      motors_[i]->halt();
+    } catch (const EposException &error) {
+      ROS_ERROR_STREAM(error.what());
+    }
+    halted_write_stamps_[i] = write_stamp;
+  }
+}
+
+void EposManager::stopMotors(const std::vector< boost::shared_ptr< Epos > > &motors,
+                             const bool quick_stop) {
+  // controlword requests of nodes on each device (sub devices on a port are different devices)
+  const objects::Controlword::Type controlword(quick_stop ? CW_QUICK_STOP : CW_SHUTDOWN);
+  typedef std::map< Transport *, std::pair< DeviceHandle, std::vector< ObjectRequest > > >
+      DeviceRequests;
+  DeviceRequests device_requests;
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors) {
+    const NodeHandle &node_handle(motor->getNodeHandle());
+    std::pair< DeviceHandle, std::vector< ObjectRequest > > &requests(
+        device_requests[node_handle.transport.get()]);
+    requests.first = node_handle;
+    requests.second.push_back(
+        makeWriteRequest< objects::Controlword >(node_handle.node_id, controlword));
+  }
+
+  BOOST_FOREACH (DeviceRequests::value_type &device_request, device_requests) {
+    const DeviceHandle &device_handle(device_request.second.first);
+    std::vector< ObjectRequest > &requests(device_request.second.second);
+    const DeviceLock lock(device_handle);
+    // on CANopen, unconfirmed NMT frames first stop the nodes processing receive PDOs
+    // which would overwrite the controlword with the last commands.
+    // they are addressed to each node because a broadcast would also affect nodes not managed.
+    // the motors read actual values by SDOs afterwards because the nodes send no transmit PDOs.
+    if (quick_stop && getProtocolStackName(device_handle) == "CANopen") {
+      BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors) {
+        const NodeHandle &node_handle(motor->getNodeHandle());
+        if (node_handle.transport != device_handle.transport) {
+          continue;
+        }
+        motor->stopPdo();
+        try {
+          device_handle.transport->sendNmtService(node_handle.node_id, NCS_ENTER_PRE_OPERATIONAL);
+        } catch (const EposException &error) {
+          ROS_ERROR_STREAM(error.what());
+        }
+      }
+    }
+    // controlwords to all nodes in a batch. SocketCAN overlaps the transfers to different nodes
+    // (about one round trip), but other transports take a round trip per node.
+    device_handle.transport->submitObjects(requests);
+    BOOST_FOREACH (const ObjectRequest &request, requests) {
+      if (request.error) {
+        ROS_ERROR_STREAM(request.error->what());
+      }
+    }
+  }
+}
+
+bool EposManager::quickStopCallback(std_srvs::Trigger::Request & /* request */,
+                                    std_srvs::Trigger::Response &response) {
+  const double latency(stop(true));
+  response.success = true;
+  response.message = "Stopped all motors in " +
+                     boost::lexical_cast< std::string >(latency * 1000.) + " ms";
+  ROS_WARN_STREAM(response.message);
+  return true;
+}
+
+void EposManager::updateStopDiagnostic(diagnostic_updater::DiagnosticStatusWrapper &stat) {
+  boost::lock_guard< boost::mutex > lock(stop_mutex_);
+  if (is_stopped_) {
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Stopped");
+  } else {
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Running");
+  }
+  stat.add("Number of stops", num_stops_);
+  stat.add("Number of deadline misses", num_deadline_misses_);
+  stat.add("Last stop latency [ms]", last_stop_latency_ * 1000.);
+  stat.add("Worst stop latency [ms]", max_stop_latency_ * 1000.);
 }
 
 } // namespace eposx_hardware
@@ -3,6 +3,8 @@
 #include <typeinfo>
 
 #include <eposx_hardware/epos_operation_mode.h>
+#include <eposx_hardware/object_dictionary.h>
+#include <eposx_hardware/transport.h>
 #include <eposx_hardware/utils.h>
 #include <hardware_interface/actuator_command_interface.h>
 #include <hardware_interface/actuator_state_interface.h>
@@ -10,6 +12,7 @@
 #include <transmission_interface/transmission_parser.h>
 
 #include <boost/core/demangle.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -114,6 +117,9 @@ std::vector< std::string > getJointNames(ros::NodeHandle &urdf_nh,
 
 EposOperationMode::~EposOperationMode() {}
 
+void EposOperationMode::prepare() { /* nothing to do */
+}
+
 //
 // profile position mode
 //
@@ -122,7 +128,8 @@ EposProfilePositionMode::~EposProfilePositionMode() {}
 
 void EposProfilePositionMode::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                                    ros::NodeHandle &motor_nh, const std::string &motor_name,
-                                   eposx_hardware::NodeHandle &epos_handle) {
+                                   eposx_hardware::NodeHandle &epos_handle,
+                                   const boost::shared_ptr< EposPdo > &pdo) {
   // register position command handle
   registerHandleTo< hardware_interface::PositionActuatorInterface >(hw, motor_name, &position_cmd_);
 
@@ -132,6 +139,7 @@ void EposProfilePositionMode::init(hardware_interface::RobotHW &hw, ros::NodeHan
 
   // init epos handle
   epos_handle_ = epos_handle;
+  pdo_ = pdo;
   const std::string device_name(getDeviceName(epos_handle_));
   if (device_name != "EPOS" && device_name != "EPOS2" && device_name != "EPOS4") {
     throw EposException(device_name + " does not support profile position mode");
@@ -140,6 +148,9 @@ void EposProfilePositionMode::init(hardware_interface::RobotHW &hw, ros::NodeHan
   // use ros unit for position command
   rw_ros_units_ = motor_nh.param("rw_ros_units", false);
 
+  // activate the mode by modes of operation instead of the high-level function
+  fast_state_machine_ = motor_nh.param("fast_state_machine", false);
+
   // get encoder resolution for unit conversion
   if (rw_ros_units_) {
     ros::NodeHandle sensor_nh(motor_nh, "sensor");
@@ -162,9 +173,13 @@ void EposProfilePositionMode::init(hardware_interface::RobotHW &hw, ros::NodeHan
       throw EposException("Invalid sensor type (" + boost::lexical_cast< std::string >(type) + ")");
     }
   }
+
+  new_setpoint_ = false;
+  has_setpoint_ = false;
+  setpoint_ = 0;
 }
 
-void EposProfilePositionMode::activate() {
+void EposProfilePositionMode::prepare() {
   if (pos_sat_iface_) {
     // reset command saturation handle because position version is stateful.
     // we don't have to reset velocity & effort versions.
@@ -172,7 +187,17 @@ void EposProfilePositionMode::activate() {
       pos_sat_iface_->reset(joint_name);
     }
   }
-  VCS_N0(ActivateProfilePositionMode, epos_handle_);
+}
+
+void EposProfilePositionMode::activate() {
+  if (fast_state_machine_) {
+    setOperationModeDirectly(epos_handle_, MODE_PROFILE_POSITION);
+  } else {
+    epos_handle_.transport->activateProfilePositionMode(epos_handle_.node_id);
+  }
+  // latch the next target again after the mode is (re)activated
+  new_setpoint_ = false;
+  has_setpoint_ = false;
 }
 
 void EposProfilePositionMode::read() { /* nothing to do */
@@ -190,8 +215,40 @@ void EposProfilePositionMode::write() {
   } else {
     cmd = static_cast< int >(position_cmd_);
   }
-  VCS_NN(MoveToPosition, epos_handle_, cmd, true /* target position is absolute */,
-         true /* overwrite old target position */);
+  namespace od = objects;
+  if (pdo_ && pdo_->hasRxObject(od::TargetPosition::index, od::TargetPosition::subindex) &&
+      pdo_->hasRxObject(od::Controlword::index, od::Controlword::subindex)) {
+    // a target position is accepted on a rising edge of the new-setpoint bit in controlword.
+    // raise the bit when the target changes, and clear it after the node acknowledges,
+    // so that the next target makes a new edge. the target is absolute and applied immediately.
+    if (new_setpoint_ || !has_setpoint_ || cmd != setpoint_) {
+      od::Statusword::Type statusword;
+      if (!pdo_->getTxObject< od::Statusword >(statusword)) {
+        statusword = readObject< od::Statusword >(epos_handle_);
+      }
+      const bool is_acknowledged((statusword & SW_SETPOINT_ACKNOWLEDGE) != 0);
+      if (new_setpoint_) {
+        new_setpoint_ = !is_acknowledged;
+      } else if (!is_acknowledged) {
+        // the node clears the acknowledge after the bit is cleared
+        setpoint_ = cmd;
+        has_setpoint_ = true;
+        new_setpoint_ = true;
+      }
+    }
+    pdo_->setRxObject< od::TargetPosition >(setpoint_);
+    pdo_->setRxObject< od::Controlword >(CW_ENABLE_OPERATION | CW_CHANGE_SET_IMMEDIATELY |
+                                         (new_setpoint_ ? CW_NEW_SETPOINT : 0));
+  } else {
+    epos_handle_.transport->moveToPosition(epos_handle_.node_id, cmd,
+                                           true /* target position is absolute */,
+                                           true /* overwrite old target position */);
+  }
+}
+
+void EposProfilePositionMode::halt() {
+  // halt on the profile deceleration
+  writeObject< objects::Controlword >(epos_handle_, CW_ENABLE_OPERATION | CW_HALT);
 }
 
 //
@@ -202,12 +259,14 @@ EposProfileVelocityMode::~EposProfileVelocityMode() {}
 
 void EposProfileVelocityMode::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                                    ros::NodeHandle &motor_nh, const std::string &motor_name,
-                                   eposx_hardware::NodeHandle &epos_handle) {
+                                   eposx_hardware::NodeHandle &epos_handle,
+                                   const boost::shared_ptr< EposPdo > &pdo) {
   // register velocity command handle
   registerHandleTo< hardware_interface::VelocityActuatorInterface >(hw, motor_name, &velocity_cmd_);
 
   // init epos handle
   epos_handle_ = epos_handle;
+  pdo_ = pdo;
   const std::string device_name(getDeviceName(epos_handle_));
   if (device_name != "EPOS" && device_name != "EPOS2" && device_name != "EPOS4") {
     throw EposException(device_name + " does not support profile velocity mode");
@@ -216,11 +275,20 @@ void EposProfileVelocityMode::init(hardware_interface::RobotHW &hw, ros::NodeHan
   // use ros unit for position command
   rw_ros_units_ = motor_nh.param("rw_ros_units", false);
 
+  // activate the mode by modes of operation instead of the high-level function
+  fast_state_machine_ = motor_nh.param("fast_state_machine", false);
+
   // halt velocity when command is 0
   halt_velocity_ = motor_nh.param("halt_velocity", false);
 }
 
-void EposProfileVelocityMode::activate() { VCS_N0(ActivateProfileVelocityMode, epos_handle_); }
+void EposProfileVelocityMode::activate() {
+  if (fast_state_machine_) {
+    setOperationModeDirectly(epos_handle_, MODE_PROFILE_VELOCITY);
+  } else {
+    epos_handle_.transport->activateProfileVelocityMode(epos_handle_.node_id);
+  }
+}
 
 void EposProfileVelocityMode::read() { /* nothing to do*/
 }
@@ -237,13 +305,24 @@ void EposProfileVelocityMode::write() {
   } else {
     cmd = static_cast< int >(velocity_cmd_);
   }
-  if (cmd == 0 && halt_velocity_) {
-    VCS_N0(HaltVelocityMovement, epos_handle_);
+  const bool halt(cmd == 0 && halt_velocity_);
+  namespace od = objects;
+  if (pdo_ && pdo_->hasRxObject(od::TargetVelocity::index, od::TargetVelocity::subindex) &&
+      pdo_->hasRxObject(od::Controlword::index, od::Controlword::subindex)) {
+    pdo_->setRxObject< od::TargetVelocity >(cmd);
+    pdo_->setRxObject< od::Controlword >(CW_ENABLE_OPERATION | (halt ? CW_HALT : 0));
+  } else if (halt) {
+    epos_handle_.transport->haltVelocityMovement(epos_handle_.node_id);
   } else {
-    VCS_NN(MoveWithVelocity, epos_handle_, cmd);
+    epos_handle_.transport->moveWithVelocity(epos_handle_.node_id, cmd);
   }
 }
 
+void EposProfileVelocityMode::halt() {
+  // halt on the profile deceleration
+  writeObject< objects::Controlword >(epos_handle_, CW_ENABLE_OPERATION | CW_HALT);
+}
+
 //
 // current mode
 //
@@ -252,12 +331,14 @@ EposCurrentMode::~EposCurrentMode() {}
 
 void EposCurrentMode::init(hardware_interface::RobotHW &hw, ros::NodeHandle &root_nh,
                            ros::NodeHandle &motor_nh, const std::string &motor_name,
-                           eposx_hardware::NodeHandle &epos_handle) {
+                           eposx_hardware::NodeHandle &epos_handle,
+                           const boost::shared_ptr< EposPdo > &pdo) {
   // register effort command handle
   registerHandleTo< hardware_interface::EffortActuatorInterface >(hw, motor_name, &effort_cmd_);
 
   // init epos handle
   epos_handle_ = epos_handle;
+  pdo_ = pdo;
   const std::string device_name(getDeviceName(epos_handle_));
   if (device_name != "EPOS" && device_name != "EPOS2") {
     throw EposException(device_name + " does not support current mode");
@@ -266,11 +347,20 @@ void EposCurrentMode::init(hardware_interface::RobotHW &hw, ros::NodeHandle &roo
   // use ros unit for position command
   rw_ros_units_ = motor_nh.param("rw_ros_units", false);
 
+  // activate the mode by modes of operation instead of the high-level function
+  fast_state_machine_ = motor_nh.param("fast_state_machine", false);
+
   // torque-current constant for unit conversion
   GET_PARAM_KV(motor_nh, "motor/torque_constant", torque_constant_);
 }
 
-void EposCurrentMode::activate() { VCS_N0(ActivateCurrentMode, epos_handle_); }
+void EposCurrentMode::activate() {
+  if (fast_state_machine_) {
+    setOperationModeDirectly(epos_handle_, MODE_CURRENT);
+  } else {
+    epos_handle_.transport->activateCurrentMode(epos_handle_.node_id);
+  }
+}
 
 void EposCurrentMode::read() { /* nothing to do */
 }
@@ -288,7 +378,14 @@ void EposCurrentMode::write() {
     // A -> mA
     cmd = static_cast< int >(effort_cmd_ / torque_constant_ * 1000.);
   }
-  VCS_NN(SetCurrentMust, epos_handle_, cmd);
+  if (!pdo_ || !pdo_->setRxObject< objects::CurrentModeSettingValue >(cmd)) {
+    epos_handle_.transport->setCurrentMust(epos_handle_.node_id, cmd);
+  }
+}
+
+void EposCurrentMode::halt() {
+  // the halt bit is not evaluated in current mode
+  epos_handle_.transport->setCurrentMust(epos_handle_.node_id, 0);
 }
 
 //
@@ -300,12 +397,14 @@ EposCyclicSynchronoustTorqueMode::~EposCyclicSynchronoustTorqueMode() {}
 void EposCyclicSynchronoustTorqueMode::init(hardware_interface::RobotHW &hw,
                                             ros::NodeHandle &root_nh, ros::NodeHandle &motor_nh,
                                             const std::string &motor_name,
-                                            eposx_hardware::NodeHandle &epos_handle) {
+                                            eposx_hardware::NodeHandle &epos_handle,
+                                            const boost::shared_ptr< EposPdo > &pdo) {
   // register effort command handle
   registerHandleTo< hardware_interface::EffortActuatorInterface >(hw, motor_name, &effort_cmd_);
 
   // init epos handle
   epos_handle_ = epos_handle;
+  pdo_ = pdo;
   const std::string device_name(getDeviceName(epos_handle_));
   if (device_name != "EPOS4") {
     throw EposException(device_name + " does not support cyclic synchronoust torque mode");
@@ -314,13 +413,16 @@ void EposCyclicSynchronoustTorqueMode::init(hardware_interface::RobotHW &hw,
   // use ros unit for position command
   rw_ros_units_ = motor_nh.param("rw_ros_units", false);
 
+  // activate the mode by modes of operation instead of the high-level function
+  fast_state_machine_ = motor_nh.param("fast_state_machine", false);
+
   // set torque constant for unit conversion in epos
   double torque_constant;
   GET_PARAM_KV(motor_nh, "motor/torque_constant", torque_constant);
   {
     // mAm/A -> uAm/A
-    boost::uint32_t data(torque_constant * 1000.);
-    VCS_OBJ(SetObject, epos_handle_, 0x3001, 0x05, &data, 4);
+    writeObject< objects::TorqueConstant >(epos_handle_,
+                                           static_cast< boost::uint32_t >(torque_constant * 1000.));
   }
 
   // load motor-rated-torque
@@ -329,7 +431,13 @@ void EposCyclicSynchronoustTorqueMode::init(hardware_interface::RobotHW &hw,
   motor_rated_torque_ = nominal_current * torque_constant;
 }
 
-void EposCyclicSynchronoustTorqueMode::activate() { VCS_NN(SetOperationMode, epos_handle_, 10); }
+void EposCyclicSynchronoustTorqueMode::activate() {
+  if (fast_state_machine_) {
+    setOperationModeDirectly(epos_handle_, MODE_CYCLIC_SYNCHRONOUS_TORQUE);
+  } else {
+    epos_handle_.transport->setOperationMode(epos_handle_.node_id, MODE_CYCLIC_SYNCHRONOUS_TORQUE);
+  }
+}
 
 void EposCyclicSynchronoustTorqueMode::read() { /* nothing to do */
 }
@@ -347,7 +455,14 @@ void EposCyclicSynchronoustTorqueMode::write() {
     // mNm -> per mille of motor rated torque
     cmd = static_cast< boost::int16_t >(effort_cmd_ / motor_rated_torque_ * 1000.);
   }
-  VCS_OBJ(SetObject, epos_handle_, 0x6071, 0x00, &cmd, 2);
+  if (!pdo_ || !pdo_->setRxObject< objects::TargetTorque >(cmd)) {
+    writeObject< objects::TargetTorque >(epos_handle_, cmd);
+  }
+}
+
+void EposCyclicSynchronoustTorqueMode::halt() {
+  // the halt bit is not evaluated in cyclic synchronous torque mode
+  writeObject< objects::TargetTorque >(epos_handle_, 0);
 }
 
 } // namespace eposx_hardware
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include <cstring>
+
+#include <eposx_hardware/canopen.h>
+#include <eposx_hardware/epos_pdo.h>
+#include <eposx_hardware/transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace eposx_hardware {
+
+//
+// objects which can be mapped to PDOs
+//
+
+struct PdoObject {
+  const char *name;
+  const char *device_name; // empty if common in all types of devices
+  unsigned short index;
+  unsigned char subindex;
+  unsigned char length; // in bytes
+};
+
+static const PdoObject pdo_objects[] = {
+    // device-specific objects (looked up first)
+    {"current_actual_value", "EPOS4", 0x30D1, 0x02, 4},
+    {"position_marker_counter", "EPOS2", 0x2074, 0x04, 2},
+    // common objects
+    {"controlword", "", 0x6040, 0x00, 2},
+    {"statusword", "", 0x6041, 0x00, 2},
+    {"modes_of_operation", "", 0x6060, 0x00, 1},
+    {"modes_of_operation_display", "", 0x6061, 0x00, 1},
+    {"position_actual_value", "", 0x6064, 0x00, 4},
+    {"velocity_actual_value", "", 0x606C, 0x00, 4},
+    {"target_torque", "", 0x6071, 0x00, 2},
+    {"torque_actual_value", "", 0x6077, 0x00, 2},
+    {"current_actual_value", "", 0x6078, 0x00, 2},
+    {"target_position", "", 0x607A, 0x00, 4},
+    {"target_velocity", "", 0x60FF, 0x00, 4},
+    {"current_mode_setting_value", "", 0x2030, 0x00, 2}};
+
+static const PdoObject &findPdoObject(const std::string &name, const std::string &device_name) {
+  const std::size_t num_objects(sizeof(pdo_objects) / sizeof(pdo_objects[0]));
+  for (std::size_t i = 0; i < num_objects; ++i) {
+    if (name == pdo_objects[i].name && device_name == pdo_objects[i].device_name) {
+      return pdo_objects[i];
+    }
+  }
+  for (std::size_t i = 0; i < num_objects; ++i) {
+    if (name == pdo_objects[i].name && std::string(pdo_objects[i].device_name).empty()) {
+      return pdo_objects[i];
+    }
+  }
+  throw EposException("Unsupported PDO object (" + name + ")");
+}
+
+#define MAX_PDOS 4 // number of TPDOs and RPDOs on EPOS devices
+
+//
+// EposPdo
+//
+
+EposPdo::EposPdo()
+    : is_stopped_(false), synchronous_(false), transmission_type_(255), inhibit_time_(0),
+      event_timer_(0), read_timeout_(0) {}
+
+EposPdo::~EposPdo() {}
+
+void EposPdo::init(ros::NodeHandle &motor_nh, const eposx_hardware::NodeHandle &epos_handle) {
+  epos_handle_ = epos_handle;
+
+  // PDOs are available only on CANopen
+  const std::string protocol_stack_name(getProtocolStackName(epos_handle_));
+  if (protocol_stack_name != "CANopen") {
+    throw EposException("PDO is not available on " + protocol_stack_name);
+  }
+
+  // load mapping
+  ros::NodeHandle pdo_nh(motor_nh, "pdo");
+  const std::string device_name(getDeviceName(epos_handle_));
+  tpdos_ = loadPdos(pdo_nh, "tpdo", CANOPEN_TPDO1, device_name, epos_handle_.node_id);
+  rpdos_ = loadPdos(pdo_nh, "rpdo", CANOPEN_RPDO1, device_name, epos_handle_.node_id);
+
+  // load transmission settings
+  // (synchronous PDOs are transmitted by the node on every SYNC by default)
+  synchronous_ = pdo_nh.param("sync", false);
+  transmission_type_ = pdo_nh.param("transmission_type", synchronous_ ? 1 : 255);
+  if (synchronous_ && (transmission_type_ == 0 || transmission_type_ > 240)) {
+    throw EposException("Transmission type of synchronous PDOs must be in [1,240] (" +
+                        boost::lexical_cast< std::string >(int(transmission_type_)) + ")");
+  }
+  inhibit_time_ = static_cast< unsigned short >(
+      10. * pdo_nh.param("inhibit_time", 0.) /* ms -> 100us */);
+  event_timer_ = pdo_nh.param("event_timer", 0);
+  read_timeout_ = pdo_nh.param("read_timeout", 1);
+}
+
+std::vector< EposPdo::Pdo > EposPdo::loadPdos(ros::NodeHandle &pdo_nh, const std::string &prefix,
+                                              const unsigned short base_cob_id,
+                                              const std::string &device_name,
+                                              const unsigned short node_id) {
+  std::vector< Pdo > pdos;
+  for (unsigned char number = 0; number < MAX_PDOS; ++number) {
+    // load names of objects mapped to the PDO
+    const std::string param_name(prefix + boost::lexical_cast< std::string >(number + 1));
+    std::vector< std::string > object_names;
+    if (!pdo_nh.getParam(param_name, object_names)) {
+      continue;
+    }
+
+    // locate objects in the PDO
+    Pdo pdo;
+    pdo.number = number;
+    pdo.cob_id = base_cob_id + 0x100 * number + node_id;
+    pdo.length = 0;
+    BOOST_FOREACH (const std::string &object_name, object_names) {
+      const PdoObject &object(findPdoObject(object_name, device_name));
+      Entry entry;
+      entry.index = object.index;
+      entry.subindex = object.subindex;
+      entry.offset = pdo.length;
+      entry.length = object.length;
+      pdo.entries.push_back(entry);
+      pdo.length += object.length;
+    }
+    if (pdo.length > 8) {
+      throw EposException(pdo_nh.resolveName(param_name) + " exceeds 8 bytes");
+    }
+    std::memset(pdo.data, 0, 8);
+    pdos.push_back(pdo);
+  }
+  return pdos;
+}
+
+void EposPdo::start() {
+  // mapping can be modified only in pre-operational state
+  epos_handle_.transport->sendNmtService(epos_handle_.node_id, NCS_ENTER_PRE_OPERATIONAL);
+
+  // write mapping of all PDOs (unused PDOs are disabled)
+  for (unsigned char number = 0; number < MAX_PDOS; ++number) {
+    const Pdo *tpdo(NULL);
+    BOOST_FOREACH (const Pdo &pdo, tpdos_) {
+      if (pdo.number == number) {
+        tpdo = &pdo;
+      }
+    }
+    writeMapping(0x1800 + number, 0x1A00 + number, tpdo, true);
+
+    const Pdo *rpdo(NULL);
+    BOOST_FOREACH (const Pdo &pdo, rpdos_) {
+      if (pdo.number == number) {
+        rpdo = &pdo;
+      }
+    }
+    writeMapping(0x1400 + number, 0x1600 + number, rpdo, false);
+  }
+
+  // initialize the process image with actual values
+  // so that sending receive PDOs before setting any object does not change the node's state
+  BOOST_FOREACH (Pdo &tpdo, tpdos_) { readImage(tpdo); }
+  BOOST_FOREACH (Pdo &rpdo, rpdos_) { readImage(rpdo); }
+
+  // start exchanging PDOs
+  epos_handle_.transport->sendNmtService(epos_handle_.node_id, NCS_START_REMOTE_NODE);
+  is_stopped_ = false;
+}
+
+void EposPdo::stop() { is_stopped_ = true; }
+
+void EposPdo::writeMapping(const unsigned short comm_index, const unsigned short mapping_index,
+                           const Pdo *pdo, const bool is_tpdo) {
+  // invalidate the PDO during reconfiguration
+  boost::uint32_t cob_id;
+  if (pdo) {
+    cob_id = pdo->cob_id;
+  } else {
+    epos_handle_.transport->getObject(epos_handle_.node_id, comm_index, 0x01, &cob_id, 4);
+  }
+  {
+    boost::uint32_t data(cob_id | 0x80000000);
+    epos_handle_.transport->setObject(epos_handle_.node_id, comm_index, 0x01, &data, 4);
+  }
+  if (!pdo) {
+    return;
+  }
+
+  // write mapping entries
+  {
+    boost::uint8_t data(0);
+    epos_handle_.transport->setObject(epos_handle_.node_id, mapping_index, 0x00, &data, 1);
+  }
+  for (std::size_t i = 0; i < pdo->entries.size(); ++i) {
+    const Entry &entry(pdo->entries[i]);
+    boost::uint32_t data((entry.index << 16) | (entry.subindex << 8) | (entry.length * 8));
+    epos_handle_.transport->setObject(epos_handle_.node_id, mapping_index, i + 1, &data, 4);
+  }
+  {
+    boost::uint8_t data(pdo->entries.size());
+    epos_handle_.transport->setObject(epos_handle_.node_id, mapping_index, 0x00, &data, 1);
+  }
+
+  // write communication parameters
+  {
+    // receive PDOs are applied on reception, or on the next SYNC if synchronous
+    boost::uint8_t data(is_tpdo ? transmission_type_ : (synchronous_ ? 1 : 255));
+    epos_handle_.transport->setObject(epos_handle_.node_id, comm_index, 0x02, &data, 1);
+  }
+  if (is_tpdo) {
+    boost::uint16_t inhibit_time(inhibit_time_);
+    epos_handle_.transport->setObject(epos_handle_.node_id, comm_index, 0x03, &inhibit_time, 2);
+    boost::uint16_t event_timer(event_timer_);
+    epos_handle_.transport->setObject(epos_handle_.node_id, comm_index, 0x05, &event_timer, 2);
+  }
+
+  // validate the PDO
+  {
+    boost::uint32_t data(cob_id & ~0x80000000);
+    epos_handle_.transport->setObject(epos_handle_.node_id, comm_index, 0x01, &data, 4);
+  }
+}
+
+void EposPdo::readImage(Pdo &pdo) {
+  BOOST_FOREACH (const Entry &entry, pdo.entries) {
+    epos_handle_.transport->getObject(epos_handle_.node_id, entry.index, entry.subindex,
+                                      pdo.data + entry.offset, entry.length);
+  }
+}
+
+void EposPdo::receive() {
+  // a pre-operational node sends no transmit PDOs
+  if (is_stopped_) {
+    return;
+  }
+  // PDOs of transmission type 1 are sent on every SYNC. other PDOs are sent only on some SYNCs,
+  // on change, or by the event timer, so a missing one means the last image is still valid.
+  const bool is_every_sync(transmission_type_ == 1);
+  BOOST_FOREACH (Pdo &tpdo, tpdos_) {
+    if (!epos_handle_.transport->readLatestCanFrame(tpdo.cob_id, tpdo.length, tpdo.data,
+                                                    is_every_sync ? read_timeout_ : 0) &&
+        is_every_sync) {
+      throw EposException("ReadCANFrame (Timeout on COB-ID " +
+                          boost::lexical_cast< std::string >(tpdo.cob_id) + ")");
+    }
+  }
+}
+
+void EposPdo::transmit() {
+  if (is_stopped_) {
+    return;
+  }
+  BOOST_FOREACH (Pdo &rpdo, rpdos_) {
+    epos_handle_.transport->sendCanFrame(rpdo.cob_id, rpdo.length, rpdo.data);
+  }
+}
+
+bool EposPdo::isSynchronous() const { return synchronous_; }
+
+void EposPdo::sendSync(const eposx_hardware::DeviceHandle &device_handle) {
+  unsigned char data[8]; // a SYNC frame has no data
+  const DeviceLock lock(device_handle);
+  device_handle.transport->sendCanFrame(CANOPEN_SYNC, 0, data);
+}
+
+bool EposPdo::hasRxObject(const unsigned short index, const unsigned char subindex) const {
+  if (is_stopped_) {
+    return false;
+  }
+  BOOST_FOREACH (const Pdo &rpdo, rpdos_) {
+    BOOST_FOREACH (const Entry &entry, rpdo.entries) {
+      if (entry.index == index && entry.subindex == subindex) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// data in PDOs are little-endian as well as the host (x86 or x86_64)
+bool EposPdo::getTxData(const unsigned short index, const unsigned char subindex, void *data,
+                        const unsigned char length) const {
+  if (is_stopped_) {
+    return false;
+  }
+  BOOST_FOREACH (const Pdo &tpdo, tpdos_) {
+    BOOST_FOREACH (const Entry &entry, tpdo.entries) {
+      if (entry.index == index && entry.subindex == subindex && entry.length == length) {
+        std::memcpy(data, tpdo.data + entry.offset, length);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool EposPdo::setRxData(const unsigned short index, const unsigned char subindex,
+                        const void *data, const unsigned char length) {
+  if (is_stopped_) {
+    return false;
+  }
+  BOOST_FOREACH (Pdo &rpdo, rpdos_) {
+    BOOST_FOREACH (const Entry &entry, rpdo.entries) {
+      if (entry.index == index && entry.subindex == subindex && entry.length == length) {
+        std::memcpy(rpdo.data + entry.offset, data, length);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include <eposx_hardware/epos_reconnector.h>
+#include <eposx_hardware/transport.h>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace eposx_hardware {
+
+// delay before each attempt in seconds, which doubles after every failure up to the max
+#define RECONNECTION_DELAY 1.
+#define RECONNECTION_MAX_DELAY 10.
+
+EposReconnector::EposReconnector(const eposx_hardware::DeviceHandle &device_handle,
+                                 const std::vector< boost::shared_ptr< Epos > > &motors)
+    : device_handle_(device_handle), motors_(motors), is_reconnecting_(false),
+      is_disabled_(false), stopping_(false), thread_(boost::bind(&EposReconnector::run, this)) {}
+
+EposReconnector::~EposReconnector() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+void EposReconnector::update() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    if (is_reconnecting_ || is_disabled_) {
+      return;
+    }
+    // a single lost node is not a lost device
+    BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) {
+      if (!motor->isLost()) {
+        return;
+      }
+    }
+    // keep the control thread off the motors until they are configured again
+    BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) {
+      motor->setReconnecting(true);
+    }
+    is_reconnecting_ = true;
+  }
+  condition_.notify_all();
+}
+
+void EposReconnector::disable() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    is_disabled_ = true;
+  }
+  condition_.notify_all();
+}
+
+bool EposReconnector::isReconnecting() const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  return is_reconnecting_;
+}
+
+void EposReconnector::run() {
+  boost::unique_lock< boost::mutex > lock(mutex_);
+  while (true) {
+    while (!is_reconnecting_ && !stopping_) {
+      condition_.wait(lock);
+    }
+    if (stopping_) {
+      return;
+    }
+    ROS_ERROR_STREAM("Lost device on " << getPortName(device_handle_));
+
+    // attempt with exponential backoff until reconnected or disabled.
+    // the motors stay in reconnection if disabled because the device is unusable.
+    double delay(RECONNECTION_DELAY);
+    for (int attempt = 1; true; ++attempt) {
+      if (!wait(lock, delay)) {
+        break;
+      }
+      ROS_WARN_STREAM("Reconnecting device on " << getPortName(device_handle_) << " (attempt "
+                                                << attempt << ")");
+      lock.unlock();
+      bool is_reconnected(false);
+      try {
+        is_reconnected = reconnect();
+      } catch (const EposException &error) {
+        ROS_ERROR_STREAM(error.what());
+      }
+      lock.lock();
+      if (is_reconnected) {
+        is_reconnecting_ = false;
+        ROS_INFO_STREAM("Reconnected device on " << getPortName(device_handle_));
+        break;
+      }
+      delay = std::min(delay * 2., RECONNECTION_MAX_DELAY);
+    }
+    if (stopping_ || is_disabled_) {
+      return;
+    }
+  }
+}
+
+bool EposReconnector::wait(boost::unique_lock< boost::mutex > &lock, const double duration) {
+  const boost::system_time deadline(
+      boost::get_system_time() +
+      boost::posix_time::microseconds(static_cast< boost::int64_t >(duration * 1000000.)));
+  while (!stopping_ && !is_disabled_ && condition_.timed_wait(lock, deadline)) {
+  }
+  return !stopping_ && !is_disabled_;
+}
+
+bool EposReconnector::reconnect() {
+  // keep other threads off the device during the sequence
+  const DeviceLock lock(device_handle_);
+  {
+    // the nodes must stay disabled once reconnection is disabled
+    boost::lock_guard< boost::mutex > state_lock(mutex_);
+    if (is_disabled_) {
+      return false;
+    }
+  }
+  device_handle_.transport->reopen();
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) { motor->reconnect(); }
+  // let the control thread access the motors again
+  BOOST_FOREACH (const boost::shared_ptr< Epos > &motor, motors_) {
+    motor->setReconnecting(false);
+  }
+  return true;
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,128 @@
+#include <map>
+
+#include <eposx_hardware/executor.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace eposx_hardware {
+
+//
+// DeviceExecutor
+//
+
+DeviceExecutor::DeviceExecutor()
+    : stopping_(false), thread_(boost::bind(&DeviceExecutor::run, this)) {}
+
+DeviceExecutor::~DeviceExecutor() {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+void DeviceExecutor::enqueue(const boost::function< void() > &task) {
+  {
+    boost::lock_guard< boost::mutex > lock(mutex_);
+    tasks_.push_back(task);
+  }
+  condition_.notify_one();
+}
+
+void DeviceExecutor::run() {
+  while (true) {
+    boost::function< void() > task;
+    {
+      boost::unique_lock< boost::mutex > lock(mutex_);
+      while (tasks_.empty() && !stopping_) {
+        condition_.wait(lock);
+      }
+      if (tasks_.empty()) {
+        return;
+      }
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+    // tasks never throw because exceptions are stored in their futures
+    task();
+  }
+}
+
+//
+// helper functions
+//
+
+boost::shared_ptr< DeviceExecutor > getDeviceExecutor(const DeviceHandle &device_handle) {
+  static boost::mutex mutex;
+  static std::map< const Transport *, boost::weak_ptr< DeviceExecutor > > existing_executors;
+
+  boost::lock_guard< boost::mutex > lock(mutex);
+  boost::weak_ptr< DeviceExecutor > &existing_executor(
+      existing_executors[device_handle.transport->getPortOwner()]);
+  boost::shared_ptr< DeviceExecutor > executor(existing_executor.lock());
+  if (!executor) {
+    executor.reset(new DeviceExecutor());
+    existing_executor = executor;
+  }
+  return executor;
+}
+
+// run the requests as a batch and complete each of them
+static void submitObjectsAndComplete(
+    const boost::shared_ptr< Transport > &transport, std::vector< ObjectRequest > requests,
+    const std::vector< boost::shared_ptr< boost::promise< void > > > &promises) {
+  // other threads may access the device without the executor
+  const boost::lock_guard< boost::recursive_mutex > lock(transport->getMutex());
+  transport->submitObjects(requests);
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    if (requests[i].error) {
+      promises[i]->set_exception(boost::copy_exception(*requests[i].error));
+    } else {
+      promises[i]->set_value();
+    }
+  }
+}
+
+// complete the requests with an error of the batch itself (i.e. a non-EposException)
+static void submitObjectsOrFail(
+    const boost::shared_ptr< Transport > &transport, const std::vector< ObjectRequest > &requests,
+    const std::vector< boost::shared_ptr< boost::promise< void > > > &promises) {
+  try {
+    submitObjectsAndComplete(transport, requests, promises);
+  } catch (...) {
+    BOOST_FOREACH (const boost::shared_ptr< boost::promise< void > > &promise, promises) {
+      try {
+        promise->set_exception(boost::current_exception());
+      } catch (const boost::promise_already_satisfied &) {
+        // completed before the error
+      }
+    }
+  }
+}
+
+std::vector< boost::shared_future< void > >
+submitObjectsAsync(const DeviceHandle &device_handle,
+                   const std::vector< ObjectRequest > &requests) {
+  std::vector< boost::shared_ptr< boost::promise< void > > > promises;
+  std::vector< boost::shared_future< void > > futures;
+  BOOST_FOREACH (const ObjectRequest &request, requests) {
+    promises.push_back(boost::make_shared< boost::promise< void > >());
+    futures.push_back(boost::shared_future< void >(promises.back()->get_future()));
+  }
+
+  // the task holds the transport so that the device is not closed until the batch completes
+  getDeviceExecutor(device_handle)
+      ->post< void >(
+          boost::bind(&submitObjectsOrFail, device_handle.transport, requests, promises));
+  return futures;
+}
+
+void waitAll(const std::vector< boost::shared_future< void > > &futures) {
+  BOOST_FOREACH (const boost::shared_future< void > &future, futures) { future.wait(); }
+  BOOST_FOREACH (const boost::shared_future< void > &future, futures) { future.get(); }
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,308 @@
+#include <cerrno>
+#include <cstring>
+
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/foreach.hpp>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace eposx_hardware {
+
+//
+// MaxonSerialFrame
+//
+
+MaxonSerialFrame::MaxonSerialFrame() : op_code(0) {}
+
+MaxonSerialFrame::MaxonSerialFrame(const unsigned char op_code) : op_code(op_code) {}
+
+void MaxonSerialFrame::addUint8(const boost::uint8_t value) { data.push_back(value); }
+
+void MaxonSerialFrame::addUint16(const boost::uint16_t value) {
+  data.push_back(value & 0xFF);
+  data.push_back((value >> 8) & 0xFF);
+}
+
+void MaxonSerialFrame::addUint32(const boost::uint32_t value) {
+  addUint16(value & 0xFFFF);
+  addUint16((value >> 16) & 0xFFFF);
+}
+
+void MaxonSerialFrame::addBytes(const void *bytes, const std::size_t length) {
+  const unsigned char *const begin(static_cast< const unsigned char * >(bytes));
+  data.insert(data.end(), begin, begin + length);
+}
+
+boost::uint32_t MaxonSerialFrame::getUint32(const std::size_t offset) const {
+  boost::uint32_t value(0);
+  for (std::size_t i = 0; i < 4 && offset + i < data.size(); ++i) {
+    value |= static_cast< boost::uint32_t >(data[offset + i]) << (8 * i);
+  }
+  return value;
+}
+
+//
+// encoding & decoding
+//
+
+static boost::uint16_t updateCrc(boost::uint16_t crc, const boost::uint16_t word) {
+  for (boost::uint16_t shifter = 0x8000; shifter != 0; shifter >>= 1) {
+    const bool carry((crc & 0x8000) != 0);
+    crc <<= 1;
+    if (word & shifter) {
+      ++crc;
+    }
+    if (carry) {
+      crc ^= 0x1021;
+    }
+  }
+  return crc;
+}
+
+// number of data words, padding an odd byte
+static std::size_t getNbOfWords(const MaxonSerialFrame &frame) {
+  return (frame.data.size() + 1) / 2;
+}
+
+boost::uint16_t calcMaxonSerialCrc(const MaxonSerialFrame &frame) {
+  const std::size_t num_words(getNbOfWords(frame));
+  boost::uint16_t crc(0);
+  crc = updateCrc(crc, (num_words << 8) | frame.op_code);
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const boost::uint16_t low(frame.data[2 * i]);
+    const boost::uint16_t high(2 * i + 1 < frame.data.size() ? frame.data[2 * i + 1] : 0);
+    crc = updateCrc(crc, (high << 8) | low);
+  }
+  return updateCrc(crc, 0x0000);
+}
+
+static void addStuffedByte(const unsigned char byte, std::vector< unsigned char > &bytes) {
+  bytes.push_back(byte);
+  if (byte == MAXON_SERIAL_DLE) {
+    bytes.push_back(byte);
+  }
+}
+
+void encodeMaxonSerialFrame(const MaxonSerialFrame &frame, std::vector< unsigned char > &bytes) {
+  const std::size_t num_words(getNbOfWords(frame));
+  if (num_words > 0xFF) {
+    throw EposException("encodeMaxonSerialFrame (Too long data)");
+  }
+  const boost::uint16_t crc(calcMaxonSerialCrc(frame));
+
+  bytes.push_back(MAXON_SERIAL_DLE);
+  bytes.push_back(MAXON_SERIAL_STX);
+  addStuffedByte(frame.op_code, bytes);
+  addStuffedByte(num_words, bytes);
+  for (std::size_t i = 0; i < 2 * num_words; ++i) {
+    addStuffedByte(i < frame.data.size() ? frame.data[i] : 0, bytes);
+  }
+  addStuffedByte(crc & 0xFF, bytes);
+  addStuffedByte((crc >> 8) & 0xFF, bytes);
+}
+
+MaxonSerialDecoder::MaxonSerialDecoder() : crc_errors_(0) { reset(); }
+
+bool MaxonSerialDecoder::feed(const unsigned char byte, MaxonSerialFrame &frame) {
+  switch (state_) {
+  case WAIT_DLE:
+    if (byte == MAXON_SERIAL_DLE) {
+      state_ = WAIT_STX;
+    }
+    return false;
+  case WAIT_STX:
+    if (byte == MAXON_SERIAL_STX) {
+      state_ = RECEIVE;
+      escaped_ = false;
+      buffer_.clear();
+    } else if (byte != MAXON_SERIAL_DLE) {
+      state_ = WAIT_DLE;
+    }
+    return false;
+  case RECEIVE:
+    break;
+  }
+
+  // unstuff. a single DLE followed by STX is the start of a new frame.
+  if (escaped_) {
+    escaped_ = false;
+    if (byte == MAXON_SERIAL_STX) {
+      buffer_.clear();
+      return false;
+    }
+    if (byte != MAXON_SERIAL_DLE) {
+      reset();
+      return false;
+    }
+  } else if (byte == MAXON_SERIAL_DLE) {
+    escaped_ = true;
+    return false;
+  }
+  buffer_.push_back(byte);
+
+  // op code, length, data words & CRC
+  if (buffer_.size() < 2 || buffer_.size() < 2 + 2 * static_cast< std::size_t >(buffer_[1]) + 2) {
+    return false;
+  }
+  MaxonSerialFrame received(buffer_[0]);
+  received.data.assign(buffer_.begin() + 2, buffer_.end() - 2);
+  const boost::uint16_t crc(buffer_[buffer_.size() - 2] | (buffer_[buffer_.size() - 1] << 8));
+  reset();
+  if (crc != calcMaxonSerialCrc(received)) {
+    ++crc_errors_;
+    return false;
+  }
+  frame = received;
+  return true;
+}
+
+void MaxonSerialDecoder::reset() {
+  state_ = WAIT_DLE;
+  escaped_ = false;
+  buffer_.clear();
+}
+
+unsigned int MaxonSerialDecoder::getNbOfCrcErrors() const { return crc_errors_; }
+
+//
+// SerialPort
+//
+
+std::vector< std::string > getSerialPortNames() {
+  // built-in serial ports (/dev/ttyS*) are excluded because most of them are not connected
+  static const char *const patterns[] = {"/dev/ttyUSB*", "/dev/ttyACM*"};
+  std::vector< std::string > port_names;
+  BOOST_FOREACH (const char *const pattern, patterns) {
+    glob_t result;
+    if (glob(pattern, 0, NULL, &result) == 0) {
+      port_names.insert(port_names.end(), result.gl_pathv, result.gl_pathv + result.gl_pathc);
+    }
+    globfree(&result);
+  }
+  return port_names;
+}
+
+static speed_t toSpeed(const unsigned int baudrate) {
+  switch (baudrate) {
+  case 9600:
+    return B9600;
+  case 19200:
+    return B19200;
+  case 38400:
+    return B38400;
+  case 57600:
+    return B57600;
+  case 115200:
+    return B115200;
+  case 230400:
+    return B230400;
+  case 460800:
+    return B460800;
+  case 921600:
+    return B921600;
+  case 1000000:
+    return B1000000;
+  }
+  throw EposException("setBaudrate (Unsupported baudrate)");
+}
+
+SerialPort::SerialPort(const std::string &port_name) : port_name_(port_name), fd_(-1) {
+  fd_ = open(port_name_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd_ < 0) {
+    throw EposException("open(" + port_name_ + ") (" + std::strerror(errno) + ")");
+  }
+
+  // raw 8N1 without flow control
+  termios tio;
+  if (tcgetattr(fd_, &tio) < 0) {
+    const std::string error(std::strerror(errno));
+    close(fd_);
+    throw EposException("tcgetattr(" + port_name_ + ") (" + error + ")");
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+  tio.c_cflag |= CS8 | CLOCAL | CREAD;
+  tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, B115200);
+  cfsetospeed(&tio, B115200);
+  if (tcsetattr(fd_, TCSANOW, &tio) < 0) {
+    const std::string error(std::strerror(errno));
+    close(fd_);
+    throw EposException("tcsetattr(" + port_name_ + ") (" + error + ")");
+  }
+}
+
+SerialPort::~SerialPort() { close(fd_); }
+
+const std::string &SerialPort::getPortName() const { return port_name_; }
+
+void SerialPort::setBaudrate(const unsigned int baudrate) {
+  termios tio;
+  if (tcgetattr(fd_, &tio) < 0) {
+    throw EposException("tcgetattr(" + port_name_ + ") (" + std::strerror(errno) + ")");
+  }
+  cfsetispeed(&tio, toSpeed(baudrate));
+  cfsetospeed(&tio, toSpeed(baudrate));
+  if (tcsetattr(fd_, TCSANOW, &tio) < 0) {
+    throw EposException("tcsetattr(" + port_name_ + ") (" + std::strerror(errno) + ")");
+  }
+}
+
+void SerialPort::flush() { tcflush(fd_, TCIFLUSH); }
+
+void SerialPort::write(const std::vector< unsigned char > &bytes) {
+  std::size_t offset(0);
+  while (offset < bytes.size()) {
+    const ssize_t result(::write(fd_, &bytes[offset], bytes.size() - offset));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        // wait until the output buffer has space
+        pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, 100);
+        continue;
+      }
+      throw EposException("write(" + port_name_ + ") (" + std::strerror(errno) + ")");
+    }
+    offset += result;
+  }
+}
+
+std::size_t SerialPort::read(unsigned char *bytes, const std::size_t length,
+                             const unsigned int timeout) {
+  pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+  const int result(poll(&pfd, 1, timeout));
+  if (result < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    throw EposException("poll(" + port_name_ + ") (" + std::strerror(errno) + ")");
+  }
+  if (result == 0) {
+    return 0;
+  }
+  const ssize_t size(::read(fd_, bytes, length));
+  if (size < 0) {
+    if (errno == EAGAIN || errno == EINTR) {
+      return 0;
+    }
+    throw EposException("read(" + port_name_ + ") (" + std::strerror(errno) + ")");
+  }
+  return size;
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,438 @@
+#include <ios>
+#include <sstream>
+
+#include <eposx_hardware/native_transport.h>
+#include <eposx_hardware/object_dictionary.h>
+
+#include <ros/time.h>
+
+namespace eposx_hardware {
+
+static std::string toHexString(const unsigned int value) {
+  std::ostringstream oss;
+  oss << "0x" << std::hex << value;
+  return oss.str();
+}
+
+//
+// NativeTransport
+//
+
+NativeTransport::NativeTransport(const DeviceInfo &device_info)
+    : device_info_(device_info), baudrate_(0), timeout_(500) {}
+
+NativeTransport::~NativeTransport() {}
+
+//
+// device information & protocol stack settings
+//
+
+std::string NativeTransport::getDeviceName() { return device_info_.device_name; }
+
+std::string NativeTransport::getProtocolStackName() { return device_info_.protocol_stack_name; }
+
+std::string NativeTransport::getInterfaceName() { return device_info_.interface_name; }
+
+std::string NativeTransport::getPortName() { return device_info_.port_name; }
+
+void NativeTransport::getProtocolStackSettings(unsigned int &baudrate, unsigned int &timeout) {
+  baudrate = baudrate_;
+  timeout = timeout_;
+}
+
+void NativeTransport::setProtocolStackSettings(const unsigned int baudrate,
+                                               const unsigned int timeout) {
+  baudrate_ = baudrate;
+  timeout_ = timeout;
+}
+
+void NativeTransport::setGatewaySettings(const unsigned int /* baudrate */) {
+  throw EposException("SetGatewaySettings (Native transports do not have a gateway)");
+}
+
+unsigned int NativeTransport::getTimeout() const { return timeout_; }
+
+//
+// identity
+//
+
+void NativeTransport::getVersion(const unsigned short node_id, unsigned short &hardware_version,
+                                 unsigned short &software_version,
+                                 unsigned short &application_number,
+                                 unsigned short &application_version) {
+  // the order of subindices differs between device generations
+  if (device_info_.device_name == "EPOS4") {
+    hardware_version = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x01);
+    software_version = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x02);
+  } else {
+    software_version = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x01);
+    hardware_version = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x02);
+  }
+  application_number = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x03);
+  application_version = getObjectAs< boost::uint16_t >(node_id, 0x2003, 0x04);
+}
+
+//
+// state machine
+//
+
+void NativeTransport::changeState(const unsigned short node_id, const boost::uint16_t controlword,
+                                  const boost::uint16_t state_mask, const boost::uint16_t state,
+                                  const std::string &func_name) {
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, controlword);
+
+  // poll statusword (each poll takes a round trip to the node)
+  const ros::WallTime deadline(ros::WallTime::now() + ros::WallDuration(timeout_ / 1000.));
+  while (true) {
+    const boost::uint16_t statusword(getObjectAs< boost::uint16_t >(node_id, 0x6041, 0x00));
+    if ((statusword & state_mask) == state) {
+      return;
+    }
+    if ((statusword & SW_FAULT_BIT) && !(controlword & CW_FAULT_RESET)) {
+      throw EposException(func_name + " (Fault in statusword " + toHexString(statusword) + ")");
+    }
+    if (ros::WallTime::now() > deadline) {
+      throw EposException(func_name + " (Timeout in state transition, statusword " +
+                          toHexString(statusword) + ")");
+    }
+  }
+}
+
+void NativeTransport::setEnableState(const unsigned short node_id) {
+  // walk through the state machine up to operation enabled
+  for (int step = 0; step < 4; ++step) {
+    const boost::uint16_t statusword(getObjectAs< boost::uint16_t >(node_id, 0x6041, 0x00));
+    if ((statusword & SW_MASK) == SW_OPERATION_ENABLED) {
+      return;
+    } else if ((statusword & SW_MASK_DISABLED) == SW_SWITCH_ON_DISABLED) {
+      changeState(node_id, CW_SHUTDOWN, SW_MASK, SW_READY_TO_SWITCH_ON, "SetEnableState");
+    } else if ((statusword & SW_MASK) == SW_READY_TO_SWITCH_ON) {
+      changeState(node_id, CW_SWITCH_ON, SW_MASK, SW_SWITCHED_ON, "SetEnableState");
+    } else if ((statusword & SW_MASK) == SW_SWITCHED_ON) {
+      changeState(node_id, CW_ENABLE_OPERATION, SW_MASK, SW_OPERATION_ENABLED, "SetEnableState");
+    } else if ((statusword & SW_MASK) == SW_QUICK_STOP_ACTIVE) {
+      changeState(node_id, CW_DISABLE_VOLTAGE, SW_MASK_DISABLED, SW_SWITCH_ON_DISABLED,
+                  "SetEnableState");
+    } else {
+      throw EposException("SetEnableState (Unexpected statusword " + toHexString(statusword) +
+                          ")");
+    }
+  }
+  throw EposException("SetEnableState (Could not reach operation enabled)");
+}
+
+void NativeTransport::setDisableState(const unsigned short node_id) {
+  const boost::uint16_t statusword(getObjectAs< boost::uint16_t >(node_id, 0x6041, 0x00));
+  if ((statusword & SW_MASK) == SW_OPERATION_ENABLED || (statusword & SW_MASK) == SW_SWITCHED_ON) {
+    changeState(node_id, CW_SHUTDOWN, SW_MASK, SW_READY_TO_SWITCH_ON, "SetDisableState");
+  } else if ((statusword & SW_MASK) == SW_QUICK_STOP_ACTIVE) {
+    changeState(node_id, CW_DISABLE_VOLTAGE, SW_MASK_DISABLED, SW_SWITCH_ON_DISABLED,
+                "SetDisableState");
+  }
+  // the node is already disabled or in fault
+}
+
+void NativeTransport::setQuickStopState(const unsigned short node_id) {
+  // do not wait the state transition to stop other nodes as soon as possible
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, CW_QUICK_STOP);
+}
+
+void NativeTransport::clearFault(const unsigned short node_id) {
+  const boost::uint16_t statusword(getObjectAs< boost::uint16_t >(node_id, 0x6041, 0x00));
+  if (statusword & SW_FAULT_BIT) {
+    // fault reset on the rising edge of bit 7
+    setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, CW_DISABLE_VOLTAGE);
+    changeState(node_id, CW_FAULT_RESET, SW_MASK_DISABLED, SW_SWITCH_ON_DISABLED, "ClearFault");
+  }
+  // delete the error history
+  setObjectAs< boost::uint8_t >(node_id, 0x1003, 0x00, 0);
+}
+
+//
+// error history
+//
+
+unsigned char NativeTransport::getNbOfDeviceError(const unsigned short node_id) {
+  return getObjectAs< boost::uint8_t >(node_id, 0x1003, 0x00);
+}
+
+unsigned int NativeTransport::getDeviceErrorCode(const unsigned short node_id,
+                                                 const unsigned char error_number) {
+  return getObjectAs< boost::uint32_t >(node_id, 0x1003, error_number);
+}
+
+//
+// configuration
+//
+
+void NativeTransport::requireEpos4(const std::string &func_name) const {
+  if (device_info_.device_name != "EPOS4") {
+    throw EposException(func_name + " (Unsupported by the native transport on " +
+                        device_info_.device_name + ")");
+  }
+}
+
+void NativeTransport::setMotorType(const unsigned short node_id, const unsigned short type) {
+  setObjectAs< boost::uint16_t >(node_id, 0x6402, 0x00, type);
+}
+
+void NativeTransport::setDcMotorParameter(const unsigned short node_id,
+                                          const unsigned short nominal_current,
+                                          const unsigned short max_output_current,
+                                          const unsigned short thermal_time_constant) {
+  requireEpos4("SetDcMotorParameter");
+  setObjectAs< boost::uint32_t >(node_id, 0x3001, 0x01, nominal_current);
+  setObjectAs< boost::uint32_t >(node_id, 0x3001, 0x02, max_output_current);
+  setObjectAs< boost::uint16_t >(node_id, 0x3001, 0x04, thermal_time_constant);
+}
+
+void NativeTransport::setEcMotorParameter(const unsigned short node_id,
+                                          const unsigned short nominal_current,
+                                          const unsigned short max_output_current,
+                                          const unsigned short thermal_time_constant,
+                                          const unsigned char number_of_pole_pairs) {
+  requireEpos4("SetEcMotorParameter");
+  setObjectAs< boost::uint32_t >(node_id, 0x3001, 0x01, nominal_current);
+  setObjectAs< boost::uint32_t >(node_id, 0x3001, 0x02, max_output_current);
+  setObjectAs< boost::uint8_t >(node_id, 0x3001, 0x03, number_of_pole_pairs);
+  setObjectAs< boost::uint16_t >(node_id, 0x3001, 0x04, thermal_time_constant);
+}
+
+void NativeTransport::setSensorType(const unsigned short node_id, const unsigned short type) {
+  // only incremental encoders (1: 3-channel with index, 2: 2-channel without index)
+  // on the digital incremental encoder 1 of the axis configuration
+  requireEpos4("SetSensorType");
+  if (type != 1 && type != 2) {
+    throw EposException("SetSensorType (Unsupported by the native transport (type " +
+                        toHexString(type) + "))");
+  }
+  // bit 0 of the encoder type tells no index channel. other bits are kept.
+  const boost::uint16_t encoder_type(getObjectAs< boost::uint16_t >(node_id, 0x3010, 0x02));
+  setObjectAs< boost::uint16_t >(node_id, 0x3010, 0x02,
+                                 type == 2 ? (encoder_type | 0x0001) : (encoder_type & ~0x0001));
+}
+
+void NativeTransport::setIncEncoderParameter(const unsigned short node_id,
+                                             const unsigned int resolution,
+                                             const bool inverted_polarity) {
+  requireEpos4("SetIncEncoderParameter");
+  if (inverted_polarity) {
+    throw EposException(
+        "SetIncEncoderParameter (Inverted polarity is unsupported by the native transport)");
+  }
+  setObjectAs< boost::uint32_t >(node_id, 0x3010, 0x01, resolution);
+}
+
+void NativeTransport::setSsiAbsEncoderParameter(const unsigned short, const unsigned short,
+                                                const unsigned short, const unsigned short,
+                                                const bool) {
+  throw EposException("SetSsiAbsEncoderParameter (Unsupported by the native transport)");
+}
+
+void NativeTransport::setMaxFollowingError(const unsigned short node_id,
+                                           const unsigned int error) {
+  setObjectAs< boost::uint32_t >(node_id, 0x6065, 0x00, error);
+}
+
+void NativeTransport::setMaxProfileVelocity(const unsigned short node_id,
+                                            const unsigned int velocity) {
+  setObjectAs< boost::uint32_t >(node_id, 0x607F, 0x00, velocity);
+}
+
+void NativeTransport::setMaxAcceleration(const unsigned short node_id,
+                                         const unsigned int acceleration) {
+  setObjectAs< boost::uint32_t >(node_id, 0x60C5, 0x00, acceleration);
+}
+
+void NativeTransport::setPositionRegulatorGain(const unsigned short node_id,
+                                               const unsigned short p, const unsigned short i,
+                                               const unsigned short d) {
+  requireEpos4("SetPositionRegulatorGain");
+  setObjectAs< boost::uint32_t >(node_id, 0x30A1, 0x01, p);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A1, 0x02, i);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A1, 0x03, d);
+}
+
+void NativeTransport::setPositionRegulatorFeedForward(const unsigned short node_id,
+                                                      const unsigned short velocity,
+                                                      const unsigned short acceleration) {
+  requireEpos4("SetPositionRegulatorFeedForward");
+  setObjectAs< boost::uint32_t >(node_id, 0x30A1, 0x04, velocity);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A1, 0x05, acceleration);
+}
+
+void NativeTransport::setVelocityRegulatorGain(const unsigned short node_id,
+                                               const unsigned short p, const unsigned short i) {
+  requireEpos4("SetVelocityRegulatorGain");
+  setObjectAs< boost::uint32_t >(node_id, 0x30A2, 0x01, p);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A2, 0x02, i);
+}
+
+void NativeTransport::setVelocityRegulatorFeedForward(const unsigned short node_id,
+                                                      const unsigned short velocity,
+                                                      const unsigned short acceleration) {
+  requireEpos4("SetVelocityRegulatorFeedForward");
+  setObjectAs< boost::uint32_t >(node_id, 0x30A2, 0x03, velocity);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A2, 0x04, acceleration);
+}
+
+void NativeTransport::setCurrentRegulatorGain(const unsigned short node_id,
+                                              const unsigned short p, const unsigned short i) {
+  requireEpos4("SetCurrentRegulatorGain");
+  setObjectAs< boost::uint32_t >(node_id, 0x30A0, 0x01, p);
+  setObjectAs< boost::uint32_t >(node_id, 0x30A0, 0x02, i);
+}
+
+void NativeTransport::setPositionProfile(const unsigned short node_id,
+                                         const unsigned int velocity,
+                                         const unsigned int acceleration,
+                                         const unsigned int deceleration) {
+  setObjectAs< boost::uint32_t >(node_id, 0x6081, 0x00, velocity);
+  setObjectAs< boost::uint32_t >(node_id, 0x6083, 0x00, acceleration);
+  setObjectAs< boost::uint32_t >(node_id, 0x6084, 0x00, deceleration);
+}
+
+void NativeTransport::enablePositionWindow(const unsigned short node_id,
+                                           const unsigned int window, const unsigned short time) {
+  setObjectAs< boost::uint32_t >(node_id, 0x6067, 0x00, window);
+  setObjectAs< boost::uint16_t >(node_id, 0x6068, 0x00, time);
+}
+
+void NativeTransport::setVelocityProfile(const unsigned short node_id,
+                                         const unsigned int acceleration,
+                                         const unsigned int deceleration) {
+  setObjectAs< boost::uint32_t >(node_id, 0x6083, 0x00, acceleration);
+  setObjectAs< boost::uint32_t >(node_id, 0x6084, 0x00, deceleration);
+}
+
+void NativeTransport::enableVelocityWindow(const unsigned short node_id,
+                                           const unsigned int window, const unsigned short time) {
+  setObjectAs< boost::uint16_t >(node_id, 0x606D, 0x00, window);
+  setObjectAs< boost::uint16_t >(node_id, 0x606E, 0x00, time);
+}
+
+//
+// operation modes & motion
+//
+
+void NativeTransport::setOperationMode(const unsigned short node_id, const char mode) {
+  setObjectAs< boost::int8_t >(node_id, 0x6060, 0x00, mode);
+}
+
+void NativeTransport::activateProfilePositionMode(const unsigned short node_id) {
+  setOperationMode(node_id, MODE_PROFILE_POSITION);
+}
+
+void NativeTransport::moveToPosition(const unsigned short node_id, const long position,
+                                     const bool absolute, const bool immediately) {
+  setObjectAs< boost::int32_t >(node_id, 0x607A, 0x00, position);
+  // a new setpoint is accepted on the rising edge of bit 4
+  const boost::uint16_t controlword(CW_ENABLE_OPERATION |
+                                    (immediately ? CW_CHANGE_SET_IMMEDIATELY : 0) |
+                                    (absolute ? 0 : CW_RELATIVE));
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, controlword);
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, controlword | CW_NEW_SETPOINT);
+}
+
+void NativeTransport::activateProfileVelocityMode(const unsigned short node_id) {
+  setOperationMode(node_id, MODE_PROFILE_VELOCITY);
+}
+
+void NativeTransport::moveWithVelocity(const unsigned short node_id, const long velocity) {
+  setObjectAs< boost::int32_t >(node_id, 0x60FF, 0x00, velocity);
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, CW_ENABLE_OPERATION);
+}
+
+void NativeTransport::haltVelocityMovement(const unsigned short node_id) {
+  setObjectAs< boost::uint16_t >(node_id, 0x6040, 0x00, CW_ENABLE_OPERATION | CW_HALT);
+}
+
+void NativeTransport::activateCurrentMode(const unsigned short node_id) {
+  setOperationMode(node_id, MODE_CURRENT);
+}
+
+void NativeTransport::setCurrentMust(const unsigned short node_id, const short current) {
+  setObjectAs< boost::int16_t >(node_id, 0x2030, 0x00, current);
+}
+
+//
+// position marker
+//
+
+void NativeTransport::setPositionMarkerParameter(const unsigned short /* node_id */,
+                                                 const unsigned char /* edge_type */,
+                                                 const unsigned char /* mode */) {
+  // EPOS4 offers touch probes instead of position markers
+  throw EposException("SetPositionMarkerParameter (Unsupported by the native transport)");
+}
+
+void NativeTransport::activatePositionMarker(const unsigned short /* node_id */,
+                                             const unsigned short /* digital_input_number */,
+                                             const int /* polarity */) {
+  throw EposException("ActivatePositionMarker (Unsupported by the native transport)");
+}
+
+unsigned short NativeTransport::readPositionMarkerCounter(const unsigned short /* node_id */) {
+  throw EposException("ReadPositionMarkerCounter (Unsupported by the native transport)");
+}
+
+int NativeTransport::readPositionMarkerCapturedPosition(
+    const unsigned short /* node_id */, const unsigned short /* counter_index */) {
+  throw EposException("ReadPositionMarkerCapturedPosition (Unsupported by the native transport)");
+}
+
+//
+// position compare
+//
+
+void NativeTransport::setPositionCompareParameter(const unsigned short /* node_id */,
+                                                  const unsigned char /* operational_mode */,
+                                                  const unsigned char /* interval_mode */,
+                                                  const unsigned char /* direction_dependency */,
+                                                  const unsigned short /* interval_width */,
+                                                  const unsigned short /* interval_repetitions */,
+                                                  const unsigned short /* pulse_width */) {
+  // position compare is an EPOS2 feature
+  throw EposException("SetPositionCompareParameter (Unsupported by the native transport)");
+}
+
+void NativeTransport::activatePositionCompare(const unsigned short /* node_id */,
+                                              const unsigned short /* digital_output_number */,
+                                              const int /* polarity */) {
+  throw EposException("ActivatePositionCompare (Unsupported by the native transport)");
+}
+
+void NativeTransport::enablePositionCompare(const unsigned short /* node_id */) {
+  throw EposException("EnablePositionCompare (Unsupported by the native transport)");
+}
+
+void NativeTransport::disablePositionCompare(const unsigned short /* node_id */) {
+  throw EposException("DisablePositionCompare (Unsupported by the native transport)");
+}
+
+void NativeTransport::setPositionCompareReferencePosition(const unsigned short /* node_id */,
+                                                          const int /* reference_position */) {
+  throw EposException("SetPositionCompareReferencePosition (Unsupported by the native transport)");
+}
+
+//
+// actual values
+//
+
+int NativeTransport::getPositionIs(const unsigned short node_id) {
+  return getObjectAs< boost::int32_t >(node_id, 0x6064, 0x00);
+}
+
+int NativeTransport::getVelocityIs(const unsigned short node_id) {
+  return getObjectAs< boost::int32_t >(node_id, 0x606C, 0x00);
+}
+
+short NativeTransport::getCurrentIs(const unsigned short node_id) {
+  if (device_info_.device_name == "EPOS4") {
+    // EPOS4 has the current actual value in INT32
+    return getObjectAs< boost::int32_t >(node_id, 0x30D1, 0x02);
+  }
+  return getObjectAs< boost::int16_t >(node_id, 0x6078, 0x00);
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,97 @@
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <eposx_hardware/object_dictionary.h>
+
+namespace eposx_hardware {
+
+unsigned int toDeviceFamily(const std::string &device_name) {
+  if (device_name == "EPOS") {
+    return DEVICE_EPOS;
+  } else if (device_name == "EPOS2") {
+    return DEVICE_EPOS2;
+  } else if (device_name == "EPOS4") {
+    return DEVICE_EPOS4;
+  }
+  return 0;
+}
+
+void checkObjectAvailable(const NodeHandle &node_handle, const unsigned short index,
+                          const unsigned char subindex, const unsigned int families) {
+  // skip asking the device name if the object is common in all devices
+  if (families == DEVICE_ALL) {
+    return;
+  }
+  const std::string device_name(getDeviceName(node_handle));
+  if ((toDeviceFamily(device_name) & families) == 0) {
+    std::ostringstream what;
+    what << "Object 0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(4)
+         << index << "/" << std::setw(2) << static_cast< unsigned int >(subindex)
+         << " is not available on " << device_name;
+    throw EposException(what.str());
+  }
+}
+
+//
+// CiA-402 state machine & modes
+//
+
+void setEnableStateDirectly(const NodeHandle &node_handle) {
+  namespace od = objects;
+  const unsigned short node_id(node_handle.node_id);
+  const od::Statusword::Type statusword(readObject< od::Statusword >(node_handle));
+  std::vector< ObjectRequest > requests;
+  if ((statusword & SW_MASK) == SW_OPERATION_ENABLED) {
+    return;
+  } else if ((statusword & SW_MASK_DISABLED) == SW_SWITCH_ON_DISABLED) {
+    requests.push_back(makeWriteRequest< od::Controlword >(node_id, CW_SHUTDOWN));
+    // switch on & enable operation at once
+    requests.push_back(makeWriteRequest< od::Controlword >(node_id, CW_ENABLE_OPERATION));
+  } else if ((statusword & SW_MASK) == SW_READY_TO_SWITCH_ON ||
+             (statusword & SW_MASK) == SW_SWITCHED_ON) {
+    requests.push_back(makeWriteRequest< od::Controlword >(node_id, CW_ENABLE_OPERATION));
+  } else {
+    // fault or quick stop active
+    node_handle.transport->setEnableState(node_id);
+    return;
+  }
+
+  od::Statusword::Type new_statusword(0);
+  requests.push_back(makeReadRequest< od::Statusword >(node_id, new_statusword));
+  node_handle.transport->submitObjects(requests);
+  throwIfFailed(requests);
+  // the node may take a while for the transitions
+  if ((new_statusword & SW_MASK) != SW_OPERATION_ENABLED) {
+    node_handle.transport->setEnableState(node_id);
+  }
+}
+
+void setDisableStateDirectly(const NodeHandle &node_handle) {
+  // ignored in fault where the node is disabled already
+  writeObject< objects::Controlword >(node_handle, CW_DISABLE_VOLTAGE);
+}
+
+void setOperationModeDirectly(const NodeHandle &node_handle, const boost::int8_t mode) {
+  namespace od = objects;
+  const unsigned short node_id(node_handle.node_id);
+  od::ModesOfOperationDisplay::Type mode_display(0);
+  std::vector< ObjectRequest > requests;
+  requests.push_back(makeWriteRequest< od::ModesOfOperation >(node_id, mode));
+  requests.push_back(makeReadRequest< od::ModesOfOperationDisplay >(node_id, mode_display));
+  node_handle.transport->submitObjects(requests);
+  throwIfFailed(requests);
+
+  // poll the display only if the node has not switched yet
+  for (int retry = 0; mode_display != mode; ++retry) {
+    if (retry >= 10) {
+      std::ostringstream what;
+      what << "SetOperationMode (Node " << node_id << " did not switch to mode "
+           << static_cast< int >(mode) << ")";
+      throw EposException(what.str());
+    }
+    mode_display = readObject< od::ModesOfOperationDisplay >(node_handle);
+  }
+}
+
+} // namespace eposx_hardware
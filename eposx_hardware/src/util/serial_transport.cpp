@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstring>
+
+#include <eposx_hardware/serial_transport.h>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include <ros/time.h>
+
+namespace eposx_hardware {
+
+// error code on timeout, which is same as the EPOS Command Library
+#define SERIAL_ERROR_TIMEOUT 0x05040000
+
+// max data bytes in a segment
+#define SERIAL_MAX_SEGMENT_LENGTH 63
+
+static MaxonSerialFrame makeObjectFrame(const unsigned char op_code, const unsigned short node_id,
+                                        const unsigned short index,
+                                        const unsigned char subindex) {
+  MaxonSerialFrame frame(op_code);
+  frame.addUint8(node_id);
+  frame.addUint16(index);
+  frame.addUint8(subindex);
+  return frame;
+}
+
+static std::string withNodeId(const std::string &func_name, const unsigned short node_id) {
+  return func_name + " (node " + boost::lexical_cast< std::string >(node_id) + ")";
+}
+
+//
+// SerialTransport
+//
+
+SerialTransport::SerialTransport(const DeviceInfo &device_info)
+    : NativeTransport(device_info), port_(new SerialPort(device_info.port_name)),
+      pipeline_depth_(1) {
+  if (device_info.protocol_stack_name != "MAXON SERIAL V2") {
+    throw EposException("OpenDevice (NativeSerial supports only MAXON SERIAL V2, not " +
+                        device_info.protocol_stack_name + ")");
+  }
+  // initial baudrate of SerialPort
+  NativeTransport::setProtocolStackSettings(115200, getTimeout());
+}
+
+SerialTransport::~SerialTransport() {}
+
+void SerialTransport::reopen() {
+  // the old port is kept if the new one cannot be opened
+  port_.reset(new SerialPort(port_->getPortName()));
+  unsigned int baudrate, timeout;
+  NativeTransport::getProtocolStackSettings(baudrate, timeout);
+  if (baudrate != 0) {
+    port_->setBaudrate(baudrate);
+  }
+  unread_bytes_.clear();
+  decoder_.reset();
+}
+
+void SerialTransport::setProtocolStackSettings(const unsigned int baudrate,
+                                               const unsigned int timeout) {
+  // 0 means the initial baudrate of the tty device
+  if (baudrate != 0) {
+    port_->setBaudrate(baudrate);
+  }
+  NativeTransport::setProtocolStackSettings(baudrate, timeout);
+}
+
+unsigned int SerialTransport::getPipelineDepth() const { return pipeline_depth_; }
+
+void SerialTransport::setPipelineDepth(const unsigned int depth) {
+  pipeline_depth_ = std::max(depth, 1u);
+}
+
+//
+// object dictionary
+//
+
+void SerialTransport::getObject(const unsigned short node_id, const unsigned short index,
+                                const unsigned char subindex, void *data,
+                                const unsigned int length) {
+  unsigned char *const bytes(static_cast< unsigned char * >(data));
+  std::memset(bytes, 0, length);
+
+  // expedited transfer for small data
+  if (length <= 4) {
+    const MaxonSerialFrame response(request(
+        node_id, makeObjectFrame(MAXON_SERIAL_READ_OBJECT, node_id, index, subindex),
+        "GetObject"));
+    const boost::uint32_t value(response.getUint32(4));
+    std::memcpy(bytes, &value, length);
+    return;
+  }
+
+  // segmented transfer for large data
+  request(node_id, makeObjectFrame(MAXON_SERIAL_INIT_SEGMENT_READ, node_id, index, subindex),
+          "GetObject");
+  unsigned int offset(0);
+  unsigned char toggle(0);
+  while (true) {
+    MaxonSerialFrame segment_request(MAXON_SERIAL_SEGMENT_READ);
+    segment_request.addUint8(node_id);
+    segment_request.addUint8(toggle);
+    const MaxonSerialFrame response(request(node_id, segment_request, "GetObject"));
+    const unsigned char control(response.data.size() > 4 ? response.data[4] : 0);
+    if ((control & MAXON_SERIAL_SEGMENT_TOGGLE) != toggle) {
+      throw EposException(withNodeId("GetObject", node_id) + " (Unexpected segment)");
+    }
+    const unsigned int size(std::min< unsigned int >(control & MAXON_SERIAL_SEGMENT_LENGTH_MASK,
+                                                     response.data.size() - 5));
+    if (offset < length) {
+      std::memcpy(bytes + offset, &response.data[5], std::min(size, length - offset));
+    }
+    offset += size;
+    if (control & MAXON_SERIAL_SEGMENT_LAST) {
+      return;
+    }
+    toggle ^= MAXON_SERIAL_SEGMENT_TOGGLE;
+  }
+}
+
+void SerialTransport::setObject(const unsigned short node_id, const unsigned short index,
+                                const unsigned char subindex, const void *data,
+                                const unsigned int length) {
+  const unsigned char *const bytes(static_cast< const unsigned char * >(data));
+
+  // expedited transfer for small data
+  if (length <= 4) {
+    MaxonSerialFrame write_request(
+        makeObjectFrame(MAXON_SERIAL_WRITE_OBJECT, node_id, index, subindex));
+    write_request.addBytes(bytes, length);
+    write_request.data.resize(8, 0);
+    request(node_id, write_request, "SetObject");
+    return;
+  }
+
+  // segmented transfer for large data
+  MaxonSerialFrame init_request(
+      makeObjectFrame(MAXON_SERIAL_INIT_SEGMENT_WRITE, node_id, index, subindex));
+  init_request.addUint32(length);
+  request(node_id, init_request, "SetObject");
+  unsigned char toggle(0);
+  for (unsigned int offset = 0; offset < length; offset += SERIAL_MAX_SEGMENT_LENGTH) {
+    const unsigned int size(std::min< unsigned int >(length - offset, SERIAL_MAX_SEGMENT_LENGTH));
+    const bool last(offset + size >= length);
+    MaxonSerialFrame segment_request(MAXON_SERIAL_SEGMENT_WRITE);
+    segment_request.addUint8(node_id);
+    segment_request.addUint8(toggle | (last ? MAXON_SERIAL_SEGMENT_LAST : 0) | size);
+    segment_request.addBytes(bytes + offset, size);
+    const MaxonSerialFrame response(request(node_id, segment_request, "SetObject"));
+    if (response.data.size() < 5 || (response.data[4] & MAXON_SERIAL_SEGMENT_TOGGLE) != toggle) {
+      throw EposException(withNodeId("SetObject", node_id) + " (Unexpected segment)");
+    }
+    toggle ^= MAXON_SERIAL_SEGMENT_TOGGLE;
+  }
+}
+
+void SerialTransport::submitObjects(std::vector< ObjectRequest > &requests) {
+  std::size_t begin(0);
+  while (begin < requests.size()) {
+    // large objects need segmented transfer which cannot be pipelined
+    if (requests[begin].length > 4) {
+      std::vector< ObjectRequest > single(1, requests[begin]);
+      Transport::submitObjects(single);
+      requests[begin] = single.front();
+      ++begin;
+      continue;
+    }
+
+    // pipeline a run of small objects
+    std::size_t end(begin);
+    std::vector< MaxonSerialFrame > frames;
+    for (; end < requests.size() && requests[end].length <= 4; ++end) {
+      const ObjectRequest &object_request(requests[end]);
+      if (object_request.is_write) {
+        MaxonSerialFrame frame(makeObjectFrame(MAXON_SERIAL_WRITE_OBJECT, object_request.node_id,
+                                               object_request.index, object_request.subindex));
+        frame.addBytes(object_request.getWriteData(), object_request.length);
+        frame.data.resize(8, 0);
+        frames.push_back(frame);
+      } else {
+        frames.push_back(makeObjectFrame(MAXON_SERIAL_READ_OBJECT, object_request.node_id,
+                                         object_request.index, object_request.subindex));
+      }
+    }
+    std::vector< MaxonSerialFrame > responses;
+    try {
+      transact(frames, responses, "SubmitObjects");
+    } catch (const EposException &error) {
+      // the rest of the run has no responses
+      for (std::size_t i = begin + responses.size(); i < end; ++i) {
+        requests[i].error = boost::make_shared< EposException >(error);
+      }
+    }
+    for (std::size_t i = 0; i < responses.size(); ++i) {
+      ObjectRequest &object_request(requests[begin + i]);
+      const boost::uint32_t error_code(responses[i].getUint32(0));
+      if (error_code != 0) {
+        object_request.error = boost::make_shared< EposException >(
+            withNodeId(object_request.is_write ? "SetObject" : "GetObject", object_request.node_id),
+            error_code);
+        continue;
+      }
+      object_request.error.reset();
+      if (!object_request.is_write) {
+        const boost::uint32_t value(responses[i].getUint32(4));
+        std::memcpy(object_request.data, &value, object_request.length);
+      }
+    }
+    begin = end;
+  }
+}
+
+//
+// MAXON SERIAL V2 transactions
+//
+
+MaxonSerialFrame SerialTransport::request(const unsigned short node_id,
+                                          const MaxonSerialFrame &request,
+                                          const std::string &func_name) {
+  std::vector< MaxonSerialFrame > responses;
+  transact(std::vector< MaxonSerialFrame >(1, request), responses, withNodeId(func_name, node_id));
+  const MaxonSerialFrame &response(responses.front());
+  const boost::uint32_t error_code(response.getUint32(0));
+  if (error_code != 0) {
+    throw EposException(withNodeId(func_name, node_id), error_code);
+  }
+  return response;
+}
+
+void SerialTransport::transact(const std::vector< MaxonSerialFrame > &requests,
+                               std::vector< MaxonSerialFrame > &responses,
+                               const std::string &func_name) {
+  // forget stale bytes (e.g. a response of a timed-out request)
+  port_->flush();
+  unread_bytes_.clear();
+  decoder_.reset();
+
+  // keep up to the pipeline depth of requests in flight.
+  // the device handles requests in order so that responses can be matched by order.
+  responses.clear();
+  std::size_t num_sent(0);
+  while (responses.size() < requests.size()) {
+    std::vector< unsigned char > bytes;
+    while (num_sent < requests.size() && num_sent - responses.size() < pipeline_depth_) {
+      encodeMaxonSerialFrame(requests[num_sent], bytes);
+      ++num_sent;
+    }
+    if (!bytes.empty()) {
+      port_->write(bytes);
+    }
+    responses.push_back(receive(func_name));
+  }
+}
+
+MaxonSerialFrame SerialTransport::receive(const std::string &func_name) {
+  const ros::WallTime deadline(ros::WallTime::now() + ros::WallDuration(getTimeout() / 1000.));
+  while (true) {
+    // decode bytes received together with the previous response first
+    while (!unread_bytes_.empty()) {
+      const unsigned char byte(unread_bytes_.front());
+      unread_bytes_.pop_front();
+      MaxonSerialFrame frame;
+      if (decoder_.feed(byte, frame) && frame.op_code == MAXON_SERIAL_RESPONSE) {
+        return frame;
+      }
+    }
+
+    const ros::WallDuration remaining(deadline - ros::WallTime::now());
+    const unsigned int remaining_ms(
+        remaining > ros::WallDuration(0.) ? static_cast< unsigned int >(remaining.toSec() * 1000.)
+                                          : 0);
+    unsigned char bytes[256];
+    const std::size_t size(port_->read(bytes, sizeof(bytes), remaining_ms));
+    if (size == 0 && remaining_ms == 0) {
+      throw EposException(func_name, SERIAL_ERROR_TIMEOUT);
+    }
+    unread_bytes_.insert(unread_bytes_.end(), bytes, bytes + size);
+  }
+}
+
+//
+// CAN layer
+//
+
+void SerialTransport::sendCanFrame(const unsigned short /* cob_id */,
+                                   const unsigned short /* length */, const void * /* data */) {
+  throw EposException("SendCANFrame (Not supported on NativeSerial)");
+}
+
+void SerialTransport::readCanFrame(const unsigned short /* cob_id */,
+                                   const unsigned short /* length */, void * /* data */,
+                                   const unsigned int /* timeout */) {
+  throw EposException("ReadCANFrame (Not supported on NativeSerial)");
+}
+
+void SerialTransport::sendNmtService(const unsigned short /* node_id */,
+                                     const unsigned short /* command_specifier */) {
+  throw EposException("SendNMTService (Not supported on NativeSerial)");
+}
+
+} // namespace eposx_hardware
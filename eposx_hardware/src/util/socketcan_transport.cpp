@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include <eposx_hardware/socketcan_transport.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include <ros/time.h>
+
+namespace eposx_hardware {
+
+//
+// SDO protocol definitions (CiA-301)
+//
+
+// command specifiers in the first byte
+#define SDO_CCS_DOWNLOAD_SEGMENT 0x00
+#define SDO_CCS_INITIATE_DOWNLOAD 0x20
+#define SDO_CCS_INITIATE_UPLOAD 0x40
+#define SDO_CCS_UPLOAD_SEGMENT 0x60
+#define SDO_SCS_UPLOAD_SEGMENT 0x00
+#define SDO_SCS_DOWNLOAD_SEGMENT 0x20
+#define SDO_SCS_INITIATE_UPLOAD 0x40
+#define SDO_SCS_INITIATE_DOWNLOAD 0x60
+#define SDO_CS_ABORT 0x80
+#define SDO_CS_MASK 0xE0
+// flags in the first byte
+#define SDO_EXPEDITED 0x02
+#define SDO_SIZE_INDICATED 0x01
+#define SDO_TOGGLE 0x10
+#define SDO_LAST_SEGMENT 0x01
+
+// abort code on timeout, which is also an error code of the EPOS Command Library
+#define SDO_ABORT_TIMEOUT 0x05040000
+
+static boost::uint32_t getUint32(const unsigned char *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) |
+         (static_cast< boost::uint32_t >(data[3]) << 24);
+}
+
+static void setUint32(unsigned char *data, const boost::uint32_t value) {
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = (value >> 24) & 0xFF;
+}
+
+static can_frame makeSdoFrame(const unsigned short node_id, const unsigned char command,
+                              const unsigned short index, const unsigned char subindex) {
+  can_frame frame;
+  std::memset(&frame, 0, sizeof(frame));
+  frame.can_id = CANOPEN_SDO_RX + node_id;
+  frame.can_dlc = 8;
+  frame.data[0] = command;
+  frame.data[1] = index & 0xFF;
+  frame.data[2] = (index >> 8) & 0xFF;
+  frame.data[3] = subindex;
+  return frame;
+}
+
+//
+// SocketCanTransport
+//
+
+SocketCanTransport::SocketCanTransport(const DeviceInfo &device_info)
+    : NativeTransport(device_info), socket_(new SocketCan(device_info.port_name)) {
+  if (device_info.protocol_stack_name != "CANopen") {
+    throw EposException("OpenDevice (SocketCAN supports only CANopen, not " +
+                        device_info.protocol_stack_name + ")");
+  }
+}
+
+SocketCanTransport::~SocketCanTransport() {}
+
+void SocketCanTransport::reopen() {
+  // the old socket is kept if the new one cannot be opened
+  socket_.reset(new SocketCan(socket_->getInterfaceName()));
+  unread_frames_.clear();
+}
+
+//
+// object dictionary
+//
+
+void SocketCanTransport::getObject(const unsigned short node_id, const unsigned short index,
+                                   const unsigned char subindex, void *data,
+                                   const unsigned int length) {
+  unsigned char *const bytes(static_cast< unsigned char * >(data));
+  std::memset(bytes, 0, length);
+
+  // initiate upload
+  const can_frame initiate_response(requestSdo(
+      node_id, makeSdoFrame(node_id, SDO_CCS_INITIATE_UPLOAD, index, subindex), "GetObject"));
+  if ((initiate_response.data[0] & SDO_CS_MASK) != SDO_SCS_INITIATE_UPLOAD) {
+    throw EposException("GetObject (Unexpected SDO response)");
+  }
+
+  // expedited transfer has data in the response
+  if (initiate_response.data[0] & SDO_EXPEDITED) {
+    const unsigned int size((initiate_response.data[0] & SDO_SIZE_INDICATED)
+                                ? 4 - ((initiate_response.data[0] >> 2) & 0x03)
+                                : 4);
+    std::memcpy(bytes, initiate_response.data + 4, std::min(size, length));
+    return;
+  }
+
+  // segmented transfer
+  unsigned int offset(0);
+  unsigned char toggle(0);
+  while (true) {
+    can_frame request(makeSdoFrame(node_id, SDO_CCS_UPLOAD_SEGMENT | toggle, 0, 0));
+    std::memset(request.data + 1, 0, 7);
+    const can_frame response(requestSdo(node_id, request, "GetObject"));
+    if ((response.data[0] & SDO_CS_MASK) != SDO_SCS_UPLOAD_SEGMENT ||
+        (response.data[0] & SDO_TOGGLE) != toggle) {
+      throw EposException("GetObject (Unexpected SDO segment)");
+    }
+    const unsigned int size(7 - ((response.data[0] >> 1) & 0x07));
+    if (offset < length) {
+      std::memcpy(bytes + offset, response.data + 1, std::min(size, length - offset));
+    }
+    offset += size;
+    if (response.data[0] & SDO_LAST_SEGMENT) {
+      return;
+    }
+    toggle ^= SDO_TOGGLE;
+  }
+}
+
+void SocketCanTransport::setObject(const unsigned short node_id, const unsigned short index,
+                                   const unsigned char subindex, const void *data,
+                                   const unsigned int length) {
+  const unsigned char *const bytes(static_cast< const unsigned char * >(data));
+
+  // expedited transfer for small data
+  if (length <= 4) {
+    can_frame request(makeSdoFrame(node_id,
+                                   SDO_CCS_INITIATE_DOWNLOAD | ((4 - length) << 2) |
+                                       SDO_EXPEDITED | SDO_SIZE_INDICATED,
+                                   index, subindex));
+    std::memcpy(request.data + 4, bytes, length);
+    const can_frame response(requestSdo(node_id, request, "SetObject"));
+    if ((response.data[0] & SDO_CS_MASK) != SDO_SCS_INITIATE_DOWNLOAD) {
+      throw EposException("SetObject (Unexpected SDO response)");
+    }
+    return;
+  }
+
+  // segmented transfer for large data
+  {
+    can_frame request(
+        makeSdoFrame(node_id, SDO_CCS_INITIATE_DOWNLOAD | SDO_SIZE_INDICATED, index, subindex));
+    setUint32(request.data + 4, length);
+    const can_frame response(requestSdo(node_id, request, "SetObject"));
+    if ((response.data[0] & SDO_CS_MASK) != SDO_SCS_INITIATE_DOWNLOAD) {
+      throw EposException("SetObject (Unexpected SDO response)");
+    }
+  }
+  unsigned char toggle(0);
+  for (unsigned int offset = 0; offset < length; offset += 7) {
+    const unsigned int size(std::min(length - offset, 7u));
+    const bool last(offset + size >= length);
+    can_frame request(makeSdoFrame(node_id,
+                                   SDO_CCS_DOWNLOAD_SEGMENT | toggle | ((7 - size) << 1) |
+                                       (last ? SDO_LAST_SEGMENT : 0),
+                                   0, 0));
+    std::memset(request.data + 1, 0, 7);
+    std::memcpy(request.data + 1, bytes + offset, size);
+    const can_frame response(requestSdo(node_id, request, "SetObject"));
+    if ((response.data[0] & SDO_CS_MASK) != SDO_SCS_DOWNLOAD_SEGMENT ||
+        (response.data[0] & SDO_TOGGLE) != toggle) {
+      throw EposException("SetObject (Unexpected SDO segment)");
+    }
+    toggle ^= SDO_TOGGLE;
+  }
+}
+
+can_frame SocketCanTransport::requestSdo(const unsigned short node_id, const can_frame &request,
+                                         const std::string &func_name) {
+  sendSdo(node_id, request);
+  return receiveSdo(node_id, request, func_name);
+}
+
+void SocketCanTransport::sendSdo(const unsigned short node_id, const can_frame &request) {
+  // forget a stale response (e.g. of a timed-out request)
+  unread_frames_.erase(CANOPEN_SDO_TX + node_id);
+
+  socket_->send(request);
+}
+
+can_frame SocketCanTransport::receiveSdo(const unsigned short node_id, const can_frame &request,
+                                         const std::string &func_name) {
+  can_frame response;
+  if (!waitFrame(CANOPEN_SDO_TX + node_id, response, getTimeout())) {
+    // tell the node to give up the transfer
+    can_frame abort(request);
+    abort.data[0] = SDO_CS_ABORT;
+    setUint32(abort.data + 4, SDO_ABORT_TIMEOUT);
+    socket_->send(abort);
+    throw EposException(func_name + " (node " + boost::lexical_cast< std::string >(node_id) + ")",
+                        SDO_ABORT_TIMEOUT);
+  }
+  if (response.data[0] == SDO_CS_ABORT) {
+    // CANopen abort codes are also error codes of the EPOS Command Library
+    throw EposException(func_name + " (node " + boost::lexical_cast< std::string >(node_id) + ")",
+                        getUint32(response.data + 4));
+  }
+  return response;
+}
+
+bool SocketCanTransport::waitFrame(const canid_t cob_id, can_frame &frame,
+                                   const unsigned int timeout) {
+  // use a frame received during waiting another frame
+  const std::map< canid_t, can_frame >::iterator unread_frame(unread_frames_.find(cob_id));
+  if (unread_frame != unread_frames_.end()) {
+    frame = unread_frame->second;
+    unread_frames_.erase(unread_frame);
+    return true;
+  }
+
+  // receive frames until the one with the COB-ID
+  const ros::WallTime deadline(ros::WallTime::now() + ros::WallDuration(timeout / 1000.));
+  while (true) {
+    const ros::WallDuration remaining(deadline - ros::WallTime::now());
+    const unsigned int remaining_ms(
+        remaining > ros::WallDuration(0.) ? static_cast< unsigned int >(remaining.toSec() * 1000.)
+                                          : 0);
+    can_frame received;
+    if (!socket_->receive(received, remaining_ms)) {
+      if (remaining_ms == 0) {
+        return false;
+      }
+      continue;
+    }
+    if ((received.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0) {
+      continue;
+    }
+    if ((received.can_id & CAN_SFF_MASK) == cob_id) {
+      frame = received;
+      return true;
+    }
+    unread_frames_[received.can_id & CAN_SFF_MASK] = received;
+  }
+}
+
+void SocketCanTransport::submitObjects(std::vector< ObjectRequest > &requests) {
+  std::size_t begin(0);
+  while (begin < requests.size()) {
+    // large objects need segmented transfer
+    if (requests[begin].length > 4) {
+      std::vector< ObjectRequest > single(1, requests[begin]);
+      Transport::submitObjects(single);
+      requests[begin] = single.front();
+      ++begin;
+      continue;
+    }
+
+    // a node serves one SDO at a time, but different nodes can serve in parallel.
+    // send expedited requests to distinct nodes at once, and then wait their responses.
+    std::set< unsigned short > node_ids;
+    std::size_t end(begin);
+    for (; end < requests.size() && requests[end].length <= 4 &&
+           node_ids.insert(requests[end].node_id).second;
+         ++end) {
+      const ObjectRequest &object_request(requests[end]);
+      if (object_request.is_write) {
+        can_frame request(makeSdoFrame(object_request.node_id,
+                                       SDO_CCS_INITIATE_DOWNLOAD |
+                                           ((4 - object_request.length) << 2) | SDO_EXPEDITED |
+                                           SDO_SIZE_INDICATED,
+                                       object_request.index, object_request.subindex));
+        std::memcpy(request.data + 4, object_request.getWriteData(), object_request.length);
+        sendSdo(object_request.node_id, request);
+      } else {
+        sendSdo(object_request.node_id,
+                makeSdoFrame(object_request.node_id, SDO_CCS_INITIATE_UPLOAD, object_request.index,
+                             object_request.subindex));
+      }
+    }
+    for (std::size_t i = begin; i < end; ++i) {
+      ObjectRequest &object_request(requests[i]);
+      const std::string func_name(object_request.is_write ? "SetObject" : "GetObject");
+      try {
+        const can_frame response(receiveSdo(
+            object_request.node_id,
+            makeSdoFrame(object_request.node_id, 0, object_request.index, object_request.subindex),
+            func_name));
+        const unsigned char expected(object_request.is_write ? SDO_SCS_INITIATE_DOWNLOAD
+                                                             : SDO_SCS_INITIATE_UPLOAD);
+        if ((response.data[0] & SDO_CS_MASK) != expected ||
+            (!object_request.is_write && !(response.data[0] & SDO_EXPEDITED))) {
+          throw EposException(func_name + " (Unexpected SDO response)");
+        }
+        if (!object_request.is_write) {
+          std::memcpy(object_request.data, response.data + 4, object_request.length);
+        }
+        object_request.error.reset();
+      } catch (const EposException &error) {
+        object_request.error = boost::make_shared< EposException >(error);
+      }
+    }
+    begin = end;
+  }
+}
+
+//
+// CAN layer
+//
+
+void SocketCanTransport::sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                                      const void *data) {
+  if (length > 8) {
+    throw EposException("SendCANFrame (Length exceeds 8 bytes)");
+  }
+  can_frame frame;
+  std::memset(&frame, 0, sizeof(frame));
+  frame.can_id = cob_id;
+  frame.can_dlc = length;
+  std::memcpy(frame.data, data, length);
+  socket_->send(frame);
+}
+
+void SocketCanTransport::readCanFrame(const unsigned short cob_id, const unsigned short length,
+                                      void *data, const unsigned int timeout) {
+  can_frame frame;
+  if (!waitFrame(cob_id, frame, timeout)) {
+    throw EposException("ReadCANFrame (Timeout on COB-ID " +
+                        boost::lexical_cast< std::string >(cob_id) + ")");
+  }
+  std::memcpy(data, frame.data, std::min< unsigned short >(length, frame.can_dlc));
+}
+
+bool SocketCanTransport::readLatestCanFrame(const unsigned short cob_id,
+                                            const unsigned short length, void *data,
+                                            const unsigned int timeout) {
+  can_frame frame;
+  if (!waitFrame(cob_id, frame, timeout)) {
+    return false;
+  }
+  // drain the socket without waiting so that a node sending faster than the cycle
+  // does not build up a backlog of stale frames
+  can_frame received;
+  while (socket_->receive(received, 0)) {
+    if ((received.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0) {
+      continue;
+    }
+    if ((received.can_id & CAN_SFF_MASK) == cob_id) {
+      frame = received;
+    } else {
+      unread_frames_[received.can_id & CAN_SFF_MASK] = received;
+    }
+  }
+  std::memcpy(data, frame.data, std::min< unsigned short >(length, frame.can_dlc));
+  return true;
+}
+
+void SocketCanTransport::sendNmtService(const unsigned short node_id,
+                                        const unsigned short command_specifier) {
+  const unsigned char data[2] = {static_cast< unsigned char >(command_specifier),
+                                 static_cast< unsigned char >(node_id)};
+  sendCanFrame(CANOPEN_NMT, 2, data);
+}
+
+//
+// node discovery
+//
+
+bool SocketCanTransport::discoverNodes(const unsigned short max_node_id,
+                                       std::vector< unsigned short > &node_ids) {
+  std::set< unsigned short > found_node_ids;
+  unsigned short next_node_id(1);
+  // extended whenever a request is sent so that a full transmit queue does not end discovery
+  ros::WallTime deadline(ros::WallTime::now() + ros::WallDuration(getTimeout() / 1000.));
+  while (found_node_ids.size() < max_node_id) {
+    // send as many requests as the transmit queue accepts
+    while (next_node_id <= max_node_id) {
+      unread_frames_.erase(CANOPEN_SDO_TX + next_node_id);
+      if (!socket_->trySend(makeSdoFrame(next_node_id, SDO_CCS_INITIATE_UPLOAD, 0x1000, 0x00))) {
+        break;
+      }
+      ++next_node_id;
+      deadline = ros::WallTime::now() + ros::WallDuration(getTimeout() / 1000.);
+    }
+
+    const ros::WallDuration remaining(deadline - ros::WallTime::now());
+    const unsigned int remaining_ms(
+        remaining > ros::WallDuration(0.) ? static_cast< unsigned int >(remaining.toSec() * 1000.)
+                                          : 0);
+    if (remaining_ms == 0) {
+      break;
+    }
+    // poll briefly while requests are left to let the transmit queue drain
+    can_frame received;
+    if (!socket_->receive(received, next_node_id <= max_node_id ? 1 : remaining_ms)) {
+      continue;
+    }
+    if ((received.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0) {
+      continue;
+    }
+    // any SDO response (even an abort), boot-up or heartbeat tells the node is present
+    const canid_t cob_id(received.can_id & CAN_SFF_MASK);
+    const canid_t function_code(cob_id & ~0x7Fu);
+    const unsigned short found_node_id(cob_id & 0x7F);
+    if ((function_code == CANOPEN_SDO_TX || function_code == CANOPEN_HEARTBEAT) &&
+        found_node_id >= 1 && found_node_id <= max_node_id) {
+      found_node_ids.insert(found_node_id);
+    } else {
+      unread_frames_[cob_id] = received;
+    }
+  }
+
+  node_ids.assign(found_node_ids.begin(), found_node_ids.end());
+  return true;
+}
+
+} // namespace eposx_hardware
@@ -0,0 +1,583 @@
+#include <cstring>
+
+#include <eposx_hardware/transport.h>
+
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+
+#include <ros/console.h>
+
+namespace eposx_hardware {
+
+//
+// ObjectRequest
+//
+
+ObjectRequest::ObjectRequest()
+    : node_id(0), index(0), subindex(0), is_write(false), data(NULL), length(0) {
+  std::memset(payload, 0, sizeof(payload));
+}
+
+ObjectRequest ObjectRequest::read(const unsigned short node_id, const unsigned short index,
+                                  const unsigned char subindex, void *data,
+                                  const unsigned int length) {
+  ObjectRequest request;
+  request.node_id = node_id;
+  request.index = index;
+  request.subindex = subindex;
+  request.is_write = false;
+  request.data = data;
+  request.length = length;
+  return request;
+}
+
+ObjectRequest ObjectRequest::write(const unsigned short node_id, const unsigned short index,
+                                   const unsigned char subindex, const void *data,
+                                   const unsigned int length) {
+  ObjectRequest request(read(node_id, index, subindex, const_cast< void * >(data), length));
+  request.is_write = true;
+  // own small data because the value may be a temporary which dies before the batch is submitted
+  if (length <= sizeof(request.payload)) {
+    std::memcpy(request.payload, data, length);
+    request.data = NULL;
+  }
+  return request;
+}
+
+const void *ObjectRequest::getWriteData() const {
+  return length <= sizeof(payload) ? payload : data;
+}
+
+void throwIfFailed(const std::vector< ObjectRequest > &requests) {
+  BOOST_FOREACH (const ObjectRequest &request, requests) {
+    if (request.error) {
+      throw *request.error;
+    }
+  }
+}
+
+//
+// Transport
+//
+
+Transport::~Transport() {}
+
+const Transport *Transport::getPortOwner() const { return this; }
+
+boost::recursive_mutex &Transport::getMutex() const { return getPortOwner()->mutex_; }
+
+bool Transport::discoverNodes(const unsigned short /* max_node_id */,
+                              std::vector< unsigned short > & /* node_ids */) {
+  return false;
+}
+
+bool Transport::readLatestCanFrame(const unsigned short cob_id, const unsigned short length,
+                                   void *data, const unsigned int timeout) {
+  // a failed read is regarded as no frame because the library does not tell timeouts apart
+  try {
+    readCanFrame(cob_id, length, data, timeout);
+  } catch (const EposException &) {
+    return false;
+  }
+  // drain frames queued behind the first one
+  std::vector< unsigned char > latest(length);
+  while (true) {
+    try {
+      readCanFrame(cob_id, length, &latest[0], 0);
+    } catch (const EposException &) {
+      return true;
+    }
+    std::memcpy(data, &latest[0], length);
+  }
+}
+
+void Transport::submitObjects(std::vector< ObjectRequest > &requests) {
+  BOOST_FOREACH (ObjectRequest &request, requests) {
+    try {
+      if (request.is_write) {
+        setObject(request.node_id, request.index, request.subindex, request.getWriteData(),
+                  request.length);
+      } else {
+        getObject(request.node_id, request.index, request.subindex, request.data, request.length);
+      }
+      request.error.reset();
+    } catch (const EposException &error) {
+      request.error = boost::make_shared< EposException >(error);
+    }
+  }
+}
+
+//
+// DeviceLock
+//
+
+static const boost::shared_ptr< Transport > &
+getOpenedTransport(const DeviceHandle &device_handle) {
+  if (!device_handle.transport) {
+    throw EposException("DeviceLock (Device is not opened)");
+  }
+  return device_handle.transport;
+}
+
+DeviceLock::DeviceLock(const DeviceHandle &device_handle)
+    : transport_(getOpenedTransport(device_handle)), lock_(transport_->getMutex()) {}
+
+DeviceLock::~DeviceLock() {}
+
+//
+// VcsTransport
+//
+
+VcsTransport::VcsTransport(const DeviceInfo &device_info)
+    : device_info_(device_info), key_handle_(NULL), gateway_(), baudrate_(0), timeout_(0),
+      gateway_baudrate_(0) {
+  open();
+}
+
+VcsTransport::VcsTransport(const boost::shared_ptr< VcsTransport > &gateway,
+                           const DeviceInfo &device_info)
+    : device_info_(device_info), key_handle_(NULL), gateway_(gateway), baudrate_(0), timeout_(0),
+      gateway_baudrate_(0) {
+  open();
+}
+
+VcsTransport::~VcsTransport() {
+  // the gateway device may be closed after this by releasing gateway_
+  close();
+}
+
+void VcsTransport::open() {
+  unsigned int error_code;
+  if (gateway_) {
+    key_handle_ = VCS_OpenSubDevice(gateway_->getKeyHandle(),
+                                    const_cast< char * >(device_info_.device_name.c_str()),
+                                    const_cast< char * >(device_info_.protocol_stack_name.c_str()),
+                                    &error_code);
+    if (!key_handle_) {
+      throw EposException("OpenSubDevice", error_code);
+    }
+  } else {
+    key_handle_ = VCS_OpenDevice(const_cast< char * >(device_info_.device_name.c_str()),
+                                 const_cast< char * >(device_info_.protocol_stack_name.c_str()),
+                                 const_cast< char * >(device_info_.interface_name.c_str()),
+                                 const_cast< char * >(device_info_.port_name.c_str()),
+                                 &error_code);
+    if (!key_handle_) {
+      throw EposException("OpenDevice", error_code);
+    }
+  }
+}
+
+void VcsTransport::close() {
+  if (!key_handle_) {
+    return;
+  }
+  unsigned int error_code;
+  if (gateway_) {
+    if (VCS_CloseSubDevice(key_handle_, &error_code) == VCS_FALSE) {
+      ROS_ERROR_STREAM("CloseSubDevice (" + EposException::toErrorInfo(error_code) + ")");
+    }
+  } else {
+    if (VCS_CloseDevice(key_handle_, &error_code) == VCS_FALSE) {
+      ROS_ERROR_STREAM("CloseDevice (" + EposException::toErrorInfo(error_code) + ")");
+    }
+  }
+  key_handle_ = NULL;
+}
+
+void VcsTransport::reopen() {
+  // the handle of a lost device is useless even if the device comes back
+  close();
+  if (gateway_) {
+    // reopen the gateway only if it is lost too,
+    // so that other sub devices on the gateway keep their handles
+    try {
+      open();
+    } catch (const EposException &) {
+      gateway_->reopen();
+      open();
+    }
+  } else {
+    open();
+  }
+
+  if (baudrate_ != 0 || timeout_ != 0) {
+    VCS(SetProtocolStackSettings, key_handle_, baudrate_, timeout_);
+  }
+  if (gateway_baudrate_ != 0) {
+    VCS(SetGatewaySettings, key_handle_, gateway_baudrate_);
+  }
+}
+
+void *VcsTransport::getKeyHandle() const { return key_handle_; }
+
+const Transport *VcsTransport::getPortOwner() const {
+  return gateway_ ? gateway_->getPortOwner() : this;
+}
+
+//
+// device information & protocol stack settings
+//
+
+// names are queried once because they never change while the device is opened
+
+std::string VcsTransport::getDeviceName() {
+  if (device_name_.empty()) {
+    char buffer[1024];
+    VCS(GetDeviceName, key_handle_, buffer, 1024);
+    device_name_ = buffer;
+  }
+  return device_name_;
+}
+
+std::string VcsTransport::getProtocolStackName() {
+  if (protocol_stack_name_.empty()) {
+    char buffer[1024];
+    VCS(GetProtocolStackName, key_handle_, buffer, 1024);
+    protocol_stack_name_ = buffer;
+  }
+  return protocol_stack_name_;
+}
+
+std::string VcsTransport::getInterfaceName() {
+  if (interface_name_.empty()) {
+    char buffer[1024];
+    VCS(GetInterfaceName, key_handle_, buffer, 1024);
+    interface_name_ = buffer;
+  }
+  return interface_name_;
+}
+
+std::string VcsTransport::getPortName() {
+  if (port_name_.empty()) {
+    char buffer[1024];
+    VCS(GetPortName, key_handle_, buffer, 1024);
+    port_name_ = buffer;
+  }
+  return port_name_;
+}
+
+void VcsTransport::getProtocolStackSettings(unsigned int &baudrate, unsigned int &timeout) {
+  VCS(GetProtocolStackSettings, key_handle_, &baudrate, &timeout);
+}
+
+void VcsTransport::setProtocolStackSettings(const unsigned int baudrate,
+                                            const unsigned int timeout) {
+  VCS(SetProtocolStackSettings, key_handle_, baudrate, timeout);
+  baudrate_ = baudrate;
+  timeout_ = timeout;
+}
+
+void VcsTransport::setGatewaySettings(const unsigned int baudrate) {
+  VCS(SetGatewaySettings, key_handle_, baudrate);
+  gateway_baudrate_ = baudrate;
+}
+
+//
+// object dictionary & identity
+//
+
+void VcsTransport::getObject(const unsigned short node_id, const unsigned short index,
+                             const unsigned char subindex, void *data, const unsigned int length) {
+  unsigned int bytes_transferred;
+  VCS(GetObject, key_handle_, node_id, index, subindex, data, length, &bytes_transferred);
+}
+
+void VcsTransport::setObject(const unsigned short node_id, const unsigned short index,
+                             const unsigned char subindex, const void *data,
+                             const unsigned int length) {
+  unsigned int bytes_transferred;
+  VCS(SetObject, key_handle_, node_id, index, subindex, const_cast< void * >(data), length,
+      &bytes_transferred);
+}
+
+void VcsTransport::getVersion(const unsigned short node_id, unsigned short &hardware_version,
+                              unsigned short &software_version,
+                              unsigned short &application_number,
+                              unsigned short &application_version) {
+  VCS(GetVersion, key_handle_, node_id, &hardware_version, &software_version, &application_number,
+      &application_version);
+}
+
+//
+// state machine & error history
+//
+
+void VcsTransport::setEnableState(const unsigned short node_id) {
+  VCS(SetEnableState, key_handle_, node_id);
+}
+
+void VcsTransport::setDisableState(const unsigned short node_id) {
+  VCS(SetDisableState, key_handle_, node_id);
+}
+
+void VcsTransport::setQuickStopState(const unsigned short node_id) {
+  VCS(SetQuickStopState, key_handle_, node_id);
+}
+
+void VcsTransport::clearFault(const unsigned short node_id) {
+  VCS(ClearFault, key_handle_, node_id);
+}
+
+unsigned char VcsTransport::getNbOfDeviceError(const unsigned short node_id) {
+  unsigned char num_device_errors;
+  VCS(GetNbOfDeviceError, key_handle_, node_id, &num_device_errors);
+  return num_device_errors;
+}
+
+unsigned int VcsTransport::getDeviceErrorCode(const unsigned short node_id,
+                                              const unsigned char error_number) {
+  unsigned int device_error_code;
+  VCS(GetDeviceErrorCode, key_handle_, node_id, error_number, &device_error_code);
+  return device_error_code;
+}
+
+//
+// configuration
+//
+
+void VcsTransport::setMotorType(const unsigned short node_id, const unsigned short type) {
+  VCS(SetMotorType, key_handle_, node_id, type);
+}
+
+void VcsTransport::setDcMotorParameter(const unsigned short node_id,
+                                       const unsigned short nominal_current,
+                                       const unsigned short max_output_current,
+                                       const unsigned short thermal_time_constant) {
+  VCS(SetDcMotorParameter, key_handle_, node_id, nominal_current, max_output_current,
+      thermal_time_constant);
+}
+
+void VcsTransport::setEcMotorParameter(const unsigned short node_id,
+                                       const unsigned short nominal_current,
+                                       const unsigned short max_output_current,
+                                       const unsigned short thermal_time_constant,
+                                       const unsigned char number_of_pole_pairs) {
+  VCS(SetEcMotorParameter, key_handle_, node_id, nominal_current, max_output_current,
+      thermal_time_constant, number_of_pole_pairs);
+}
+
+void VcsTransport::setSensorType(const unsigned short node_id, const unsigned short type) {
+  VCS(SetSensorType, key_handle_, node_id, type);
+}
+
+void VcsTransport::setIncEncoderParameter(const unsigned short node_id,
+                                          const unsigned int resolution,
+                                          const bool inverted_polarity) {
+  VCS(SetIncEncoderParameter, key_handle_, node_id, resolution, inverted_polarity);
+}
+
+void VcsTransport::setSsiAbsEncoderParameter(const unsigned short node_id,
+                                             const unsigned short data_rate,
+                                             const unsigned short number_of_multiturn_bits,
+                                             const unsigned short number_of_singleturn_bits,
+                                             const bool inverted_polarity) {
+  VCS(SetSsiAbsEncoderParameter, key_handle_, node_id, data_rate, number_of_multiturn_bits,
+      number_of_singleturn_bits, inverted_polarity);
+}
+
+void VcsTransport::setMaxFollowingError(const unsigned short node_id, const unsigned int error) {
+  VCS(SetMaxFollowingError, key_handle_, node_id, error);
+}
+
+void VcsTransport::setMaxProfileVelocity(const unsigned short node_id,
+                                         const unsigned int velocity) {
+  VCS(SetMaxProfileVelocity, key_handle_, node_id, velocity);
+}
+
+void VcsTransport::setMaxAcceleration(const unsigned short node_id,
+                                      const unsigned int acceleration) {
+  VCS(SetMaxAcceleration, key_handle_, node_id, acceleration);
+}
+
+void VcsTransport::setPositionRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                            const unsigned short i, const unsigned short d) {
+  VCS(SetPositionRegulatorGain, key_handle_, node_id, p, i, d);
+}
+
+void VcsTransport::setPositionRegulatorFeedForward(const unsigned short node_id,
+                                                   const unsigned short velocity,
+                                                   const unsigned short acceleration) {
+  VCS(SetPositionRegulatorFeedForward, key_handle_, node_id, velocity, acceleration);
+}
+
+void VcsTransport::setVelocityRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                            const unsigned short i) {
+  VCS(SetVelocityRegulatorGain, key_handle_, node_id, p, i);
+}
+
+void VcsTransport::setVelocityRegulatorFeedForward(const unsigned short node_id,
+                                                   const unsigned short velocity,
+                                                   const unsigned short acceleration) {
+  VCS(SetVelocityRegulatorFeedForward, key_handle_, node_id, velocity, acceleration);
+}
+
+void VcsTransport::setCurrentRegulatorGain(const unsigned short node_id, const unsigned short p,
+                                           const unsigned short i) {
+  VCS(SetCurrentRegulatorGain, key_handle_, node_id, p, i);
+}
+
+void VcsTransport::setPositionProfile(const unsigned short node_id, const unsigned int velocity,
+                                      const unsigned int acceleration,
+                                      const unsigned int deceleration) {
+  VCS(SetPositionProfile, key_handle_, node_id, velocity, acceleration, deceleration);
+}
+
+void VcsTransport::enablePositionWindow(const unsigned short node_id, const unsigned int window,
+                                        const unsigned short time) {
+  VCS(EnablePositionWindow, key_handle_, node_id, window, time);
+}
+
+void VcsTransport::setVelocityProfile(const unsigned short node_id,
+                                      const unsigned int acceleration,
+                                      const unsigned int deceleration) {
+  VCS(SetVelocityProfile, key_handle_, node_id, acceleration, deceleration);
+}
+
+void VcsTransport::enableVelocityWindow(const unsigned short node_id, const unsigned int window,
+                                        const unsigned short time) {
+  VCS(EnableVelocityWindow, key_handle_, node_id, window, time);
+}
+
+//
+// operation modes & motion
+//
+
+void VcsTransport::setOperationMode(const unsigned short node_id, const char mode) {
+  VCS(SetOperationMode, key_handle_, node_id, mode);
+}
+
+void VcsTransport::activateProfilePositionMode(const unsigned short node_id) {
+  VCS(ActivateProfilePositionMode, key_handle_, node_id);
+}
+
+void VcsTransport::moveToPosition(const unsigned short node_id, const long position,
+                                  const bool absolute, const bool immediately) {
+  VCS(MoveToPosition, key_handle_, node_id, position, absolute, immediately);
+}
+
+void VcsTransport::activateProfileVelocityMode(const unsigned short node_id) {
+  VCS(ActivateProfileVelocityMode, key_handle_, node_id);
+}
+
+void VcsTransport::moveWithVelocity(const unsigned short node_id, const long velocity) {
+  VCS(MoveWithVelocity, key_handle_, node_id, velocity);
+}
+
+void VcsTransport::haltVelocityMovement(const unsigned short node_id) {
+  VCS(HaltVelocityMovement, key_handle_, node_id);
+}
+
+void VcsTransport::activateCurrentMode(const unsigned short node_id) {
+  VCS(ActivateCurrentMode, key_handle_, node_id);
+}
+
+void VcsTransport::setCurrentMust(const unsigned short node_id, const short current) {
+  VCS(SetCurrentMust, key_handle_, node_id, current);
+}
+
+//
+// position marker
+//
+
+void VcsTransport::setPositionMarkerParameter(const unsigned short node_id,
+                                              const unsigned char edge_type,
+                                              const unsigned char mode) {
+  VCS(SetPositionMarkerParameter, key_handle_, node_id, edge_type, mode);
+}
+
+void VcsTransport::activatePositionMarker(const unsigned short node_id,
+                                          const unsigned short digital_input_number,
+                                          const int polarity) {
+  VCS(ActivatePositionMarker, key_handle_, node_id, digital_input_number, polarity);
+}
+
+unsigned short VcsTransport::readPositionMarkerCounter(const unsigned short node_id) {
+  unsigned short count;
+  VCS(ReadPositionMarkerCounter, key_handle_, node_id, &count);
+  return count;
+}
+
+int VcsTransport::readPositionMarkerCapturedPosition(const unsigned short node_id,
+                                                     const unsigned short counter_index) {
+  long position;
+  VCS(ReadPositionMarkerCapturedPosition, key_handle_, node_id, counter_index, &position);
+  return position;
+}
+
+//
+// position compare
+//
+
+void VcsTransport::setPositionCompareParameter(const unsigned short node_id,
+                                               const unsigned char operational_mode,
+                                               const unsigned char interval_mode,
+                                               const unsigned char direction_dependency,
+                                               const unsigned short interval_width,
+                                               const unsigned short interval_repetitions,
+                                               const unsigned short pulse_width) {
+  VCS(SetPositionCompareParameter, key_handle_, node_id, operational_mode, interval_mode,
+      direction_dependency, interval_width, interval_repetitions, pulse_width);
+}
+
+void VcsTransport::activatePositionCompare(const unsigned short node_id,
+                                           const unsigned short digital_output_number,
+                                           const int polarity) {
+  VCS(ActivatePositionCompare, key_handle_, node_id, digital_output_number, polarity);
+}
+
+void VcsTransport::enablePositionCompare(const unsigned short node_id) {
+  VCS(EnablePositionCompare, key_handle_, node_id);
+}
+
+void VcsTransport::disablePositionCompare(const unsigned short node_id) {
+  VCS(DisablePositionCompare, key_handle_, node_id);
+}
+
+void VcsTransport::setPositionCompareReferencePosition(const unsigned short node_id,
+                                                       const int reference_position) {
+  VCS(SetPositionCompareReferencePosition, key_handle_, node_id, reference_position);
+}
+
+//
+// actual values
+//
+
+int VcsTransport::getPositionIs(const unsigned short node_id) {
+  int position;
+  VCS(GetPositionIs, key_handle_, node_id, &position);
+  return position;
+}
+
+int VcsTransport::getVelocityIs(const unsigned short node_id) {
+  int velocity;
+  VCS(GetVelocityIs, key_handle_, node_id, &velocity);
+  return velocity;
+}
+
+short VcsTransport::getCurrentIs(const unsigned short node_id) {
+  short current;
+  VCS(GetCurrentIs, key_handle_, node_id, &current);
+  return current;
+}
+
+//
+// CAN layer
+//
+
+void VcsTransport::sendCanFrame(const unsigned short cob_id, const unsigned short length,
+                                const void *data) {
+  VCS(SendCANFrame, key_handle_, cob_id, length, const_cast< void * >(data));
+}
+
+void VcsTransport::readCanFrame(const unsigned short cob_id, const unsigned short length,
+                                void *data, const unsigned int timeout) {
+  VCS(ReadCANFrame, key_handle_, cob_id, length, data, timeout);
+}
+
+void VcsTransport::sendNmtService(const unsigned short node_id,
+                                  const unsigned short command_specifier) {
+  VCS(SendNMTService, key_handle_, node_id, command_specifier);
+}
+
+} // namespace eposx_hardware
@@ -1,10 +1,21 @@
+#include <eposx_hardware/canopen.h>
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/object_dictionary.h>
+#include <eposx_hardware/serial_transport.h>
+#include <eposx_hardware/socketcan_transport.h>
+#include <eposx_hardware/transport.h>
 #include <eposx_hardware/utils.h>
 
+#include <algorithm>
+#include <functional>
 #include <ios>
 #include <map>
 #include <sstream>
 
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #include <boost/weak_ptr.hpp>
 
 #include <ros/console.h>
@@ -28,6 +39,17 @@ bool EposException::hasErrorCode() const { return has_error_code_; }
 
 unsigned int EposException::getErrorCode() const { return error_code_; }
 
+// error codes of a node not responding in time.
+// native transports and gateways report the SDO abort code, and libEposCmd reports its own
+// general timeout (e.g. a dead node on USB or RS232).
+#define ERROR_SDO_PROTOCOL_TIMEOUT 0x05040000
+#define ERROR_LIBRARY_TIMEOUT 0x1000000B
+
+bool EposException::isTimeout() const {
+  return has_error_code_ &&
+         (error_code_ == ERROR_SDO_PROTOCOL_TIMEOUT || error_code_ == ERROR_LIBRARY_TIMEOUT);
+}
+
 std::string EposException::toErrorInfo(const unsigned int error_code) {
   std::ostringstream oss;
   oss << "0x" << std::hex << error_code;
@@ -49,8 +71,15 @@ DeviceInfo::DeviceInfo(const std::string &device_name, const std::string &protoc
     : device_name(device_name), protocol_stack_name(protocol_stack_name),
       interface_name(interface_name), port_name(port_name) {}
 
+DeviceInfo::DeviceInfo(const DeviceInfo &gateway_info, const std::string &device_name,
+                       const std::string &protocol_stack_name)
+    : device_name(device_name), protocol_stack_name(protocol_stack_name), interface_name(),
+      port_name(), gateway_info(new DeviceInfo(gateway_info)) {}
+
 DeviceInfo::~DeviceInfo() {}
 
+bool DeviceInfo::isSubDevice() const { return static_cast< bool >(gateway_info); }
+
 struct LessDeviceInfo {
   bool operator()(const DeviceInfo &a, const DeviceInfo &b) const {
     if (a.device_name != b.device_name) {
@@ -62,7 +91,17 @@ struct LessDeviceInfo {
     if (a.interface_name != b.interface_name) {
       return a.interface_name < b.interface_name;
     }
-    return a.port_name < b.port_name;
+    if (a.port_name != b.port_name) {
+      return a.port_name < b.port_name;
+    }
+    // devices behind different gateways are different
+    if (a.isSubDevice() != b.isSubDevice()) {
+      return b.isSubDevice();
+    }
+    if (a.isSubDevice()) {
+      return (*this)(*a.gateway_info, *b.gateway_info);
+    }
+    return false;
   }
 };
 
@@ -70,71 +109,150 @@ struct LessDeviceInfo {
 // DeviceHandle
 //
 
-DeviceHandle::DeviceHandle() : ptr() {}
+DeviceHandle::DeviceHandle() : transport() {}
 
-DeviceHandle::DeviceHandle(const DeviceInfo &device_info) : ptr(makePtr(device_info)) {}
+DeviceHandle::DeviceHandle(const DeviceInfo &device_info)
+    : transport(makeTransport(device_info)) {}
 
 DeviceHandle::~DeviceHandle() {}
 
-boost::shared_ptr< void > DeviceHandle::makePtr(const DeviceInfo &device_info) {
-  // shared storage of opened devices
-  static std::map< DeviceInfo, boost::weak_ptr< void >, LessDeviceInfo > existing_device_ptrs;
+boost::shared_ptr< Transport > DeviceHandle::makeTransport(const DeviceInfo &device_info) {
+  // shared storage of opened devices.
+  // the mutex is recursive because opening a sub device opens its gateway device.
+  static boost::recursive_mutex mutex;
+  static std::map< DeviceInfo, boost::weak_ptr< Transport >, LessDeviceInfo > existing_transports;
+  boost::lock_guard< boost::recursive_mutex > lock(mutex);
 
   // try find an existing device
-  const boost::shared_ptr< void > existing_device_ptr(existing_device_ptrs[device_info].lock());
-  if (existing_device_ptr) {
-    return existing_device_ptr;
+  const boost::shared_ptr< Transport > existing_transport(
+      existing_transports[device_info].lock());
+  if (existing_transport) {
+    return existing_transport;
   }
   // open new device if not exists
-  const boost::shared_ptr< void > new_device_ptr(/*raw ptr*/ openDevice(device_info),
-                                                 /*deleter*/ closeDevice);
-  existing_device_ptrs[device_info] = new_device_ptr;
-  return new_device_ptr;
-}
-
-void *DeviceHandle::openDevice(const DeviceInfo &device_info) {
-  unsigned int error_code;
-  void *const raw_device_ptr(
-      VCS_OpenDevice(const_cast< char * >(device_info.device_name.c_str()),
-                     const_cast< char * >(device_info.protocol_stack_name.c_str()),
-                     const_cast< char * >(device_info.interface_name.c_str()),
-                     const_cast< char * >(device_info.port_name.c_str()), &error_code));
-  if (!raw_device_ptr) {
-    throw EposException("OpenDevice", error_code);
-  }
-  return raw_device_ptr;
-}
-
-void DeviceHandle::closeDevice(void *raw_device_ptr) {
-  unsigned int error_code;
-  if (VCS_CloseDevice(raw_device_ptr, &error_code) == VCS_FALSE) {
-    // deleter of shared_ptr must not throw
-    ROS_ERROR_STREAM("CloseDevice (" + EposException::toErrorInfo(error_code) + ")");
+  boost::shared_ptr< Transport > new_transport;
+  if (device_info.interface_name == SOCKETCAN_INTERFACE_NAME) {
+    new_transport.reset(new SocketCanTransport(device_info));
+  } else if (device_info.interface_name == MAXON_SERIAL_INTERFACE_NAME) {
+    new_transport.reset(new SerialTransport(device_info));
+  } else if (device_info.isSubDevice()) {
+    // the gateway device is shared with other sub devices and nodes on the gateway,
+    // and is kept opened until the sub device is closed
+    const boost::shared_ptr< VcsTransport > gateway(boost::dynamic_pointer_cast< VcsTransport >(
+        DeviceHandle(*device_info.gateway_info).transport));
+    if (!gateway) {
+      throw EposException("OpenSubDevice (Gateway must be opened via the EPOS Command Library)");
+    }
+    new_transport.reset(new VcsTransport(gateway, device_info));
+  } else {
+    new_transport.reset(new VcsTransport(device_info));
   }
+  existing_transports[device_info] = new_transport;
+  return new_transport;
 }
 
 //
 // NodeInfo
 //
 
-NodeInfo::NodeInfo() : DeviceInfo(), node_id(0) {}
+NodeInfo::NodeInfo()
+    : DeviceInfo(), node_id(0), serial_number(0), hardware_version(0), software_version(0),
+      application_number(0), application_version(0) {}
 
 NodeInfo::NodeInfo(const DeviceInfo &device_info, const unsigned short node_id)
-    : DeviceInfo(device_info), node_id(node_id) {}
+    : DeviceInfo(device_info), node_id(node_id), serial_number(0), hardware_version(0),
+      software_version(0), application_number(0), application_version(0) {}
 
 NodeInfo::~NodeInfo() {}
 
+//
+// NodeCache
+//
+
+NodeCache::NodeCache()
+    : has_version_(false), hardware_version_(0), software_version_(0), application_number_(0),
+      application_version_(0) {}
+
+NodeCache::~NodeCache() {}
+
+bool NodeCache::getObject(const unsigned short index, const unsigned char subindex, void *data,
+                          const unsigned int length) const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  const std::map< ObjectKey, std::vector< unsigned char > >::const_iterator object(
+      objects_.find(ObjectKey(index, subindex)));
+  if (object == objects_.end() || object->second.size() != length) {
+    return false;
+  }
+  std::copy(object->second.begin(), object->second.end(), static_cast< unsigned char * >(data));
+  return true;
+}
+
+void NodeCache::setObject(const unsigned short index, const unsigned char subindex,
+                          const void *data, const unsigned int length) {
+  const unsigned char *const bytes(static_cast< const unsigned char * >(data));
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  objects_[ObjectKey(index, subindex)].assign(bytes, bytes + length);
+}
+
+bool NodeCache::getVersion(unsigned short &hardware_version, unsigned short &software_version,
+                           unsigned short &application_number,
+                           unsigned short &application_version) const {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  if (!has_version_) {
+    return false;
+  }
+  hardware_version = hardware_version_;
+  software_version = software_version_;
+  application_number = application_number_;
+  application_version = application_version_;
+  return true;
+}
+
+void NodeCache::setVersion(const unsigned short hardware_version,
+                           const unsigned short software_version,
+                           const unsigned short application_number,
+                           const unsigned short application_version) {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  has_version_ = true;
+  hardware_version_ = hardware_version;
+  software_version_ = software_version;
+  application_number_ = application_number;
+  application_version_ = application_version;
+}
+
+void NodeCache::invalidate() {
+  boost::lock_guard< boost::mutex > lock(mutex_);
+  objects_.clear();
+  has_version_ = false;
+}
+
 //
 // NodeHandle
 //
 
-NodeHandle::NodeHandle() : DeviceHandle(), node_id(0) {}
+NodeHandle::NodeHandle() : DeviceHandle(), node_id(0), cache(boost::make_shared< NodeCache >()) {}
 
 NodeHandle::NodeHandle(const NodeInfo &node_info)
-    : DeviceHandle(node_info), node_id(node_info.node_id) {}
+    : DeviceHandle(node_info), node_id(node_info.node_id),
+      cache(boost::make_shared< NodeCache >()) {
+  // identity known by enumerateNodes()
+  if (node_info.hardware_version != 0) {
+    cache->setVersion(node_info.hardware_version, node_info.software_version,
+                      node_info.application_number, node_info.application_version);
+  }
+  if (node_info.serial_number != 0) {
+    if (objects::SerialNumber::isAvailableOn(node_info.device_name)) {
+      cache->setObject(objects::SerialNumber::index, objects::SerialNumber::subindex,
+                       &node_info.serial_number, objects::SerialNumber::length);
+    } else if (objects::SerialNumberEpos4::isAvailableOn(node_info.device_name)) {
+      cache->setObject(objects::SerialNumberEpos4::index, objects::SerialNumberEpos4::subindex,
+                       &node_info.serial_number, objects::SerialNumberEpos4::length);
+    }
+  }
+}
 
 NodeHandle::NodeHandle(const DeviceHandle &device_handle, unsigned short node_id)
-    : DeviceHandle(device_handle), node_id(node_id) {}
+    : DeviceHandle(device_handle), node_id(node_id), cache(boost::make_shared< NodeCache >()) {}
 
 NodeHandle::~NodeHandle() {}
 
@@ -185,12 +303,29 @@ std::vector< std::string > getInterfaceNameList(const std::string &device_name,
         const_cast< char * >(protocol_stack_name.c_str()), false, buffer, 1024, &end_of_selection);
     interface_names.push_back(buffer);
   }
+  // CANopen nodes are also accessible via SocketCAN without the library
+  if (protocol_stack_name == "CANopen") {
+    interface_names.push_back(SOCKETCAN_INTERFACE_NAME);
+  }
+  // serial devices are also accessible via tty devices without the library
+  if (protocol_stack_name == "MAXON SERIAL V2") {
+    interface_names.push_back(MAXON_SERIAL_INTERFACE_NAME);
+  }
   return interface_names;
 }
 
 std::vector< std::string > getPortNameList(const std::string &device_name,
                                            const std::string &protocol_stack_name,
                                            const std::string &interface_name) {
+  // ports of SocketCAN are network interfaces
+  if (interface_name == SOCKETCAN_INTERFACE_NAME) {
+    return getSocketCanInterfaceNames();
+  }
+  // ports of the native serial are tty devices
+  if (interface_name == MAXON_SERIAL_INTERFACE_NAME) {
+    return getSerialPortNames();
+  }
+
   char buffer[1024];
   int end_of_selection; // BOOL
   std::vector< std::string > port_names;
@@ -211,6 +346,17 @@ std::vector< unsigned int > getBaudrateList(const std::string &device_name,
                                             const std::string &protocol_stack_name,
                                             const std::string &interface_name,
                                             const std::string &port_name) {
+  // bitrates of SocketCAN are configured on network interfaces (e.g. by 'ip link')
+  if (interface_name == SOCKETCAN_INTERFACE_NAME) {
+    return std::vector< unsigned int >();
+  }
+  // standard baudrates of RS232 (ignored by USB)
+  if (interface_name == MAXON_SERIAL_INTERFACE_NAME) {
+    static const unsigned int baudrates[] = {9600, 19200, 38400, 57600, 115200};
+    return std::vector< unsigned int >(baudrates,
+                                       baudrates + sizeof(baudrates) / sizeof(baudrates[0]));
+  }
+
   unsigned int baudrate;
   int end_of_selection; // BOOL
   std::vector< unsigned int > baudrates;
@@ -246,27 +392,28 @@ std::vector< DeviceInfo > enumerateDevices(const std::string &device_name,
 //
 
 std::string getDeviceName(const DeviceHandle &device_handle) {
-  char buffer[1024];
-  VCS_DN(GetDeviceName, device_handle, buffer, 1024);
-  return buffer;
+  return device_handle.transport->getDeviceName();
 }
 
 std::string getProtocolStackName(const DeviceHandle &device_handle) {
-  char buffer[1024];
-  VCS_DN(GetProtocolStackName, device_handle, buffer, 1024);
-  return buffer;
+  return device_handle.transport->getProtocolStackName();
 }
 
 std::string getInterfaceName(const DeviceHandle &device_handle) {
-  char buffer[1024];
-  VCS_DN(GetInterfaceName, device_handle, buffer, 1024);
-  return buffer;
+  return device_handle.transport->getInterfaceName();
 }
 
 std::string getPortName(const DeviceHandle &device_handle) {
-  char buffer[1024];
-  VCS_DN(GetPortName, device_handle, buffer, 1024);
-  return buffer;
+  return device_handle.transport->getPortName();
+}
+
+void *getKeyHandle(const DeviceHandle &device_handle) {
+  const VcsTransport *const vcs_transport(
+      dynamic_cast< const VcsTransport * >(device_handle.transport.get()));
+  if (!vcs_transport) {
+    throw EposException("getKeyHandle (Device is not opened via the EPOS Command Library)");
+  }
+  return vcs_transport->getKeyHandle();
 }
 
 //
@@ -276,18 +423,49 @@ std::string getPortName(const DeviceHandle &device_handle) {
 std::vector< NodeInfo > enumerateNodes(const DeviceInfo &device_info, const unsigned short node_id,
                                        const unsigned short max_node_id) {
   // enumerate all possible devices (assuming port name may be missed)
-  const std::vector< DeviceInfo > possible_device_infos(
-      device_info.port_name.empty()
-          ? enumerateDevices(device_info.device_name, device_info.protocol_stack_name,
-                             device_info.interface_name)
-          : std::vector< DeviceInfo >(1, device_info));
+  std::vector< DeviceInfo > possible_device_infos;
+  if (device_info.isSubDevice()) {
+    // sub devices behind all possible gateways
+    const DeviceInfo &gateway_info(*device_info.gateway_info);
+    const std::vector< DeviceInfo > possible_gateway_infos(
+        gateway_info.port_name.empty()
+            ? enumerateDevices(gateway_info.device_name, gateway_info.protocol_stack_name,
+                               gateway_info.interface_name)
+            : std::vector< DeviceInfo >(1, gateway_info));
+    BOOST_FOREACH (const DeviceInfo &possible_gateway_info, possible_gateway_infos) {
+      possible_device_infos.push_back(DeviceInfo(possible_gateway_info, device_info.device_name,
+                                                 device_info.protocol_stack_name));
+    }
+  } else if (device_info.port_name.empty()) {
+    possible_device_infos = enumerateDevices(
+        device_info.device_name, device_info.protocol_stack_name, device_info.interface_name);
+  } else {
+    possible_device_infos.push_back(device_info);
+  }
 
   // enumerate all possible nodes (assuming node id may be missed)
   std::vector< NodeInfo > possible_node_infos;
   BOOST_FOREACH (const DeviceInfo &possible_device_info, possible_device_infos) {
     if (node_id == 0) {
-      for (unsigned short possible_node_id = 1; possible_node_id <= max_node_id;
-           ++possible_node_id) {
+      // discover present nodes in a single pass if the device supports,
+      // or try all node ids (absent ones cost a timeout each)
+      std::vector< unsigned short > possible_node_ids;
+      bool is_discovered;
+      try {
+        const DeviceHandle device_handle(possible_device_info);
+        DeviceLock lock(device_handle);
+        is_discovered = device_handle.transport->discoverNodes(max_node_id, possible_node_ids);
+      } catch (const EposException &) {
+        // device does not exist
+        continue;
+      }
+      if (!is_discovered) {
+        for (unsigned short possible_node_id = 1; possible_node_id <= max_node_id;
+             ++possible_node_id) {
+          possible_node_ids.push_back(possible_node_id);
+        }
+      }
+      BOOST_FOREACH (const unsigned short possible_node_id, possible_node_ids) {
         possible_node_infos.push_back(NodeInfo(possible_device_info, possible_node_id));
       }
     } else {
@@ -301,8 +479,9 @@ std::vector< NodeInfo > enumerateNodes(const DeviceInfo &device_info, const unsi
     try {
       NodeInfo node_info(possible_node_info);
       NodeHandle node_handle(node_info);
-      VCS_NN(GetVersion, node_handle, &node_info.hardware_version, &node_info.software_version,
-             &node_info.application_number, &node_info.application_version);
+      DeviceLock lock(node_handle);
+      getVersion(node_handle, node_info.hardware_version, node_info.software_version,
+                 node_info.application_number, node_info.application_version);
       node_info.serial_number = getSerialNumber(node_handle);
       existing_node_infos.push_back(node_info);
     } catch (const EposException &) {
@@ -339,18 +518,88 @@ NodeHandle createNodeHandle(const DeviceInfo &device_info, const unsigned short
 }
 
 boost::uint64_t getSerialNumber(const NodeHandle &node_handle) {
+  DeviceLock lock(node_handle);
   const std::string device_name(getDeviceName(node_handle));
-  boost::uint64_t serial_number;
-  if (device_name == "EPOS") {
-    VCS_OBJ(GetObject, node_handle, 0x2004, 0x00, &serial_number, 8);
-  } else if (device_name == "EPOS2") {
-    VCS_OBJ(GetObject, node_handle, 0x2004, 0x00, &serial_number, 8);
-  } else if (device_name == "EPOS4") {
-    VCS_OBJ(GetObject, node_handle, 0x2100, 0x01, &serial_number, 8);
-  } else {
-    throw EposException("getSerialNumber (Unsupported device name \"" + device_name + "\")");
+  if (objects::SerialNumber::isAvailableOn(device_name)) {
+    return readObject< objects::SerialNumber >(node_handle);
+  } else if (objects::SerialNumberEpos4::isAvailableOn(device_name)) {
+    return readObject< objects::SerialNumberEpos4 >(node_handle);
+  }
+  throw EposException("getSerialNumber (Unsupported device name \"" + device_name + "\")");
+}
+
+// throw if any of the nodes does not respond
+static void verifyCommunication(const DeviceHandle &device_handle,
+                                const std::vector< unsigned short > &node_ids) {
+  BOOST_FOREACH (const unsigned short node_id, node_ids) {
+    objects::Statusword::Type statusword;
+    device_handle.transport->getObject(node_id, objects::Statusword::index,
+                                       objects::Statusword::subindex, &statusword,
+                                       objects::Statusword::length);
+  }
+}
+
+unsigned int applyHighestBaudrate(const DeviceHandle &device_handle,
+                                  const std::vector< unsigned short > &node_ids,
+                                  const unsigned int timeout) {
+  DeviceLock lock(device_handle);
+  // only the host side is switched. nodes on CANopen keep the bus bitrate, so the host would
+  // disturb the bus (error frames, bus-off of all nodes) at any other bitrate.
+  if (getProtocolStackName(device_handle) == "CANopen") {
+    throw EposException("applyHighestBaudrate (Not available on CANopen)");
+  }
+  unsigned int current_baudrate, current_timeout;
+  device_handle.transport->getProtocolStackSettings(current_baudrate, current_timeout);
+  const unsigned int new_timeout(timeout > 0 ? timeout : current_timeout);
+
+  // candidates from the highest. no candidates if the baudrate is configured out of this package
+  // (e.g. SocketCAN) or is unknown.
+  std::vector< unsigned int > baudrates;
+  try {
+    baudrates = getBaudrateList(getDeviceName(device_handle), getProtocolStackName(device_handle),
+                                getInterfaceName(device_handle), getPortName(device_handle));
+  } catch (const EposException &error) {
+    ROS_WARN_STREAM("Keep current baudrate because no baudrates are listed (" << error.what()
+                                                                              << ")");
+  }
+  if (current_baudrate == 0) {
+    baudrates.clear();
+  }
+  std::sort(baudrates.begin(), baudrates.end(), std::greater< unsigned int >());
+
+  // try higher baudrates, and go back to the known good one on every failure
+  BOOST_FOREACH (const unsigned int baudrate, baudrates) {
+    if (baudrate <= current_baudrate) {
+      break;
+    }
+    try {
+      device_handle.transport->setProtocolStackSettings(baudrate, new_timeout);
+      verifyCommunication(device_handle, node_ids);
+      return baudrate;
+    } catch (const EposException &error) {
+      ROS_WARN_STREAM("Baudrate " << baudrate << " is not available (" << error.what() << ")");
+      device_handle.transport->setProtocolStackSettings(current_baudrate, new_timeout);
+    }
+  }
+  if (new_timeout != current_timeout) {
+    device_handle.transport->setProtocolStackSettings(current_baudrate, new_timeout);
+  }
+  verifyCommunication(device_handle, node_ids);
+  return current_baudrate;
+}
+
+void getVersion(const NodeHandle &node_handle, unsigned short &hardware_version,
+                unsigned short &software_version, unsigned short &application_number,
+                unsigned short &application_version) {
+  if (node_handle.cache->getVersion(hardware_version, software_version, application_number,
+                                    application_version)) {
+    return;
   }
-  return serial_number;
+  DeviceLock lock(node_handle);
+  node_handle.transport->getVersion(node_handle.node_id, hardware_version, software_version,
+                                    application_number, application_version);
+  node_handle.cache->setVersion(hardware_version, software_version, application_number,
+                                application_version);
 }
 
 } // namespace eposx_hardware
@@ -0,0 +1,199 @@
+#include <cstddef>
+#include <vector>
+
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/foreach.hpp>
+
+#include <gtest/gtest.h>
+
+namespace eh = eposx_hardware;
+
+//
+// helpers
+//
+
+static eh::MaxonSerialFrame makeFrame(const unsigned char op_code, const unsigned char *data,
+                                      const std::size_t length) {
+  eh::MaxonSerialFrame frame(op_code);
+  frame.addBytes(data, length);
+  return frame;
+}
+
+static std::vector< unsigned char > encode(const eh::MaxonSerialFrame &frame) {
+  std::vector< unsigned char > bytes;
+  eh::encodeMaxonSerialFrame(frame, bytes);
+  return bytes;
+}
+
+// feed bytes and return the number of completed frames (the last one is stored)
+static int feed(eh::MaxonSerialDecoder &decoder, const std::vector< unsigned char > &bytes,
+                eh::MaxonSerialFrame &frame) {
+  int num_frames(0);
+  BOOST_FOREACH (const unsigned char byte, bytes) {
+    if (decoder.feed(byte, frame)) {
+      ++num_frames;
+    }
+  }
+  return num_frames;
+}
+
+//
+// known vectors (CRC-16/XMODEM over the header and data words in big endian,
+// computed independently of the implementation)
+//
+
+// ReadObject of the statusword (0x6041/00) on node 1
+static const unsigned char read_statusword_data[] = {0x01, 0x41, 0x60, 0x00};
+static const unsigned char read_statusword_bytes[] = {0x90, 0x02, 0x60, 0x02, 0x01,
+                                                      0x41, 0x60, 0x00, 0x22, 0xD1};
+
+// WriteObject of 1000 ms to the heartbeat time (0x1017/00) on node 1
+static const unsigned char write_heartbeat_data[] = {0x01, 0x17, 0x10, 0x00,
+                                                     0xE8, 0x03, 0x00, 0x00};
+static const unsigned char write_heartbeat_bytes[] = {0x90, 0x02, 0x68, 0x04, 0x01, 0x17, 0x10,
+                                                      0x00, 0xE8, 0x03, 0x00, 0x00, 0x34, 0xA8};
+
+// SegmentWrite with an odd number of bytes, padded by a zero byte
+static const unsigned char odd_segment_data[] = {0x01, 0x3F, 0xAA};
+static const unsigned char odd_segment_bytes[] = {0x90, 0x02, 0x62, 0x02, 0x01,
+                                                  0x3F, 0xAA, 0x00, 0x88, 0x0D};
+
+// ReadObject of 0x6060/00 whose CRC (0x90D8) has DLE to be stuffed
+static const unsigned char dle_crc_data[] = {0x01, 0x60, 0x60, 0x00};
+static const unsigned char dle_crc_bytes[] = {0x90, 0x02, 0x60, 0x02, 0x01, 0x60,
+                                              0x60, 0x00, 0xD8, 0x90, 0x90};
+
+#define BYTES(array) std::vector< unsigned char >(array, array + sizeof(array))
+
+TEST(MaxonSerial, CrcKnownVectors) {
+  EXPECT_EQ(0xD122, eh::calcMaxonSerialCrc(makeFrame(0x60, read_statusword_data,
+                                                     sizeof(read_statusword_data))));
+  EXPECT_EQ(0xA834, eh::calcMaxonSerialCrc(makeFrame(0x68, write_heartbeat_data,
+                                                     sizeof(write_heartbeat_data))));
+  EXPECT_EQ(0x0D88, eh::calcMaxonSerialCrc(
+                        makeFrame(0x62, odd_segment_data, sizeof(odd_segment_data))));
+  EXPECT_EQ(0x90D8,
+            eh::calcMaxonSerialCrc(makeFrame(0x60, dle_crc_data, sizeof(dle_crc_data))));
+  // the CRC of all-zero words is zero
+  EXPECT_EQ(0x0000, eh::calcMaxonSerialCrc(eh::MaxonSerialFrame(0x00)));
+}
+
+TEST(MaxonSerial, EncodeKnownVectors) {
+  EXPECT_EQ(BYTES(read_statusword_bytes),
+            encode(makeFrame(0x60, read_statusword_data, sizeof(read_statusword_data))));
+  EXPECT_EQ(BYTES(write_heartbeat_bytes),
+            encode(makeFrame(0x68, write_heartbeat_data, sizeof(write_heartbeat_data))));
+  EXPECT_EQ(BYTES(odd_segment_bytes),
+            encode(makeFrame(0x62, odd_segment_data, sizeof(odd_segment_data))));
+  EXPECT_EQ(BYTES(dle_crc_bytes), encode(makeFrame(0x60, dle_crc_data, sizeof(dle_crc_data))));
+}
+
+TEST(MaxonSerial, DecodeKnownVectors) {
+  eh::MaxonSerialDecoder decoder;
+  eh::MaxonSerialFrame frame;
+
+  ASSERT_EQ(1, feed(decoder, BYTES(write_heartbeat_bytes), frame));
+  EXPECT_EQ(0x68, frame.op_code);
+  EXPECT_EQ(BYTES(write_heartbeat_data), frame.data);
+  EXPECT_EQ(1000u, frame.getUint32(4));
+
+  ASSERT_EQ(1, feed(decoder, BYTES(dle_crc_bytes), frame));
+  EXPECT_EQ(0x60, frame.op_code);
+  EXPECT_EQ(BYTES(dle_crc_data), frame.data);
+
+  // the padding byte is kept on decoding
+  ASSERT_EQ(1, feed(decoder, BYTES(odd_segment_bytes), frame));
+  std::vector< unsigned char > padded(BYTES(odd_segment_data));
+  padded.push_back(0x00);
+  EXPECT_EQ(padded, frame.data);
+
+  EXPECT_EQ(0u, decoder.getNbOfCrcErrors());
+}
+
+TEST(MaxonSerial, RoundTripWithStuffing) {
+  // DLE in the op code, the length (0x90 words) and the data
+  eh::MaxonSerialFrame sent(0x90);
+  for (int i = 0; i < 2 * 0x90; ++i) {
+    sent.addUint8(i % 2 == 0 ? 0x90 : i & 0xFF);
+  }
+  const std::vector< unsigned char > bytes(encode(sent));
+  EXPECT_GT(bytes.size(), 2 + 2 + sent.data.size() + 2);
+
+  eh::MaxonSerialDecoder decoder;
+  eh::MaxonSerialFrame received;
+  ASSERT_EQ(1, feed(decoder, bytes, received));
+  EXPECT_EQ(sent.op_code, received.op_code);
+  EXPECT_EQ(sent.data, received.data);
+}
+
+TEST(MaxonSerial, RoundTripOfValues) {
+  eh::MaxonSerialFrame sent(MAXON_SERIAL_RESPONSE);
+  sent.addUint32(0x00000000); // error code
+  sent.addUint32(0x12345678);
+  sent.addUint16(0x9090);
+  sent.addUint8(0x01);
+
+  eh::MaxonSerialDecoder decoder;
+  eh::MaxonSerialFrame received;
+  ASSERT_EQ(1, feed(decoder, encode(sent), received));
+  EXPECT_EQ(0x00000000u, received.getUint32(0));
+  EXPECT_EQ(0x12345678u, received.getUint32(4));
+  EXPECT_EQ(0x00019090u, received.getUint32(8));
+  // out of the data
+  EXPECT_EQ(0x00000000u, received.getUint32(16));
+}
+
+TEST(MaxonSerial, TooLongFrame) {
+  eh::MaxonSerialFrame frame(0x68);
+  frame.data.resize(2 * 0x100);
+  std::vector< unsigned char > bytes;
+  EXPECT_THROW(eh::encodeMaxonSerialFrame(frame, bytes), eh::EposException);
+}
+
+TEST(MaxonSerial, CrcError) {
+  std::vector< unsigned char > bytes(BYTES(read_statusword_bytes));
+  bytes[5] ^= 0x01;
+
+  eh::MaxonSerialDecoder decoder;
+  eh::MaxonSerialFrame frame;
+  EXPECT_EQ(0, feed(decoder, bytes, frame));
+  EXPECT_EQ(1u, decoder.getNbOfCrcErrors());
+
+  // the decoder is ready for the next frame
+  EXPECT_EQ(1, feed(decoder, BYTES(read_statusword_bytes), frame));
+  EXPECT_EQ(1u, decoder.getNbOfCrcErrors());
+}
+
+TEST(MaxonSerial, Resynchronization) {
+  // noise and a truncated frame before a complete frame
+  std::vector< unsigned char > bytes;
+  bytes.push_back(0x55);
+  bytes.push_back(0x02);
+  bytes.insert(bytes.end(), write_heartbeat_bytes, write_heartbeat_bytes + 7);
+  bytes.insert(bytes.end(), read_statusword_bytes,
+               read_statusword_bytes + sizeof(read_statusword_bytes));
+
+  eh::MaxonSerialDecoder decoder;
+  eh::MaxonSerialFrame frame;
+  ASSERT_EQ(1, feed(decoder, bytes, frame));
+  EXPECT_EQ(0x60, frame.op_code);
+  EXPECT_EQ(BYTES(read_statusword_data), frame.data);
+  EXPECT_EQ(0u, decoder.getNbOfCrcErrors());
+
+  // an invalid escape sequence drops the frame in progress
+  bytes.assign(read_statusword_bytes, read_statusword_bytes + 6);
+  bytes.push_back(0x90);
+  bytes.push_back(0x55);
+  bytes.insert(bytes.end(), read_statusword_bytes,
+               read_statusword_bytes + sizeof(read_statusword_bytes));
+  ASSERT_EQ(1, feed(decoder, bytes, frame));
+  EXPECT_EQ(BYTES(read_statusword_data), frame.data);
+  EXPECT_EQ(0u, decoder.getNbOfCrcErrors());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
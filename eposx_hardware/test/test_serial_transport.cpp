@@ -0,0 +1,199 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <eposx_hardware/maxon_serial.h>
+#include <eposx_hardware/serial_transport.h>
+#include <eposx_hardware/transport.h>
+#include <eposx_hardware/utils.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace eh = eposx_hardware;
+
+//
+// epos_simulator serving MAXON SERIAL V2 on a pseudo terminal (without CAN)
+//
+
+class SimulatorProcess : boost::noncopyable {
+public:
+  SimulatorProcess() : pid_(-1), output_(NULL) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      return;
+    }
+    pid_ = fork();
+    if (pid_ == 0) {
+      // do not leave the simulator running if the test crashes
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+      dup2(fds[1], STDOUT_FILENO);
+      close(fds[0]);
+      close(fds[1]);
+      execl(EPOS_SIMULATOR_PATH, EPOS_SIMULATOR_PATH, "--interface", "", "--pty", "--node-ids",
+            "1", "2", "--stats-period", "0", static_cast< char * >(NULL));
+      _exit(127);
+    }
+    close(fds[1]);
+    if (pid_ < 0) {
+      close(fds[0]);
+      return;
+    }
+    output_ = fdopen(fds[0], "r");
+
+    // the simulator tells the pty after the nodes
+    static const char prefix[] = "Serving MAXON SERIAL V2 on ";
+    char line[256];
+    while (output_ && std::fgets(line, sizeof(line), output_)) {
+      if (std::strncmp(line, prefix, sizeof(prefix) - 1) == 0) {
+        port_name_ = line + sizeof(prefix) - 1;
+        port_name_.erase(port_name_.find_last_not_of("\r\n") + 1);
+        break;
+      }
+    }
+  }
+
+  virtual ~SimulatorProcess() {
+    if (pid_ > 0) {
+      kill(pid_, SIGTERM);
+      waitpid(pid_, NULL, 0);
+    }
+    if (output_) {
+      std::fclose(output_);
+    }
+  }
+
+  // empty if the simulator did not start
+  const std::string &getPortName() const { return port_name_; }
+
+private:
+  pid_t pid_;
+  FILE *output_;
+  std::string port_name_;
+};
+
+class SerialTransportTest : public testing::Test {
+protected:
+  virtual void SetUp() {
+    ASSERT_FALSE(simulator_.getPortName().empty()) << "epos_simulator did not start";
+    transport_.reset(new eh::SerialTransport(eh::DeviceInfo(
+        "EPOS4", "MAXON SERIAL V2", MAXON_SERIAL_INTERFACE_NAME, simulator_.getPortName())));
+  }
+
+  SimulatorProcess simulator_;
+  boost::scoped_ptr< eh::SerialTransport > transport_;
+};
+
+//
+// tests
+//
+
+TEST_F(SerialTransportTest, GetObject) {
+  // vendor id of maxon
+  boost::uint32_t vendor_id(0);
+  transport_->getObject(1, 0x1018, 0x01, &vendor_id, sizeof(vendor_id));
+  EXPECT_EQ(0x000000FBu, vendor_id);
+
+  // node id 0 addresses the node connected directly
+  vendor_id = 0;
+  transport_->getObject(0, 0x1018, 0x01, &vendor_id, sizeof(vendor_id));
+  EXPECT_EQ(0x000000FBu, vendor_id);
+}
+
+TEST_F(SerialTransportTest, SetObject) {
+  // nominal current of each node
+  const boost::uint32_t currents[2] = {1500, 2500};
+  transport_->setObject(1, 0x3001, 0x01, &currents[0], sizeof(currents[0]));
+  transport_->setObject(2, 0x3001, 0x01, &currents[1], sizeof(currents[1]));
+
+  boost::uint32_t current(0);
+  transport_->getObject(1, 0x3001, 0x01, &current, sizeof(current));
+  EXPECT_EQ(currents[0], current);
+  transport_->getObject(2, 0x3001, 0x01, &current, sizeof(current));
+  EXPECT_EQ(currents[1], current);
+}
+
+TEST_F(SerialTransportTest, SegmentedTransfer) {
+  // the 8-byte serial number is read by segments
+  boost::uint64_t serial_number(0);
+  transport_->getObject(1, 0x2100, 0x01, &serial_number, sizeof(serial_number));
+  EXPECT_EQ(0x682129000000ull, serial_number);
+}
+
+TEST_F(SerialTransportTest, SensorType) {
+  // the index channel is configured by the encoder type
+  boost::uint16_t encoder_type(0xFFFF);
+  transport_->setSensorType(1, 2);
+  transport_->getObject(1, 0x3010, 0x02, &encoder_type, sizeof(encoder_type));
+  EXPECT_EQ(0x0001, encoder_type);
+  transport_->setSensorType(1, 1);
+  transport_->getObject(1, 0x3010, 0x02, &encoder_type, sizeof(encoder_type));
+  EXPECT_EQ(0x0000, encoder_type);
+
+  // hall sensors
+  EXPECT_THROW(transport_->setSensorType(1, 3), eh::EposException);
+}
+
+TEST_F(SerialTransportTest, Abort) {
+  boost::uint32_t value(0);
+  try {
+    transport_->getObject(1, 0x5FFF, 0x00, &value, sizeof(value));
+    FAIL() << "no exception on a missing object";
+  } catch (const eh::EposException &error) {
+    ASSERT_TRUE(error.hasErrorCode());
+    EXPECT_EQ(0x06020000u, error.getErrorCode());
+  }
+
+  // writing a read-only object
+  value = 0;
+  EXPECT_THROW(transport_->setObject(1, 0x1018, 0x01, &value, sizeof(value)),
+               eh::EposException);
+
+  // the transport is still usable
+  transport_->getObject(1, 0x1018, 0x01, &value, sizeof(value));
+  EXPECT_EQ(0x000000FBu, value);
+}
+
+TEST_F(SerialTransportTest, PipelinedObjects) {
+  transport_->setPipelineDepth(4);
+
+  boost::uint32_t vendor_ids[2] = {0, 0}, missing(0), current(0);
+  std::vector< eh::ObjectRequest > requests;
+  {
+    // a write up to 4 bytes owns its data, so the source may go out of scope
+    const boost::uint32_t nominal_current(1200);
+    requests.push_back(
+        eh::ObjectRequest::write(1, 0x3001, 0x01, &nominal_current, sizeof(nominal_current)));
+  }
+  requests.push_back(eh::ObjectRequest::read(1, 0x1018, 0x01, &vendor_ids[0], 4));
+  requests.push_back(eh::ObjectRequest::read(1, 0x5FFF, 0x00, &missing, 4));
+  requests.push_back(eh::ObjectRequest::read(2, 0x1018, 0x01, &vendor_ids[1], 4));
+  requests.push_back(eh::ObjectRequest::read(1, 0x3001, 0x01, &current, 4));
+  transport_->submitObjects(requests);
+
+  // a failed request does not affect the others
+  EXPECT_FALSE(requests[0].error);
+  EXPECT_FALSE(requests[1].error);
+  EXPECT_TRUE(requests[2].error);
+  EXPECT_FALSE(requests[3].error);
+  EXPECT_FALSE(requests[4].error);
+  EXPECT_EQ(0x000000FBu, vendor_ids[0]);
+  EXPECT_EQ(0x000000FBu, vendor_ids[1]);
+  EXPECT_EQ(1200u, current);
+  EXPECT_THROW(eh::throwIfFailed(requests), eh::EposException);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}